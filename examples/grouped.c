@@ -0,0 +1,32 @@
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <grouped.h>
+
+const char *
+mpz_grouped(mpz_t n)
+{
+    static char *buf = NULL;
+
+    char *digits = (char*)malloc(mpz_sizeinbase(n, 10) + 2);
+    mpz_get_str(digits, 10, n);
+
+    /* Copy the digits (and the sign), with a separator before every group of 3 digits */
+    const char *sep = localeconv()->thousands_sep;
+    const size_t len = strlen(digits), seplen = strlen(sep);
+    const size_t start = digits[0] == '-' ? 1 : 0;
+    buf = (char*)realloc(buf, len + (len/3)*seplen + 1);
+    char *p = buf;
+    for (size_t i=0; i<len; i++) {
+        if (i > start && (len-i)%3 == 0) {
+            memcpy(p, sep, seplen);
+            p += seplen;
+        }
+        *p++ = digits[i];
+    }
+    *p = 0;
+    free(digits);
+
+    return buf;
+}
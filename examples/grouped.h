@@ -0,0 +1,20 @@
+#ifndef GROUPED_H
+#define GROUPED_H
+
+#include <gmp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Format <n> in decimal, with the thousands separator of the current locale (LC_NUMERIC).
+ * The result is stored in a static buffer, which is overwritten by the next call.
+ */
+const char *mpz_grouped(mpz_t n);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
@@ -239,56 +239,6 @@ VOID_TASK_3(compute_highest_action, MDD, dd, MDD, meta, uint32_t*, target)
     }
 }
 
-/**
- * Compute the BDD equivalent of the LDD of a set of states.
- */
-static uint64_t bdd_from_ldd_id;
-#define bdd_from_ldd(dd, bits, firstvar) CALL(bdd_from_ldd, dd, bits, firstvar)
-TASK_3(MTBDD, bdd_from_ldd, MDD, dd, MDD, bits_dd, uint32_t, firstvar)
-{
-    /* simple for leaves */
-    if (dd == lddmc_false) return mtbdd_false;
-    if (dd == lddmc_true) return mtbdd_true;
-
-    MTBDD result;
-    /* get from cache */
-    /* note: some assumptions about the encoding... */
-    if (cache_get3(bdd_from_ldd_id, dd, bits_dd, firstvar, &result)) return result;
-
-    mddnode_t n = LDD_GETNODE(dd);
-    mddnode_t nbits = LDD_GETNODE(bits_dd);
-    int bits = (int)mddnode_getvalue(nbits);
-
-    /* spawn right, same bits_dd and firstvar */
-    mtbdd_refs_spawn(SPAWN(bdd_from_ldd, mddnode_getright(n), bits_dd, firstvar));
-
-    /* call down, with next bits_dd and firstvar */
-    MTBDD down = CALL(bdd_from_ldd, mddnode_getdown(n), mddnode_getdown(nbits), firstvar + 2*bits);
-
-    /* encode current value */
-    uint32_t val = mddnode_getvalue(n);
-    for (int i=0; i<bits; i++) {
-        /* encode with high bit first */
-        int bit = bits-i-1;
-        if (val & (1LL<<i)) down = mtbdd_makenode(firstvar + 2*bit, mtbdd_false, down);
-        else down = mtbdd_makenode(firstvar + 2*bit, down, mtbdd_false);
-    }
-
-    /* sync right */
-    mtbdd_refs_push(down);
-    MTBDD right = mtbdd_refs_sync(SYNC(bdd_from_ldd));
-
-    /* take union of current and right */
-    mtbdd_refs_push(right);
-    result = sylvan_or(down, right);
-    mtbdd_refs_pop(2);
-
-    /* put in cache */
-    cache_put3(bdd_from_ldd_id, dd, bits_dd, firstvar, result);
-
-    return result;
-}
-
 /**
  * Compute the BDD equivalent of an LDD transition relation.
  */
@@ -511,7 +461,7 @@ main(int argc, char **argv)
     argp_parse(&argp, argc, argv, 0, 0, 0);
 
     // Init Lace
-    lace_init(workers, 1000000); // auto-detect number of workers, use a 1,000,000 size task queue
+    lace_init(workers, 0); // auto-detect number of workers, use a default (growing) task queue
     lace_startup(0, NULL, NULL); // auto-detect program stack, do not use a callback for startup
     LACE_ME;
 
@@ -526,7 +476,6 @@ main(int argc, char **argv)
     // Obtain operation ids for the operation cache
     compute_highest_id = cache_next_opid();
     compute_highest_action_id = cache_next_opid();
-    bdd_from_ldd_id = cache_next_opid();
     bdd_from_ldd_rel_id = cache_next_opid();
 
     // Open file
@@ -604,7 +553,7 @@ main(int argc, char **argv)
     }
 
     // Compute number of bits for each level
-    int bits[vector_size];
+    uint32_t bits[vector_size];
     for (int i=0; i<vector_size; i++) {
         bits[i] = 0;
         while (highest[i] != 0) {
@@ -627,7 +576,7 @@ main(int argc, char **argv)
         printf("Bits per level: ");
         for (int i=0; i<vector_size; i++) {
             if (i>0) printf(", ");
-            printf("%d", bits[i]);
+            printf("%u", bits[i]);
         }
         printf("\n");
         printf("Action bits: %d.\n", actionbits);
@@ -666,7 +615,7 @@ main(int argc, char **argv)
     fwrite(&actionbits, sizeof(int), 1, f);
 
     // Write initial state...
-    MTBDD new_initial = bdd_from_ldd(initial->dd, bits_dd, 0);
+    MTBDD new_initial = lddmc_to_bdd(initial->dd, bits, vector_size, state_vars);
     assert((size_t)mtbdd_satcount(new_initial, totalbits) == (size_t)lddmc_satcount_cached(initial->dd));
     mtbdd_refs_push(new_initial);
     {
@@ -675,11 +624,16 @@ main(int argc, char **argv)
         mtbdd_writer_tobinary(f, &new_initial, 1);
     }
 
-    // Custom operation that converts to BDD given number of bits for each level
-    MTBDD new_states = bdd_from_ldd(states->dd, bits_dd, 0);
+    // Convert the reachable states to BDD given number of bits for each level
+    MTBDD new_states = lddmc_to_bdd(states->dd, bits, vector_size, state_vars);
     assert((size_t)mtbdd_satcount(new_states, totalbits) == (size_t)lddmc_satcount_cached(states->dd));
     mtbdd_refs_push(new_states);
 
+    // Test if the conversion back to LDD gives the same set
+    if (check_results && bdd_to_lddmc(new_states, bits, vector_size, state_vars) != states->dd) {
+        Abort("Conversion error!\n");
+    }
+
     // Report size of BDD
     if (verbose) {
         printf("Initial states: %zu BDD nodes\n", mtbdd_nodecount(new_initial));
@@ -717,7 +671,7 @@ main(int argc, char **argv)
             mtbdd_refs_push(test);
             MDD succ = lddmc_relprod(states->dd, next[i]->dd, next[i]->meta);
             lddmc_refs_push(succ);
-            MTBDD test2 = bdd_from_ldd(succ, bits_dd, 0);
+            MTBDD test2 = lddmc_to_bdd(succ, bits, vector_size, state_vars);
             if (test != test2) Abort("Conversion error!\n");
             lddmc_refs_pop(1);
             mtbdd_refs_pop(2);
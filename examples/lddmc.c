@@ -11,8 +11,10 @@
 #endif
 
 #include <getrss.h>
+#include <grouped.h>
 
 #include <sylvan_int.h>
+#include <sylvan_gmp.h>
 
 /* Configuration (via argp) */
 static int report_levels = 0; // report states at start of every level
@@ -22,6 +24,10 @@ static int strategy = 2; // 0 = BFS, 1 = PAR, 2 = SAT, 3 = CHAINING
 static int check_deadlocks = 0; // set to 1 to check for deadlocks on-the-fly
 static int print_transition_matrix = 0; // print transition relation matrix
 static int workers = 0; // autodetect
+static size_t wide_levels = 0; // minimum width of indexed levels (0 = no index)
+static lddmc_cache_policy_t cache_policy = LDDMC_CACHE_ALL; // caching policy of LDD operations
+static uint32_t cache_policy_k = 1; // parameter of the caching policy
+static int reorder = 0; // set to 1 to reorder the state variables with sifting (bfs and par)
 static char* model_filename = NULL; // filename of model
 static char* out_filename = NULL; // filename of output
 #ifdef HAVE_PROFILER
@@ -41,6 +47,9 @@ static struct argp_option options[] =
     {"count-states", 1, 0, 0, "Report #states at each level", 1},
     {"count-table", 2, 0, 0, "Report table usage at each level", 1},
     {"print-matrix", 4, 0, 0, "Print transition matrix", 1},
+    {"wide-levels", 6, "<width>", 0, "Index levels with at least <width> values (default=0: off)", 1},
+    {"cache-policy", 7, "<all|down|every:k|top:k>", 0, "Caching policy of LDD operations (default=all)", 1},
+    {"reorder", 8, 0, 0, "Reorder state variables with sifting when the states grow (bfs and par; the output model is in the new order)", 1},
     {0, 0, 0, 0, 0, 0}
 };
 
@@ -73,6 +82,19 @@ parse_opt(int key, char *arg, struct argp_state *state)
     case 5:
         report_nodes = 1;
         break;
+    case 6:
+        wide_levels = atoi(arg);
+        break;
+    case 7:
+        if (strcmp(arg, "all")==0) cache_policy = LDDMC_CACHE_ALL;
+        else if (strcmp(arg, "down")==0) cache_policy = LDDMC_CACHE_DOWN;
+        else if (strncmp(arg, "every:", 6)==0) { cache_policy = LDDMC_CACHE_EVERY; cache_policy_k = atoi(arg+6); }
+        else if (strncmp(arg, "top:", 4)==0) { cache_policy = LDDMC_CACHE_TOP; cache_policy_k = atoi(arg+4); }
+        else argp_usage(state);
+        break;
+    case 8:
+        reorder = 1;
+        break;
 #ifdef HAVE_PROFILER
     case 'p':
         profile_filename = arg;
@@ -107,13 +129,14 @@ typedef struct relation
     MDD dd;
     MDD meta; // for relprod
     int r_k, w_k, *r_proj, *w_proj;
-    int firstvar; // for saturation/chaining
-    MDD topmeta; // for saturation
+    int firstvar; // for chaining
 } *rel_t;
 
 static int vector_size; // size of vector in integers
 static int next_count; // number of partitions of the transition relation
 static rel_t *next; // each partition of the transition relation
+static set_t initial; // initial states
+static uint32_t *var_order; // the original variable at every level (changed by reordering)
 
 /**
  * Obtain current wallclock time
@@ -219,10 +242,6 @@ TASK_1(rel_t, rel_load_proj, FILE*, f)
 
     rel->meta = lddmc_cube((uint32_t*)meta, j);
     lddmc_protect(&rel->meta);
-    if (rel->firstvar != -1) {
-        rel->topmeta = lddmc_cube((uint32_t*)meta+rel->firstvar, j-rel->firstvar);
-        lddmc_protect(&rel->topmeta);
-    }
     rel->dd = lddmc_false;
     lddmc_protect(&rel->dd);
 
@@ -288,6 +307,86 @@ print_memory_usage(void)
     INFO("Memory usage: %s\n", buf);
 }
 
+/**
+ * Count the states in <mdd> (arbitrary precision) and format the number with thousands separators.
+ * The result is stored in a static buffer, which is overwritten by the next call.
+ */
+#define count_states(mdd) CALL(count_states, mdd)
+TASK_1(const char*, count_states, MDD, mdd)
+{
+    mpz_t count;
+    mpz_init(count);
+    lddmc_satcount_mpz(count, mdd);
+    const char *res = mpz_grouped(count);
+    mpz_clear(count);
+    return res;
+}
+
+/**
+ * Update the projections and the first variable of a relation from its meta (after reordering)
+ */
+static void
+rel_update_proj(rel_t rel)
+{
+    int r_i=0, w_i=0;
+    rel->firstvar = -1;
+    MDD meta = rel->meta;
+    for (int i=0; i<vector_size && meta != lddmc_true; i++) {
+        uint32_t val = lddmc_getvalue(meta);
+        if (val == 1) {
+            rel->r_proj[r_i++] = i;
+            rel->w_proj[w_i++] = i;
+            meta = lddmc_getdown(meta); // skip the write
+        } else if (val == 3) {
+            rel->r_proj[r_i++] = i;
+        } else if (val == 4) {
+            rel->w_proj[w_i++] = i;
+        } else if (val != 0) {
+            break;
+        }
+        if (val != 0 && rel->firstvar == -1) rel->firstvar = i;
+        meta = lddmc_getdown(meta);
+    }
+}
+
+/**
+ * Reorder the state variables with sifting, when <*visited> has grown to twice its size after the
+ * last reordering. The relations, the initial states, <*visited> and <*front> are reordered.
+ */
+#define reorder_if_grown(visited, front) CALL(reorder_if_grown, visited, front)
+VOID_TASK_2(reorder_if_grown, MDD*, visited, MDD*, front)
+{
+    static size_t threshold = 4096;
+    if (lddmc_nodecount(*visited) < threshold) return;
+
+    double t1 = wctime();
+    MDD sets[3] = {*visited, *front, initial->dd};
+    MDD *rels = (MDD*)malloc(sizeof(MDD[next_count]));
+    MDD *metas = (MDD*)malloc(sizeof(MDD[next_count]));
+    size_t before = 0;
+    for (int i=0; i<3; i++) before += lddmc_nodecount(sets[i]);
+    for (int i=0; i<next_count; i++) {
+        rels[i] = next[i]->dd;
+        metas[i] = next[i]->meta;
+        before += lddmc_nodecount(rels[i]);
+    }
+    size_t after = lddmc_sift(vector_size, var_order, sets, 3, rels, metas, next_count, 1.2);
+    *visited = sets[0];
+    *front = sets[1];
+    initial->dd = sets[2];
+    for (int i=0; i<next_count; i++) {
+        next[i]->dd = rels[i];
+        next[i]->meta = metas[i];
+        rel_update_proj(next[i]);
+    }
+    free(rels);
+    free(metas);
+    double t2 = wctime();
+
+    INFO("Reordered from %'zu to %'zu nodes in %f sec\n", before, after, t2-t1);
+    threshold = 2 * lddmc_nodecount(*visited);
+}
+
 /**
  * Get the first variable of the transition relation
  */
@@ -310,10 +409,13 @@ print_example(MDD example)
         uint32_t vec[vector_size];
         lddmc_sat_one(example, vec, vector_size);
 
+        uint32_t orig[vector_size];
+        for (int i=0; i<vector_size; i++) orig[var_order[i]] = vec[i];
+
         printf("[");
         for (int i=0; i<vector_size; i++) {
             if (i>0) printf(",");
-            printf("%" PRIu32, vec[i]);
+            printf("%" PRIu32, orig[i]);
         }
         printf("]");
     }
@@ -418,7 +520,7 @@ VOID_TASK_1(par, set_t, set)
             lddmc_refs_popptr(1);
 
             if (deadlocks != lddmc_false) {
-                INFO("Found %'0.0f deadlock states... ", lddmc_satcount_cached(deadlocks));
+                INFO("Found %s deadlock states... ", count_states(deadlocks));
                 printf("example: ");
                 print_example(deadlocks);
                 printf("\n");
@@ -431,10 +533,11 @@ VOID_TASK_1(par, set_t, set)
 
         // visited = visited + front
         visited = lddmc_union(visited, front);
+        if (reorder) reorder_if_grown(&visited, &front);
 
         INFO("Level %d done", iteration);
         if (report_levels) {
-            printf(", %'0.0f states explored", lddmc_satcount_cached(visited));
+            printf(", %s states explored", count_states(visited));
         }
         if (report_table) {
             size_t filled, total;
@@ -529,7 +632,7 @@ VOID_TASK_1(bfs, set_t, set)
             lddmc_refs_popptr(1);
 
             if (deadlocks != lddmc_false) {
-                INFO("Found %'0.0f deadlock states... ", lddmc_satcount_cached(deadlocks));
+                INFO("Found %s deadlock states... ", count_states(deadlocks));
                 printf("example: ");
                 print_example(deadlocks);
                 printf("\n");
@@ -542,10 +645,11 @@ VOID_TASK_1(bfs, set_t, set)
 
         // visited = visited + front
         visited = lddmc_union(visited, front);
+        if (reorder) reorder_if_grown(&visited, &front);
 
         INFO("Level %d done", iteration);
         if (report_levels) {
-            printf(", %'0.0f states explored", lddmc_satcount_cached(visited));
+            printf(", %s states explored", count_states(visited));
         }
         if (report_table) {
             size_t filled, total;
@@ -563,73 +667,17 @@ VOID_TASK_1(bfs, set_t, set)
 }
 
 /**
- * Implementation of (parallel) saturation
- * (assumes relations are ordered on first variable)
- */
-TASK_3(MDD, go_sat, MDD, set, int, idx, int, depth)
-{
-    /* Terminal cases */
-    if (set == lddmc_false) return lddmc_false;
-    if (idx == next_count) return set;
-
-    /* Consult the cache */
-    MDD result;
-    const MDD _set = set;
-    if (cache_get3(201LL<<40, _set, idx, 0, &result)) return result;
-    lddmc_refs_pushptr(&_set);
-
-    /**
-     * Possible improvement: cache more things (like intermediate results?)
-     *   and chain-apply more of the current level before going deeper?
-     */
-
-    /* Check if the relation should be applied */
-    const int var = next[idx]->firstvar;
-    assert(depth <= var);
-    if (depth == var) {
-        /* Count the number of relations starting here */
-        int n = 1;
-        while ((idx + n) < next_count && var == next[idx + n]->firstvar) n++;
-        /*
-         * Compute until fixpoint:
-         * - SAT deeper
-         * - chain-apply all current level once
-         */
-        MDD prev = lddmc_false;
-        lddmc_refs_pushptr(&set);
-        lddmc_refs_pushptr(&prev);
-        while (prev != set) {
-            prev = set;
-            // SAT deeper
-            set = CALL(go_sat, set, idx + n, depth);
-            // chain-apply all current level once
-            for (int i=0; i<n; i++) {
-                set = lddmc_relprod_union(set, next[idx+i]->dd, next[idx+i]->topmeta, set);
-            }
-        }
-        lddmc_refs_popptr(2);
-        result = set;
-    } else {
-        /* Recursive computation */
-        lddmc_refs_spawn(SPAWN(go_sat, lddmc_getright(set), idx, depth));
-        MDD down = lddmc_refs_push(CALL(go_sat, lddmc_getdown(set), idx, depth+1));
-        MDD right = lddmc_refs_sync(SYNC(go_sat));
-        lddmc_refs_pop(1);
-        result = lddmc_makenode(lddmc_getvalue(set), down, right);
-    }
-
-    /* Store in cache */
-    cache_put3(201LL<<40, _set, idx, 0, result);
-    lddmc_refs_popptr(1);
-    return result;
-}
-
-/**
- * Wrapper for the Saturation strategy
+ * Implementation of the Saturation strategy (using lddmc_saturate)
  */
 VOID_TASK_1(sat, set_t, set)
 {
-    set->dd = CALL(go_sat, set->dd, 0, 0);
+    MDD rels[next_count];
+    MDD metas[next_count];
+    for (int i=0; i<next_count; i++) {
+        rels[i] = next[i]->dd;
+        metas[i] = next[i]->meta;
+    }
+    set->dd = lddmc_saturate(set->dd, rels, metas, next_count);
 }
 
 /**
@@ -661,7 +709,7 @@ VOID_TASK_1(chaining, set_t, set)
 
         INFO("Level %d done", iteration);
         if (report_levels) {
-            printf(", %'0.0f states explored", lddmc_satcount_cached(visited));
+            printf(", %s states explored", count_states(visited));
         }
         if (report_table) {
             size_t filled, total;
@@ -709,7 +757,7 @@ main(int argc, char **argv)
      * Second: start all worker threads with default settings.
      * Third: setup local variables using the LACE_ME macro.
      */
-    lace_init(workers, 1000000);
+    lace_init(workers, 0);
     lace_startup(0, NULL, NULL);
     LACE_ME;
 
@@ -725,6 +773,8 @@ main(int argc, char **argv)
     sylvan_set_limits(2LL<<30, 1, 6);
     sylvan_init_package();
     sylvan_init_ldd();
+    lddmc_set_wide_levels(wide_levels);
+    for (int op=0; op<LDDMC_CACHE_OPS; op++) lddmc_set_cache_policy((lddmc_cache_op_t)op, cache_policy, cache_policy_k);
     sylvan_gc_hook_pregc(TASK(gc_start));
     sylvan_gc_hook_postgc(TASK(gc_end));
 
@@ -740,9 +790,11 @@ main(int argc, char **argv)
 
     /* Read domain data */
     if (fread(&vector_size, sizeof(int), 1, f) != 1) Abort("Invalid input file!\n");
+    var_order = (uint32_t*)malloc(sizeof(uint32_t[vector_size]));
+    for (int i=0; i<vector_size; i++) var_order[i] = i;
 
     /* Read initial state */
-    set_t initial = set_load(f);
+    initial = set_load(f);
 
     /* Read number of transition relations */
     if (fread(&next_count, sizeof(int), 1, f) != 1) Abort("Invalid input file!\n");
@@ -777,6 +829,8 @@ main(int argc, char **argv)
         }
     }
 
+    if (reorder && strategy != 0 && strategy != 1) Abort("Reordering is only supported for the bfs and par strategies.\n");
+
     INFO("Read file '%s'\n", model_filename);
     INFO("%d integers per state, %d transition groups\n", vector_size, next_count);
 
@@ -823,7 +877,7 @@ main(int argc, char **argv)
 #endif
 
     // Now we just have states
-    INFO("Final states: %'0.0f states\n", lddmc_satcount_cached(states->dd));
+    INFO("Final states: %s states\n", count_states(states->dd));
     if (report_nodes) {
         INFO("Final states: %'zu MDD nodes\n", lddmc_nodecount(states->dd));
     }
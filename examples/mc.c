@@ -11,8 +11,10 @@
 #endif
 
 #include <getrss.h>
+#include <grouped.h>
 
 #include <sylvan.h>
+#include <sylvan_gmp.h>
 #include <sylvan_int.h>
 
 /* Configuration (via argp) */
@@ -22,9 +24,11 @@ static int report_nodes = 0; // report number of nodes of BDDs
 static int strategy = 2; // 0 = BFS, 1 = PAR, 2 = SAT, 3 = CHAINING
 static int check_deadlocks = 0; // set to 1 to check for deadlocks on-the-fly (only bfs/par)
 static int merge_relations = 0; // merge relations to 1 relation
+static size_t cluster_threshold = 0; // cluster relations up to this number of nodes (0 = off)
 static int print_transition_matrix = 0; // print transition relation matrix
 static int workers = 0; // autodetect
 static char* model_filename = NULL; // filename of model
+static char* trace_filename = NULL; // filename for Chrome trace
 #ifdef HAVE_PROFILER
 static char* profile_filename = NULL; // filename for profiling
 #endif
@@ -42,7 +46,9 @@ static struct argp_option options[] =
     {"count-states", 1, 0, 0, "Report #states at each level", 1},
     {"count-table", 2, 0, 0, "Report table usage at each level", 1},
     {"merge-relations", 6, 0, 0, "Merge transition relations into one transition relation", 1},
+    {"cluster-relations", 8, "<nodes>", 0, "Cluster transition relations up to <nodes> BDD nodes", 1},
     {"print-matrix", 4, 0, 0, "Print transition matrix", 1},
+    {"trace", 7, "<filename>", 0, "Write a Chrome trace of the reachability to <filename>", 1},
     {0, 0, 0, 0, 0, 0}
 };
 static error_t
@@ -77,6 +83,12 @@ parse_opt(int key, char *arg, struct argp_state *state)
     case 6:
         merge_relations = 1;
         break;
+    case 7:
+        trace_filename = arg;
+        break;
+    case 8:
+        cluster_threshold = strtoull(arg, NULL, 10);
+        break;
 #ifdef HAVE_PROFILER
     case 'p':
         profile_filename = arg;
@@ -109,6 +121,8 @@ typedef struct relation
 {
     BDD bdd;
     BDD variables; // all variables in the relation (used by relprod)
+    BDD rw_bdd; // the relation without copy constraints (used by relnext_rw)
+    BDD read_vars, write_vars; // s variables that are read and written (used by relnext_rw)
     int r_k, w_k, *r_proj, *w_proj;
 } *rel_t;
 
@@ -152,6 +166,21 @@ print_memory_usage(void)
     INFO("Memory usage: %s\n", buf);
 }
 
+/**
+ * Count the states in <bdd> (arbitrary precision) and format the number with thousands separators.
+ * The result is stored in a static buffer, which is overwritten by the next call.
+ */
+#define count_states(bdd, variables) CALL(count_states, bdd, variables)
+TASK_2(const char*, count_states, BDD, bdd, BDDSET, variables)
+{
+    mpz_t count;
+    mpz_init(count);
+    sylvan_satcount_mpz(count, bdd, variables);
+    const char *res = mpz_grouped(count);
+    mpz_clear(count);
+    return res;
+}
+
 /**
  * Load a set from file
  * The expected binary format:
@@ -266,6 +295,30 @@ TASK_1(rel_t, rel_load_proj, FILE*, f)
     rel->variables = sylvan_set_fromarray(all_vars, n);
     sylvan_protect(&rel->variables);
 
+    /* Compute read_vars and write_vars, the s variables of the read and written integers */
+    uint32_t read_vars[totalbits], write_vars[totalbits];
+    int read_n = 0, write_n = 0;
+    curvar = 0;
+    r_i = w_i = 0;
+    for (i=0; i<vectorsize; i++) {
+        const int is_read = r_i < r_k && r_proj[r_i] == i;
+        const int is_write = w_i < w_k && w_proj[w_i] == i;
+        if (is_read) r_i++;
+        if (is_write) w_i++;
+        for (int k=0; k<statebits[i]; k++) {
+            if (is_read) read_vars[read_n++] = curvar;
+            if (is_write) write_vars[write_n++] = curvar;
+            curvar += 2;
+        }
+    }
+    rel->read_vars = sylvan_set_fromarray(read_vars, read_n);
+    rel->write_vars = sylvan_set_fromarray(write_vars, write_n);
+    sylvan_protect(&rel->read_vars);
+    sylvan_protect(&rel->write_vars);
+
+    rel->rw_bdd = sylvan_false;
+    sylvan_protect(&rel->rw_bdd);
+
     return rel;
 }
 
@@ -277,6 +330,18 @@ TASK_1(rel_t, rel_load_proj, FILE*, f)
 VOID_TASK_2(rel_load, rel_t, rel, FILE*, f)
 {
     if (mtbdd_reader_frombinary(f, &rel->bdd, 1) != 0) Abort("Invalid file format!\n");
+
+    /* Remove the copy constraints s=t of integers that are read but not written */
+    BDD copy_vars = sylvan_set_empty();
+    bdd_refs_pushptr(&copy_vars);
+    BDD read_vars = rel->read_vars;
+    while (!sylvan_set_isempty(read_vars)) {
+        uint32_t v = sylvan_set_first(read_vars);
+        if (!sylvan_set_in(rel->write_vars, v)) copy_vars = sylvan_set_add(copy_vars, v+1);
+        read_vars = sylvan_set_next(read_vars);
+    }
+    rel->rw_bdd = sylvan_exists(rel->bdd, copy_vars);
+    bdd_refs_popptr(1);
 }
 
 /**
@@ -306,77 +371,17 @@ VOID_TASK_2(print_example, BDD, example, BDDSET, variables)
 }
 
 /**
- * Implementation of (parallel) saturation
- * (assumes relations are ordered on first variable)
- */
-TASK_2(BDD, go_sat, BDD, set, int, idx)
-{
-    /* Terminal cases */
-    if (set == sylvan_false) return sylvan_false;
-    if (idx == next_count) return set;
-
-    /* Consult the cache */
-    BDD result;
-    const BDD _set = set;
-    if (cache_get3(200LL<<40, _set, idx, 0, &result)) return result;
-    mtbdd_refs_pushptr(&_set);
-
-    /**
-     * Possible improvement: cache more things (like intermediate results?)
-     *   and chain-apply more of the current level before going deeper?
-     */
-
-    /* Check if the relation should be applied */
-    const uint32_t var = sylvan_var(next[idx]->variables);
-    if (set == sylvan_true || var <= sylvan_var(set)) {
-        /* Count the number of relations starting here */
-        int count = idx+1;
-        while (count < next_count && var == sylvan_var(next[count]->variables)) count++;
-        count -= idx;
-        /*
-         * Compute until fixpoint:
-         * - SAT deeper
-         * - chain-apply all current level once
-         */
-        BDD prev = sylvan_false;
-        BDD step = sylvan_false;
-        mtbdd_refs_pushptr(&set);
-        mtbdd_refs_pushptr(&prev);
-        mtbdd_refs_pushptr(&step);
-        while (prev != set) {
-            prev = set;
-            // SAT deeper
-            set = CALL(go_sat, set, idx+count);
-            // chain-apply all current level once
-            for (int i=0;i<count;i++) {
-                step = sylvan_relnext(set, next[idx+i]->bdd, next[idx+i]->variables);
-                set = sylvan_or(set, step);
-                step = sylvan_false; // unset, for gc
-            }
-        }
-        mtbdd_refs_popptr(3);
-        result = set;
-    } else {
-        /* Recursive computation */
-        mtbdd_refs_spawn(SPAWN(go_sat, sylvan_low(set), idx));
-        BDD high = mtbdd_refs_push(CALL(go_sat, sylvan_high(set), idx));
-        BDD low = mtbdd_refs_sync(SYNC(go_sat));
-        mtbdd_refs_pop(1);
-        result = sylvan_makenode(sylvan_var(set), low, high);
-    }
-
-    /* Store in cache */
-    cache_put3(200LL<<40, _set, idx, 0, result);
-    mtbdd_refs_popptr(1);
-    return result;
-}
-
-/**
- * Wrapper for the Saturation strategy
+ * Implementation of the Saturation strategy (using sylvan_saturate)
  */
 VOID_TASK_1(sat, set_t, set)
 {
-    set->bdd = CALL(go_sat, set->bdd, 0);
+    BDD rels[next_count];
+    BDDSET vars[next_count];
+    for (int i=0; i<next_count; i++) {
+        rels[i] = next[i]->bdd;
+        vars[i] = next[i]->variables;
+    }
+    set->bdd = sylvan_saturate(set->bdd, rels, vars, next_count);
 }
 
 /**
@@ -445,16 +450,31 @@ VOID_TASK_1(par, set_t, set)
     sylvan_protect(&cur_level);
     sylvan_protect(&deadlocks);
 
+    BDD rels[next_count];
+    BDDSET vars[next_count];
+    for (int i=0; i<next_count; i++) {
+        rels[i] = next[i]->bdd;
+        vars[i] = next[i]->variables;
+    }
+
     int iteration = 1;
     do {
         // calculate successors in parallel
         cur_level = next_level;
         deadlocks = cur_level;
 
-        next_level = CALL(go_par, cur_level, visited, 0, next_count, check_deadlocks ? &deadlocks : NULL);
+        LACE_TRACE_BEGIN("image");
+        if (check_deadlocks) {
+            // deadlock detection needs the successors of every relation separately
+            next_level = CALL(go_par, cur_level, visited, 0, next_count, &deadlocks);
+        } else {
+            next_level = sylvan_relnext_multi(cur_level, rels, vars, next_count);
+            next_level = sylvan_diff(next_level, visited);
+        }
+        LACE_TRACE_END("image");
 
         if (check_deadlocks && deadlocks != sylvan_false) {
-            INFO("Found %'0.0f deadlock states... ", sylvan_satcount(deadlocks, set->variables));
+            INFO("Found %s deadlock states... ", count_states(deadlocks, set->variables));
             if (deadlocks != sylvan_false) {
                 printf("example: ");
                 print_example(deadlocks, set->variables);
@@ -464,13 +484,15 @@ VOID_TASK_1(par, set_t, set)
         }
 
         // visited = visited + new
+        LACE_TRACE_BEGIN("union");
         visited = sylvan_or(visited, next_level);
+        LACE_TRACE_END("union");
 
         if (report_table && report_levels) {
             size_t filled, total;
             sylvan_table_usage(&filled, &total);
-            INFO("Level %d done, %'0.0f states explored, table: %0.1f%% full (%'zu nodes)\n",
-                iteration, sylvan_satcount(visited, set->variables),
+            INFO("Level %d done, %s states explored, table: %0.1f%% full (%'zu nodes)\n",
+                iteration, count_states(visited, set->variables),
                 100.0*(double)filled/total, filled);
         } else if (report_table) {
             size_t filled, total;
@@ -479,7 +501,7 @@ VOID_TASK_1(par, set_t, set)
                 iteration,
                 100.0*(double)filled/total, filled);
         } else if (report_levels) {
-            INFO("Level %d done, %'0.0f states explored\n", iteration, sylvan_satcount(visited, set->variables));
+            INFO("Level %d done, %s states explored\n", iteration, count_states(visited, set->variables));
         } else {
             INFO("Level %d done\n", iteration);
         }
@@ -502,7 +524,12 @@ TASK_5(BDD, go_bfs, BDD, cur, BDD, visited, size_t, from, size_t, len, BDD*, dea
 {
     if (len == 1) {
         // Calculate NEW successors (not in visited)
-        BDD succ = sylvan_relnext(cur, next[from]->bdd, next[from]->variables);
+        BDD succ;
+        if (deadlocks) {
+            succ = sylvan_relnext(cur, next[from]->bdd, next[from]->variables);
+        } else {
+            succ = sylvan_relnext_rw(cur, next[from]->rw_bdd, next[from]->read_vars, next[from]->write_vars);
+        }
         bdd_refs_push(succ);
         if (deadlocks) {
             // check which BDDs in deadlocks do not have a successor in this relation
@@ -567,10 +594,12 @@ VOID_TASK_1(bfs, set_t, set)
         cur_level = next_level;
         deadlocks = cur_level;
 
+        LACE_TRACE_BEGIN("image");
         next_level = CALL(go_bfs, cur_level, visited, 0, next_count, check_deadlocks ? &deadlocks : NULL);
+        LACE_TRACE_END("image");
 
         if (check_deadlocks && deadlocks != sylvan_false) {
-            INFO("Found %'0.0f deadlock states... ", sylvan_satcount(deadlocks, set->variables));
+            INFO("Found %s deadlock states... ", count_states(deadlocks, set->variables));
             if (deadlocks != sylvan_false) {
                 printf("example: ");
                 print_example(deadlocks, set->variables);
@@ -580,13 +609,15 @@ VOID_TASK_1(bfs, set_t, set)
         }
 
         // visited = visited + new
+        LACE_TRACE_BEGIN("union");
         visited = sylvan_or(visited, next_level);
+        LACE_TRACE_END("union");
 
         if (report_table && report_levels) {
             size_t filled, total;
             sylvan_table_usage(&filled, &total);
-            INFO("Level %d done, %'0.0f states explored, table: %0.1f%% full (%'zu nodes)\n",
-                iteration, sylvan_satcount(visited, set->variables),
+            INFO("Level %d done, %s states explored, table: %0.1f%% full (%'zu nodes)\n",
+                iteration, count_states(visited, set->variables),
                 100.0*(double)filled/total, filled);
         } else if (report_table) {
             size_t filled, total;
@@ -595,7 +626,7 @@ VOID_TASK_1(bfs, set_t, set)
                 iteration,
                 100.0*(double)filled/total, filled);
         } else if (report_levels) {
-            INFO("Level %d done, %'0.0f states explored\n", iteration, sylvan_satcount(visited, set->variables));
+            INFO("Level %d done, %s states explored\n", iteration, count_states(visited, set->variables));
         } else {
             INFO("Level %d done\n", iteration);
         }
@@ -626,11 +657,13 @@ VOID_TASK_1(chaining, set_t, set)
     int iteration = 1;
     do {
         // calculate successors in parallel
+        LACE_TRACE_BEGIN("image");
         for (int i=0; i<next_count; i++) {
             succ = sylvan_relnext(next_level, next[i]->bdd, next[i]->variables);
             next_level = sylvan_or(next_level, succ);
             succ = sylvan_false; // reset, for gc
         }
+        LACE_TRACE_END("image");
 
         // new = new - visited
         // visited = visited + new
@@ -640,8 +673,8 @@ VOID_TASK_1(chaining, set_t, set)
         if (report_table && report_levels) {
             size_t filled, total;
             sylvan_table_usage(&filled, &total);
-            INFO("Level %d done, %'0.0f states explored, table: %0.1f%% full (%'zu nodes)\n",
-                iteration, sylvan_satcount(visited, set->variables),
+            INFO("Level %d done, %s states explored, table: %0.1f%% full (%'zu nodes)\n",
+                iteration, count_states(visited, set->variables),
                 100.0*(double)filled/total, filled);
         } else if (report_table) {
             size_t filled, total;
@@ -650,7 +683,7 @@ VOID_TASK_1(chaining, set_t, set)
                 iteration,
                 100.0*(double)filled/total, filled);
         } else if (report_levels) {
-            INFO("Level %d done, %'0.0f states explored\n", iteration, sylvan_satcount(visited, set->variables));
+            INFO("Level %d done, %s states explored\n", iteration, count_states(visited, set->variables));
         } else {
             INFO("Level %d done\n", iteration);
         }
@@ -697,18 +730,115 @@ TASK_2(BDD, extend_relation, MTBDD, relation, MTBDD, variables)
 }
 
 /**
- * Compute \BigUnion ( sets[i] )
+ * Sort the transition relations by their top variable (gnome sort because I like gnomes)
+ */
+static void
+sort_relations()
+{
+    int i = 1, j = 2;
+    rel_t t;
+    while (i < next_count) {
+        rel_t *p = &next[i], *q = p-1;
+        if (sylvan_var((*q)->variables) > sylvan_var((*p)->variables)) {
+            t = *q;
+            *q = *p;
+            *p = t;
+            if (--i) continue;
+        }
+        i = j++;
+    }
+}
+
+/**
+ * Cluster the transition relations (with sylvan_cluster_relations)
  */
-#define big_union(first, count) CALL(big_union, first, count)
-TASK_2(BDD, big_union, int, first, int, count)
+#define cluster_relations() CALL(cluster_relations)
+VOID_TASK_0(cluster_relations)
 {
-    if (count == 1) return next[first]->bdd;
+    BDD rels[next_count];
+    BDDSET vars[next_count];
+    for (int i=0; i<next_count; i++) {
+        rels[i] = next[i]->bdd;
+        vars[i] = next[i]->variables;
+    }
+    const int count = sylvan_cluster_relations(rels, vars, next_count, cluster_threshold, rels, vars);
 
-    bdd_refs_spawn(SPAWN(big_union, first, count/2));
-    BDD right = bdd_refs_push(CALL(big_union, first+count/2, count-count/2));
-    BDD left = bdd_refs_push(bdd_refs_sync(SYNC(big_union)));
-    BDD result = sylvan_or(left, right);
-    bdd_refs_pop(2);
+    for (int i=0; i<count; i++) {
+        next[i]->bdd = rels[i];
+        next[i]->variables = vars[i];
+        next[i]->rw_bdd = rels[i];
+        next[i]->read_vars = sylvan_true;
+    }
+    for (int i=count; i<next_count; i++) {
+        next[i]->bdd = sylvan_false;
+        next[i]->rw_bdd = sylvan_false;
+        next[i]->variables = sylvan_true;
+        next[i]->read_vars = sylvan_true;
+        next[i]->write_vars = sylvan_true;
+    }
+    next_count = count;
+
+    /* all s variables of a cluster are treated as written (by relnext_rw) */
+    for (int i=0; i<count; i++) {
+        uint32_t s_vars[totalbits];
+        size_t n = 0;
+        for (BDDSET v = next[i]->variables; !sylvan_set_isempty(v); v = sylvan_set_next(v)) {
+            const uint32_t var = sylvan_set_first(v);
+            if ((var & 1) == 0) s_vars[n++] = var;
+        }
+        next[i]->write_vars = sylvan_set_fromarray(s_vars, n);
+    }
+}
+
+/**
+ * Count the chain links in <bdd> over <variables>: nodes whose child on the next variable
+ * shares the other child, which chain reduction (as in CBDDs) would merge into one node.
+ * Only a diagnostic for --count-nodes; uses the node marks, like sylvan_nodecount.
+ */
+static size_t
+chaincount_mark(BDD bdd, BDDSET variables)
+{
+    if (sylvan_isconst(bdd)) return 0;
+    bddnode_t n = MTBDD_GETNODE(bdd);
+    if (bddnode_getmark(n)) return 0;
+    bddnode_setmark(n, 1);
+
+    /* Find the variable after the variable of this node */
+    const BDDVAR var = bddnode_getvariable(n);
+    while (!sylvan_set_isempty(variables) && sylvan_var(variables) <= var) variables = sylvan_set_next(variables);
+
+    const BDD low = sylvan_low(MTBDD_STRIPMARK(bdd));
+    const BDD high = sylvan_high(MTBDD_STRIPMARK(bdd));
+    size_t result = 0;
+    if (!sylvan_set_isempty(variables)) {
+        const BDDVAR next_var = sylvan_var(variables);
+        for (int i=0; i<2 && result == 0; i++) {
+            const BDD child = i ? high : low;
+            const BDD other = i ? low : high;
+            if (sylvan_isconst(child) || sylvan_var(child) != next_var) continue;
+            if (sylvan_low(child) == other || sylvan_high(child) == other) result = 1;
+        }
+    }
+
+    return result + chaincount_mark(low, variables) + chaincount_mark(high, variables);
+}
+
+static void
+chaincount_unmark(BDD bdd)
+{
+    if (sylvan_isconst(bdd)) return;
+    bddnode_t n = MTBDD_GETNODE(bdd);
+    if (!bddnode_getmark(n)) return;
+    bddnode_setmark(n, 0);
+    chaincount_unmark(sylvan_low(MTBDD_STRIPMARK(bdd)));
+    chaincount_unmark(sylvan_high(MTBDD_STRIPMARK(bdd)));
+}
+
+static size_t
+chaincount(BDD bdd, BDDSET variables)
+{
+    size_t result = chaincount_mark(bdd, variables);
+    chaincount_unmark(bdd);
     return result;
 }
 
@@ -767,7 +897,7 @@ main(int argc, char **argv)
      * Second: start all worker threads with default settings.
      * Third: setup local variables using the LACE_ME macro.
      */
-    lace_init(workers, 1000000);
+    lace_init(workers, 0);
     lace_startup(0, NULL, NULL);
     LACE_ME;
 
@@ -822,21 +952,7 @@ main(int argc, char **argv)
      * Pre-processing and some statistics reporting
      */
 
-    if (strategy == 2 || strategy == 3) {
-        // for SAT and CHAINING, sort the transition relations (gnome sort because I like gnomes)
-        int i = 1, j = 2;
-        rel_t t;
-        while (i < next_count) {
-            rel_t *p = &next[i], *q = p-1;
-            if (sylvan_var((*q)->variables) > sylvan_var((*p)->variables)) {
-                t = *q;
-                *q = *p;
-                *p = t;
-                if (--i) continue;
-            }
-            i = j++;
-        }
-    }
+    if (strategy == 2 || strategy == 3) sort_relations();
 
     INFO("Read file '%s'\n", model_filename);
     INFO("%d integers per state, %d bits per state, %d transition groups\n", vectorsize, totalbits, next_count);
@@ -850,6 +966,13 @@ main(int argc, char **argv)
         }
     }
 
+    /* cluster the transition relations if requested */
+    if (cluster_threshold > 0 && !merge_relations) {
+        cluster_relations();
+        INFO("Clustered transition relations into %d groups\n", next_count);
+        if (strategy == 2 || strategy == 3) sort_relations();
+    }
+
     /* merge all relations to one big transition relation if requested */
     if (merge_relations) {
         BDD newvars = sylvan_set_empty();
@@ -868,10 +991,16 @@ main(int argc, char **argv)
         bdd_refs_popptr(1);
 
         INFO("Taking union of all transition relations.\n");
-        next[0]->bdd = big_union(0, next_count);
+        BDD rels[next_count];
+        for (int i=0; i<next_count; i++) rels[i] = next[i]->bdd;
+        next[0]->bdd = sylvan_or_many(rels, next_count);
+        next[0]->rw_bdd = next[0]->bdd;
+        next[0]->read_vars = states->variables;
+        next[0]->write_vars = states->variables;
 
         for (int i=1; i<next_count; i++) {
             next[i]->bdd = sylvan_false;
+            next[i]->rw_bdd = sylvan_false;
             next[i]->variables = sylvan_true;
         }
         next_count = 1;
@@ -879,9 +1008,12 @@ main(int argc, char **argv)
 
     if (report_nodes) {
         INFO("BDD nodes:\n");
-        INFO("Initial states: %zu BDD nodes\n", sylvan_nodecount(states->bdd));
+        INFO("Initial states: %zu BDD nodes (%zu chain links)\n", sylvan_nodecount(states->bdd),
+            chaincount(states->bdd, states->variables));
         for (int i=0; i<next_count; i++) {
-            INFO("Transition %d: %zu BDD nodes\n", i, sylvan_nodecount(next[i]->bdd));
+            INFO("Transition %d: %zu BDD nodes (%zu without copy constraints, %zu chain links)\n", i,
+                sylvan_nodecount(next[i]->bdd), sylvan_nodecount(next[i]->rw_bdd),
+                chaincount(next[i]->bdd, next[i]->variables));
         }
     }
 
@@ -891,24 +1023,34 @@ main(int argc, char **argv)
     if (profile_filename != NULL) ProfilerStart(profile_filename);
 #endif
 
+    if (trace_filename != NULL) lace_trace_enable(0);
+
     if (strategy == 0) {
         double t1 = wctime();
+        LACE_TRACE_BEGIN("bfs");
         CALL(bfs, states);
+        LACE_TRACE_END("bfs");
         double t2 = wctime();
         INFO("BFS Time: %f\n", t2-t1);
     } else if (strategy == 1) {
         double t1 = wctime();
+        LACE_TRACE_BEGIN("par");
         CALL(par, states);
+        LACE_TRACE_END("par");
         double t2 = wctime();
         INFO("PAR Time: %f\n", t2-t1);
     } else if (strategy == 2) {
         double t1 = wctime();
+        LACE_TRACE_BEGIN("sat");
         CALL(sat, states);
+        LACE_TRACE_END("sat");
         double t2 = wctime();
         INFO("SAT Time: %f\n", t2-t1);
     } else if (strategy == 3) {
         double t1 = wctime();
+        LACE_TRACE_BEGIN("chaining");
         CALL(chaining, states);
+        LACE_TRACE_END("chaining");
         double t2 = wctime();
         INFO("CHAINING Time: %f\n", t2-t1);
     } else {
@@ -919,10 +1061,20 @@ main(int argc, char **argv)
     if (profile_filename != NULL) ProfilerStop();
 #endif
 
+    if (trace_filename != NULL) {
+        lace_trace_disable();
+        FILE *tf = fopen(trace_filename, "w");
+        if (tf == NULL) Abort("Cannot open file '%s'!\n", trace_filename);
+        lace_trace_write(tf);
+        fclose(tf);
+        INFO("Wrote trace to '%s'\n", trace_filename);
+    }
+
     // Now we just have states
-    INFO("Final states: %'0.0f states\n", sylvan_satcount(states->bdd, states->variables));
+    INFO("Final states: %s states\n", count_states(states->bdd, states->variables));
     if (report_nodes) {
-        INFO("Final states: %'zu BDD nodes\n", sylvan_nodecount(states->bdd));
+        INFO("Final states: %'zu BDD nodes (%'zu chain links)\n", sylvan_nodecount(states->bdd),
+            chaincount(states->bdd, states->variables));
     }
 
     print_memory_usage();
@@ -109,7 +109,7 @@ main(int argc, char** argv)
     t_start = wctime();
 
     // Init Lace
-    lace_init(workers, 1000000); // auto-detect number of workers, use a 1,000,000 size task queue
+    lace_init(workers, 0); // auto-detect number of workers, use a default (growing) task queue
     lace_startup(0, NULL, NULL); // auto-detect program stack, do not use a callback for startup
 
     // Lace is initialized, now set local variables
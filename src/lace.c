@@ -48,6 +48,13 @@ static unsigned int n_nodes, n_cores, n_pus;
 #   define MAP_ANONYMOUS MAP_ANON
 #endif
 
+/**
+ * define MAP_NORESERVE on systems that do not have it
+ */
+#ifndef MAP_NORESERVE
+#   define MAP_NORESERVE 0
+#endif
+
 /**
  * (public) Worker data
  */
@@ -55,15 +62,22 @@ static Worker **workers = NULL;
 
 /**
  * Default sizes for program stack and task deque
+ * The task deque is committed with <default_dqsize> tasks and grows up to <max_dqsize> tasks.
  */
 static size_t default_stacksize = 0; // 0 means "set by lace_init"
-static size_t default_dqsize = 100000;
+static size_t default_dqsize = 65536;
+static size_t max_dqsize = 16777216;
 
 /**
  * Verbosity flag, set with lace_set_verbosity
  */
 static int verbosity = 0;
 
+/**
+ * Threshold for lazy task creation, set with lace_set_inline_threshold
+ */
+static unsigned int inline_threshold = 0;
+
 /**
  * Number of workers and number of enabled/active workers
  */
@@ -90,10 +104,15 @@ typedef struct {
 static worker_data **workers_memory = NULL;
 
 /**
- * Number of bytes allocated for each worker's worker data.
+ * Number of bytes reserved for each worker's worker data.
  */
 static size_t workers_memory_size = 0;
 
+/**
+ * (Secret) holds the number of committed tasks in the deque of each worker
+ */
+static size_t *workers_dqsize = NULL;
+
 /**
  * (Secret) holds pointer to private Worker data, just for stats collection at end
  */
@@ -126,6 +145,13 @@ static pthread_attr_t worker_attr;
 static pthread_cond_t wait_until_done = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t wait_until_done_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * Flags for lace_startup_background: Worker 0 steals until <background_quits> is set,
+ * then exits Lace and sets <background_done>.
+ */
+static int background_quits = 0;
+static int background_done = 0;
+
 /**
  * Data structure that contains the stack and stack size for each worker.
  */
@@ -142,6 +168,23 @@ static struct lace_worker_init *workers_init;
  */
 lace_newframe_t lace_newframe;
 
+/**
+ * Queue of tasks submitted with lace_run_task by threads that are not Lace workers.
+ * Workers read run_queue_head without locking to check for work; the mutex guards the queue
+ * and the condition signals completed tasks to the waiting threads.
+ */
+typedef struct lace_run_request
+{
+    Task *task;
+    volatile int done;
+    struct lace_run_request *next;
+} lace_run_request_t;
+
+static lace_run_request_t * volatile run_queue_head = NULL;
+static lace_run_request_t *run_queue_tail = NULL;
+static pthread_mutex_t run_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_queue_cond = PTHREAD_COND_INITIALIZER;
+
 /**
  * Get the private Worker data of the current thread
  */
@@ -257,6 +300,9 @@ barrier_t lace_bar;
 void
 lace_barrier()
 {
+    WorkerP *w = unlikely(lace_tracing) ? lace_get_worker() : NULL;
+    if (w != NULL) lace_trace_event(w, "barrier", 'B');
+
     int wait = lace_bar.wait;
     if ((int)enabled_workers == __sync_add_and_fetch(&lace_bar.count, 1)) {
         lace_bar.count = 0;
@@ -267,6 +313,8 @@ lace_barrier()
     }
 
     __sync_add_and_fetch(&lace_bar.leaving, -1);
+
+    if (w != NULL) lace_trace_event(w, "barrier", 'E');
 }
 
 /**
@@ -401,12 +449,30 @@ lace_pin_worker(void)
 #endif
 }
 
+/**
+ * Commit memory for (at least) the first <dqsize> tasks in the deque of worker <worker>.
+ * Returns 0 on success.
+ */
+static int
+lace_deque_commit(unsigned int worker, size_t dqsize)
+{
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t size = sizeof(worker_data) + sizeof(Task) * dqsize;
+    size = (size + pagesize - 1) & ~(pagesize - 1); // ceil(size, pagesize)
+    if (size > workers_memory_size) size = workers_memory_size;
+
+    if (mprotect(workers_memory[worker], size, PROT_READ|PROT_WRITE) != 0) return -1;
+
+    workers_dqsize[worker] = (size - sizeof(worker_data)) / sizeof(Task);
+    return 0;
+}
+
 void
 lace_init_worker(unsigned int worker)
 {
-    // Allocate our memory
-    workers_memory[worker] = mmap(NULL, workers_memory_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-    if (workers_memory[worker] == MAP_FAILED) {
+    // Reserve memory for the largest deque, but only commit the initial deque
+    workers_memory[worker] = mmap(NULL, workers_memory_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (workers_memory[worker] == MAP_FAILED || lace_deque_commit(worker, default_dqsize) != 0) {
         fprintf(stderr, "Lace error: Unable to allocate memory for the Lace worker!\n");
         exit(1);
     }
@@ -429,9 +495,10 @@ lace_init_worker(unsigned int worker)
 
     // Initialize private worker data
     w->_public = wt;
-    w->end = w->dq + default_dqsize;
+    w->end = w->dq; // high water mark, extended by lace_deque_grow
     w->split = w->dq;
     w->allstolen = 0;
+    w->inline_threshold = inline_threshold;
     w->worker = worker;
 #if LACE_USE_HWLOC
     w->pu = worker % n_cores;
@@ -648,6 +715,57 @@ VOID_TASK_0(lace_steal_random)
     }
 }
 
+/**
+ * Take a task from the run queue (if any) and execute it.
+ */
+static void __attribute__((noinline))
+lace_run_queued(WorkerP *__lace_worker, Task *__lace_dq_head)
+{
+    pthread_mutex_lock(&run_queue_mutex);
+    lace_run_request_t *req = run_queue_head;
+    if (req != NULL) {
+        run_queue_head = req->next;
+        if (run_queue_head == NULL) run_queue_tail = NULL;
+    }
+    pthread_mutex_unlock(&run_queue_mutex);
+    if (req == NULL) return;
+
+    Task *t = req->task;
+    lace_time_event(__lace_worker, 1);
+    LACE_TRACE_BEGIN("run");
+    t->f(__lace_worker, __lace_dq_head, t);
+    LACE_TRACE_END("run");
+    lace_time_event(__lace_worker, 2);
+
+    pthread_mutex_lock(&run_queue_mutex);
+    req->done = 1;
+    pthread_cond_broadcast(&run_queue_cond);
+    pthread_mutex_unlock(&run_queue_mutex);
+}
+
+void
+lace_run_task(Task *task)
+{
+    WorkerP *w = lace_get_worker();
+    if (w != NULL) {
+        /* we are a Lace worker, execute directly */
+        task->f(w, lace_get_head(w), task);
+        return;
+    }
+
+    lace_run_request_t req;
+    req.task = task;
+    req.done = 0;
+    req.next = NULL;
+
+    pthread_mutex_lock(&run_queue_mutex);
+    if (run_queue_tail == NULL) run_queue_head = &req;
+    else run_queue_tail->next = &req;
+    run_queue_tail = &req;
+    while (!req.done) pthread_cond_wait(&run_queue_cond, &run_queue_mutex);
+    pthread_mutex_unlock(&run_queue_mutex);
+}
+
 /**
  * Variable to hold the main/root task.
  */
@@ -715,8 +833,15 @@ VOID_TASK_1(lace_steal_loop, int*, quit)
             PR_COUNTSTEALS(__lace_worker, CTR_steal_busy);
         }
 
+        if (unlikely(lace_tracing) && res != LACE_STOLEN) lace_trace_idle(__lace_worker);
+
         YIELD_NEWFRAME();
 
+        // Run tasks from other threads (only in the main steal loop, not in a new frame)
+        if (unlikely(run_queue_head != NULL) && (quit == &lace_quits || quit == &background_quits)) {
+            lace_run_queued(__lace_worker, __lace_dq_head);
+        }
+
         if (must_suspend) {
             lace_barrier();
             do {
@@ -756,6 +881,29 @@ lace_run_worker(void)
     lace_barrier();
 }
 
+/**
+ * Worker 0 for lace_startup_background.
+ * Steal until lace_exit is called from another thread, then exit Lace.
+ */
+static void*
+lace_background_wrapper(void *arg)
+{
+    lace_init_worker(0);
+    lace_pin_worker();
+    LACE_ME;
+    CALL(lace_steal_loop, &background_quits);
+    lace_exit();
+
+    // Now signal that we're done
+    pthread_mutex_lock(&wait_until_done_mutex);
+    background_done = 1;
+    pthread_cond_broadcast(&wait_until_done);
+    pthread_mutex_unlock(&wait_until_done_mutex);
+
+    return NULL;
+    (void)arg;
+}
+
 static void*
 lace_default_worker_thread(void* arg)
 {
@@ -812,6 +960,243 @@ lace_spawn_worker(int worker, size_t stacksize, void* (*fun)(void*), void* arg)
     return res;
 }
 
+/**
+ * Set the maximum size of the task deques.
+ */
+void
+lace_set_max_dqsize(size_t _max_dqsize)
+{
+    // tail and split are 32-bit indices
+    if (_max_dqsize > UINT32_MAX) _max_dqsize = UINT32_MAX;
+    max_dqsize = _max_dqsize != 0 ? _max_dqsize : 16777216;
+}
+
+/**
+ * Get the high water mark of the deque of the given worker.
+ */
+size_t
+lace_deque_hwm(unsigned int worker)
+{
+    if (worker >= n_workers || workers_p[worker] == NULL) return 0;
+    return workers_p[worker]->end - workers_p[worker]->dq;
+}
+
+/**
+ * Event tracing. Every worker writes only to its own ring buffer, so no locking is needed.
+ * Workers may still be recording while tracing is (re)enabled, so buffers are never freed before lace_exit:
+ * lace_trace_enable increments the epoch and every worker clears its own buffer at its next event.
+ */
+typedef struct {
+    uint64_t time; // ns since lace_trace_enable
+    const char *name;
+    char phase;
+    unsigned int epoch;
+} lace_trace_entry_t;
+
+typedef struct {
+    lace_trace_entry_t *events;
+    size_t size; // size of the ring buffer
+    size_t count; // number of recorded events (including overwritten events)
+    unsigned int epoch;
+    int idle;
+    char pad[LINE_SIZE-sizeof(lace_trace_entry_t*)-2*sizeof(size_t)-sizeof(unsigned int)-sizeof(int)];
+} lace_trace_buffer_t;
+
+typedef struct lace_trace_retired {
+    lace_trace_buffer_t *buffers;
+    struct lace_trace_retired *next;
+} lace_trace_retired_t;
+
+int lace_tracing = 0;
+static lace_trace_buffer_t * volatile trace_buffers = NULL;
+static lace_trace_retired_t *trace_retired = NULL; // buffers of previous sizes, freed by lace_exit
+static size_t trace_size = 0;
+static volatile unsigned int trace_epoch = 0;
+static uint64_t trace_start = 0;
+
+static uint64_t
+trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+trace_free_buffers(lace_trace_buffer_t *buffers)
+{
+    for (unsigned int i=0; i<n_workers; i++) free(buffers[i].events);
+    free(buffers);
+}
+
+/**
+ * Free all trace buffers. Only call this when the workers are stopped.
+ */
+static void
+trace_free(void)
+{
+    while (trace_retired != NULL) {
+        lace_trace_retired_t *next = trace_retired->next;
+        trace_free_buffers(trace_retired->buffers);
+        free(trace_retired);
+        trace_retired = next;
+    }
+    if (trace_buffers == NULL) return;
+    trace_free_buffers(trace_buffers);
+    trace_buffers = NULL;
+}
+
+void
+lace_trace_enable(size_t n_events)
+{
+    lace_tracing = 0;
+    mfence();
+    if (n_events == 0) n_events = 1048576;
+    if (trace_buffers == NULL || trace_size != n_events) {
+        lace_trace_buffer_t *buffers = (lace_trace_buffer_t*)calloc(n_workers, sizeof(lace_trace_buffer_t));
+        if (buffers == NULL) {
+            fprintf(stderr, "Lace error: Unable to allocate memory for the trace buffers!\n");
+            exit(1);
+        }
+        for (unsigned int i=0; i<n_workers; i++) {
+            buffers[i].events = (lace_trace_entry_t*)malloc(n_events * sizeof(lace_trace_entry_t));
+            buffers[i].size = n_events;
+            if (buffers[i].events == NULL) {
+                fprintf(stderr, "Lace error: Unable to allocate memory for the trace buffers!\n");
+                exit(1);
+            }
+        }
+        if (trace_buffers != NULL) {
+            // workers may still be writing to the old buffers
+            lace_trace_retired_t *r = (lace_trace_retired_t*)malloc(sizeof(lace_trace_retired_t));
+            r->buffers = trace_buffers;
+            r->next = trace_retired;
+            trace_retired = r;
+        }
+        mfence();
+        trace_buffers = buffers;
+        trace_size = n_events;
+    }
+    trace_start = trace_now();
+    mfence();
+    trace_epoch++;
+    mfence();
+    lace_tracing = 1;
+}
+
+void
+lace_trace_disable(void)
+{
+    lace_tracing = 0;
+    mfence();
+}
+
+/**
+ * Get the buffer of worker <w>, clearing it if tracing was enabled again since its last event.
+ */
+static inline lace_trace_buffer_t*
+trace_buffer(WorkerP *w)
+{
+    lace_trace_buffer_t *buffers = trace_buffers;
+    if (buffers == NULL || w == NULL) return NULL;
+    lace_trace_buffer_t *buf = &buffers[w->worker];
+    const unsigned int epoch = trace_epoch;
+    if (buf->epoch != epoch) {
+        buf->epoch = epoch;
+        buf->count = 0;
+        buf->idle = 0;
+    }
+    return buf;
+}
+
+static inline void
+trace_record(lace_trace_buffer_t *buf, const char *name, char phase)
+{
+    lace_trace_entry_t *e = &buf->events[buf->count++ % buf->size];
+    e->time = trace_now() - trace_start;
+    e->name = name;
+    e->phase = phase;
+    e->epoch = buf->epoch;
+}
+
+void
+lace_trace_event(WorkerP *w, const char *name, char phase)
+{
+    lace_trace_buffer_t *buf = trace_buffer(w);
+    if (buf == NULL) return;
+    if (buf->idle) {
+        buf->idle = 0;
+        trace_record(buf, "idle", 'E');
+    }
+    trace_record(buf, name, phase);
+}
+
+void
+lace_trace_idle(WorkerP *w)
+{
+    lace_trace_buffer_t *buf = trace_buffer(w);
+    if (buf == NULL) return;
+    if (!buf->idle) {
+        buf->idle = 1;
+        trace_record(buf, "idle", 'B');
+    }
+}
+
+void
+lace_trace_write(FILE *f)
+{
+    int first = 1;
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (unsigned int i=0; i<n_workers; i++) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}", first ? "" : ",\n", i, i);
+        first = 0;
+    }
+    lace_trace_buffer_t *buffers = trace_buffers;
+    for (unsigned int i=0; buffers != NULL && i<n_workers; i++) {
+        lace_trace_buffer_t *buf = &buffers[i];
+        if (buf->epoch != trace_epoch) continue; // no events since lace_trace_enable
+        const size_t count = buf->count;
+        const size_t from = count > buf->size ? count - buf->size : 0;
+        if (count == from) continue;
+
+        /* Match begin and end events; drop spans that were partially overwritten or are still open */
+        char *keep = (char*)calloc(count-from, 1);
+        size_t *open = (size_t*)malloc(sizeof(size_t[count-from]));
+        size_t depth = 0;
+        for (size_t j=from; j<count; j++) {
+            lace_trace_entry_t *e = &buf->events[j % buf->size];
+            if (e->epoch != buf->epoch) continue;
+            if (e->phase == 'B') {
+                open[depth++] = j;
+            } else if (depth > 0) {
+                keep[open[--depth]-from] = 1;
+                keep[j-from] = 1;
+            }
+        }
+        for (size_t j=from; j<count; j++) {
+            if (!keep[j-from]) continue;
+            lace_trace_entry_t *e = &buf->events[j % buf->size];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}",
+                    e->name, e->phase, e->time / 1000.0, i);
+        }
+        free(open);
+        free(keep);
+    }
+    fprintf(f, "\n]}\n");
+}
+
+/**
+ * Set the threshold for lazy task creation, for all (current and future) workers.
+ */
+void
+lace_set_inline_threshold(unsigned int threshold)
+{
+    inline_threshold = threshold;
+    for (unsigned int i=0; i<n_workers; i++) {
+        if (workers_p != NULL && workers_p[i] != NULL) workers_p[i]->inline_threshold = threshold;
+    }
+}
+
 /**
  * Set the verbosity of Lace.
  */
@@ -850,6 +1235,8 @@ lace_init(unsigned int _n_workers, size_t dqsize)
     enabled_workers = n_workers;
     if (dqsize != 0) default_dqsize = dqsize;
     else dqsize = default_dqsize;
+    if (default_dqsize < 4) default_dqsize = 4; // lace_get_head inspects the first tasks
+    if (max_dqsize < default_dqsize) max_dqsize = default_dqsize;
     lace_quits = 0;
 
     // Initialize Lace barrier
@@ -865,9 +1252,13 @@ lace_init(unsigned int _n_workers, size_t dqsize)
         fprintf(stderr, "Lace error: unable to allocate memory!\n");
         exit(1);
     }
+    memset(workers_p, 0, n_workers*sizeof(WorkerP*));
+    workers_dqsize = (size_t*)calloc(n_workers, sizeof(size_t));
 
-    // Compute memory size for each worker
-    workers_memory_size = sizeof(worker_data) + sizeof(Task) * dqsize;
+    // Compute reserved memory size for each worker
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    workers_memory_size = sizeof(worker_data) + sizeof(Task) * max_dqsize;
+    workers_memory_size = (workers_memory_size + pagesize - 1) & ~(pagesize - 1);
 
     // Create pthread key
 #ifndef __linux__
@@ -946,6 +1337,27 @@ lace_startup(size_t stacksize, lace_startup_cb cb, void *arg)
     }
 }
 
+/**
+ * Start all worker threads, including Worker 0, and return.
+ */
+void
+lace_startup_background(size_t stacksize)
+{
+    if (stacksize == 0) stacksize = default_stacksize;
+
+    /* Report startup if verbose */
+    if (verbosity) {
+        fprintf(stderr, "Lace startup, creating %d background worker threads with program stack %zu bytes.\n", n_workers, stacksize);
+    }
+
+    background_quits = 0;
+    background_done = 0;
+
+    /* Spawn all other workers, then worker 0 */
+    for (unsigned int i=1; i<n_workers; i++) lace_spawn_worker(i, stacksize, 0, 0);
+    lace_spawn_worker(0, stacksize, lace_background_wrapper, NULL);
+}
+
 #if LACE_COUNT_EVENTS
 static uint64_t ctr_all[CTR_MAX];
 #endif
@@ -998,9 +1410,9 @@ lace_count_report_file(FILE *file)
 
 #if LACE_COUNT_TASKS
     for (i=0;i<n_workers;i++) {
-        fprintf(file, "Tasks (%d): %zu\n", i, workers_p[i]->ctr[CTR_tasks]);
+        fprintf(file, "Tasks (%d): %zu (%zu inlined)\n", i, workers_p[i]->ctr[CTR_tasks], workers_p[i]->ctr[CTR_inlined]);
     }
-    fprintf(file, "Tasks (sum): %zu\n", ctr_all[CTR_tasks]);
+    fprintf(file, "Tasks (sum): %zu (%zu inlined)\n", ctr_all[CTR_tasks], ctr_all[CTR_inlined]);
     fprintf(file, "\n");
 #endif
 
@@ -1084,6 +1496,15 @@ lace_count_report_file(FILE *file)
  */
 void lace_exit()
 {
+    if (lace_get_worker() == NULL) {
+        // Not a Lace worker (after lace_startup_background): let Worker 0 exit Lace
+        pthread_mutex_lock(&wait_until_done_mutex);
+        background_quits = 1;
+        while (background_done == 0) pthread_cond_wait(&wait_until_done, &wait_until_done_mutex);
+        pthread_mutex_unlock(&wait_until_done_mutex);
+        return;
+    }
+
     lace_time_event(lace_get_worker(), 2);
 
     // first suspend all enabled threads
@@ -1101,6 +1522,10 @@ void lace_exit()
     lace_barrier_destroy();
     pthread_barrier_destroy(&suspend_barrier);
 
+    // free the trace buffers
+    lace_tracing = 0;
+    trace_free();
+
 #if LACE_COUNT_EVENTS
     lace_count_report_file(stderr);
 #endif
@@ -1136,7 +1561,9 @@ lace_exec_in_new_frame(WorkerP *__lace_worker, Task *__lace_dq_head, Task *root)
     lace_barrier();
 
     // execute task
+    LACE_TRACE_BEGIN("frame");
     root->f(__lace_worker, __lace_dq_head, root);
+    LACE_TRACE_END("frame");
     compiler_barrier();
 
     // wait until all workers are back (else they may steal from previous frame)
@@ -1251,12 +1678,45 @@ lace_do_newframe(WorkerP *__lace_worker, Task *__lace_dq_head, Task *t)
     lace_sync_and_exec(__lace_worker, __lace_dq_head, &_t2);
 }
 
+/**
+ * Placeholder for tasks that were executed directly by SPAWN.
+ * The result is already stored in the task, so a thief has nothing to do.
+ */
+void
+lace_inlined(WorkerP *w, Task *__dq_head, Task *t)
+{
+    (void)w;
+    (void)__dq_head;
+    (void)t;
+}
+
 /**
  * Called by _SPAWN functions when the Task stack is full.
  */
 void
 lace_abort_stack_overflow(void)
 {
-    fprintf(stderr, "Lace fatal error: Task stack overflow! Aborting.\n");
+    fprintf(stderr, "Lace fatal error: Task stack overflow (more than %zu tasks)! Aborting.\n", max_dqsize);
     exit(-1);
 }
+
+/**
+ * Called by _SPAWN functions when the head reaches the high water mark.
+ * Commits more memory (doubling the committed part) when the high water mark
+ * reaches the end of the committed part of the deque.
+ */
+void
+lace_deque_grow(WorkerP *w)
+{
+    size_t hwm = w->end - w->dq;
+    if (hwm >= max_dqsize) lace_abort_stack_overflow();
+    if (hwm >= workers_dqsize[w->worker]) {
+        size_t dqsize = hwm * 2;
+        if (dqsize > max_dqsize) dqsize = max_dqsize;
+        if (lace_deque_commit(w->worker, dqsize) != 0) {
+            fprintf(stderr, "Lace error: Unable to commit memory for the task deque!\n");
+            exit(1);
+        }
+    }
+    w->end++;
+}
@@ -16,6 +16,7 @@
  */
 
 #include <unistd.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <pthread.h> /* for pthread_t */
@@ -82,6 +83,15 @@ typedef struct _Task Task;
  */
 LACE_TYPEDEF_CB(void, lace_startup_cb, void*);
 
+/**
+ * Set the threshold for lazy task creation (0 = disabled, default).
+ * When a worker has at least <threshold> tasks on its deque that are not shared with thieves,
+ * and no thief has requested more work since the last split adjustment, then SPAWN directly
+ * executes the task instead of pushing it for stealing. The result is kept in the task slot,
+ * so SYNC returns it without executing the task again.
+ */
+void lace_set_inline_threshold(unsigned int threshold);
+
 /**
  * Set verbosity level (0 = no startup messages, 1 = startup messages)
  * Default level: 0
@@ -89,12 +99,50 @@ LACE_TYPEDEF_CB(void, lace_startup_cb, void*);
 void lace_set_verbosity(int level);
 
 /**
- * Initialize Lace for <n_workers> workers with a deque size of <dqsize> per worker.
+ * Initialize Lace for <n_workers> workers with an initial deque size of <dqsize> per worker.
  * If <n_workers> is set to 0, automatically detects available cores.
  * If <dqsize> is est to 0, uses a reasonable default value.
+ *
+ * The task deques grow on demand, up to the maximum set with lace_set_max_dqsize.
+ * Only the memory of the initial deque is committed in advance.
  */
 void lace_init(unsigned int n_workers, size_t dqsize);
 
+/**
+ * Set the maximum number of tasks on each task deque.
+ * Lace reserves (but does not commit) virtual memory for this many tasks per worker.
+ * Call this before lace_init. If <max_dqsize> is set to 0, uses the default value.
+ */
+void lace_set_max_dqsize(size_t max_dqsize);
+
+/**
+ * Retrieve the high-water mark of the task deque of worker <worker>, that is,
+ * the highest number of tasks that were simultaneously on that deque.
+ */
+size_t lace_deque_hwm(unsigned int worker);
+
+/**
+ * Start recording scheduling events (steals, leapfrogging, idle periods, barriers and
+ * user-defined spans) in a ring buffer of <n_events> events per worker.
+ * Call this after lace_init. Each call clears previously recorded events.
+ * If <n_events> is set to 0, uses a reasonable default value.
+ */
+void lace_trace_enable(size_t n_events);
+
+/**
+ * Stop recording events. Recorded events are kept until lace_trace_enable or lace_exit.
+ */
+void lace_trace_disable(void);
+
+/**
+ * Write the recorded events to <f> in the Chrome trace event format (JSON),
+ * which can be viewed with chrome://tracing or https://ui.perfetto.dev.
+ * When a ring buffer overflows, the oldest events of that worker are overwritten.
+ * Spans of which the begin or the end event is not in the ring buffer are left out.
+ * Only call this while the workers are not running tasks.
+ */
+void lace_trace_write(FILE *f);
+
 /**
  * Let Lace create worker threads.
  * If <stacksize> is set to 0, uses a reaonable default value.
@@ -105,6 +153,14 @@ void lace_init(unsigned int n_workers, size_t dqsize);
  */
 void lace_startup(size_t stacksize, lace_startup_cb, void* arg);
 
+/**
+ * Let Lace create all worker threads, including Worker 0, and return immediately.
+ * If <stacksize> is set to 0, uses a reaonable default value.
+ * The current thread does not become a Lace worker. Any thread can then run tasks with
+ * RUN or lace_run_task. Call lace_exit from a thread that is not a Lace worker to stop.
+ */
+void lace_startup_background(size_t stacksize);
+
 /**
  * Initialize worker <worker>, allocating memory.
  * If <worker> is 0, then the current thread is the main worker.
@@ -187,10 +243,24 @@ WorkerP *lace_get_worker();
  */
 Task *lace_get_head(WorkerP *);
 
+/**
+ * Run the given task from any thread, and wait until it is completed.
+ * If the current thread is a Lace worker, the task is executed directly.
+ * Otherwise, the task is queued and executed by the next idle worker, as if the worker stole it.
+ * Several threads can submit tasks simultaneously; the tasks then share the workers.
+ * Queued tasks are only taken by workers that are in their steal loop, and all workers must
+ * regularly reach the steal loop or YIELD_NEWFRAME (for instance for garbage collection).
+ * Use lace_startup_background so no worker blocks outside of Lace.
+ * Do not call lace_exit while tasks are queued.
+ * Usually called via RUN(f, ...), see below.
+ */
+void lace_run_task(Task *task);
+
 /**
  * Exit Lace.
  * This function is automatically called when lace_startup is called with a callback.
  * This function must be called to exit Lace when lace_startup is called without a callback.
+ * After lace_startup_background, call this function from a thread that is not a Lace worker.
  */
 void lace_exit();
 
@@ -234,6 +304,11 @@ void lace_exit();
  */
 #define NEWFRAME(f, ...)  ( WRAP(f##_NEWFRAME, ##__VA_ARGS__) )
 
+/**
+ * Run a task from a thread that need not be a Lace worker (see lace_run_task).
+ */
+#define RUN(f, ...)       ( f##_RUN(__VA_ARGS__) )
+
 /**
  * (Try to) steal a task from a random worker.
  */
@@ -270,6 +345,12 @@ void lace_yield(WorkerP *__lace_worker, Task *__lace_dq_head);
  */
 #define TASK_IS_COMPLETED(t) ((size_t)t->thief == 2)
 
+/**
+ * True if the given task was executed directly by SPAWN (see lace_set_inline_threshold).
+ * The result of an inlined task is available via TASK_RESULT.
+ */
+#define TASK_IS_INLINED(t) ((void*)(t)->f == (void*)&lace_inlined)
+
 /**
  * Retrieves a pointer to the result of the given task.
  */
@@ -351,8 +432,10 @@ void lace_count_report_file(FILE *file);
 
 #if LACE_COUNT_TASKS
 #define PR_COUNTTASK(s) PR_INC(s,CTR_tasks)
+#define PR_COUNTINLINED(s) PR_INC(s,CTR_inlined)
 #else
 #define PR_COUNTTASK(s) /* Empty */
+#define PR_COUNTINLINED(s) /* Empty */
 #endif
 
 #if LACE_COUNT_STEALS
@@ -377,6 +460,7 @@ void lace_count_report_file(FILE *file);
 typedef enum {
 #ifdef LACE_COUNT_TASKS
     CTR_tasks,       /* Number of tasks spawned */
+    CTR_inlined,     /* Number of tasks executed directly by SPAWN */
 #endif
 #ifdef LACE_COUNT_STEALS
     CTR_steal_tries, /* Number of steal attempts */
@@ -447,11 +531,12 @@ typedef struct _Worker {
 typedef struct _WorkerP {
     Task *dq;                   // same as dq
     Task *split;                // same as dq+ts.ts.split
-    Task *end;                  // dq+dq_size
+    Task *end;                  // dq+high water mark (grows with lace_deque_grow)
     Worker *_public;            // pointer to public Worker struct
     size_t stack_trigger;       // for stack overflow detection
     uint64_t rng;               // my random seed (for lace_trng)
     uint32_t seed;              // my random seed (for lace_steal_random)
+    uint32_t inline_threshold;  // lazy task creation threshold (0 = disabled)
     uint16_t worker;            // what is my worker id?
     uint8_t allstolen;          // my allstolen
     volatile int8_t enabled;    // if this worker is enabled
@@ -487,6 +572,40 @@ static inline void CHECKSTACK(WorkerP *w)
 
 void lace_abort_stack_overflow(void) __attribute__((noreturn));
 
+/**
+ * Placeholder task function for tasks that were executed directly by SPAWN.
+ * The task slot stays on the deque until SYNC; if it is stolen, nothing is executed.
+ */
+void lace_inlined(WorkerP *w, Task *__dq_head, Task *t);
+
+/**
+ * Called by _SPAWN functions when the head reaches the end of the deque.
+ * Extends the deque, committing more memory when needed.
+ * Aborts when the maximum deque size is reached.
+ */
+void lace_deque_grow(WorkerP *w);
+
+/**
+ * Set by lace_trace_enable and lace_trace_disable.
+ */
+extern int lace_tracing;
+
+/**
+ * Record an event with name <name> (a string literal) and phase <phase> ('B' to begin
+ * a span, 'E' to end it) on the trace of worker <w>.
+ * Use LACE_TRACE_BEGIN and LACE_TRACE_END, which only record when tracing is enabled.
+ */
+void lace_trace_event(WorkerP *w, const char *name, char phase);
+
+/**
+ * Mark the start of an idle period of worker <w>, i.e., a worker that looks for work.
+ * The idle period ends at the next recorded event of <w>.
+ */
+void lace_trace_idle(WorkerP *w);
+
+#define LACE_TRACE_BEGIN(name) { if (unlikely(lace_tracing)) lace_trace_event(__lace_worker, name, 'B'); }
+#define LACE_TRACE_END(name) { if (unlikely(lace_tracing)) lace_trace_event(__lace_worker, name, 'E'); }
+
 typedef struct
 {
     Task *t;
@@ -627,7 +746,9 @@ lace_steal(WorkerP *self, Task *__dq_head, Worker *victim)
                 Task *t = &victim->dq[ts.ts.tail];
                 t->thief = self->_public;
                 lace_time_event(self, 1);
+                if (unlikely(lace_tracing)) lace_trace_event(self, "steal", 'B');
                 t->f(self, __dq_head, t);
+                if (unlikely(lace_tracing)) lace_trace_event(self, "steal", 'E');
                 lace_time_event(self, 2);
                 t->thief = THIEF_COMPLETED;
                 lace_time_event(self, 8);
@@ -685,6 +806,7 @@ lace_leapfrog(WorkerP *__lace_worker, Task *__lace_dq_head)
     Task *t = __lace_dq_head;
     Worker *thief = t->thief;
     if (thief != THIEF_COMPLETED) {
+        LACE_TRACE_BEGIN("leapfrog");
         while ((size_t)thief <= 1) thief = t->thief;
 
         /* PRE-LEAP: increase head again */
@@ -717,6 +839,7 @@ lace_leapfrog(WorkerP *__lace_worker, Task *__lace_dq_head)
             wt->allstolen = 1;
             __lace_worker->allstolen = 1;
         }
+        LACE_TRACE_END("leapfrog");
     }
 
     compiler_barrier();
@@ -769,12 +892,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head )
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head );                                       \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-                                                                                      \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -824,6 +955,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head )
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(void)                                                                \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+                                                                                      \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -853,6 +997,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head );                                                \
 }                                                                                     \
                                                                                       \
@@ -865,6 +1010,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head );                                        \
         }                                                                             \
     }                                                                                 \
@@ -919,12 +1065,19 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head )
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head );                                                   \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-                                                                                      \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -974,6 +1127,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head )
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(void)                                                                 \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+                                                                                      \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1003,6 +1169,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head );                                                \
 }                                                                                     \
                                                                                       \
@@ -1015,6 +1182,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head );                                        \
         }                                                                             \
     }                                                                                 \
@@ -1072,12 +1240,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1);                                \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1;                                                      \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1;                                                         \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1127,6 +1304,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1)                                                       \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1;                                                         \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1156,6 +1346,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                               \
 }                                                                                     \
                                                                                       \
@@ -1168,6 +1359,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                       \
         }                                                                             \
     }                                                                                 \
@@ -1222,12 +1414,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1);                                            \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1;                                                      \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1;                                                         \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1277,6 +1477,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1)                                                        \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1;                                                         \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1306,6 +1519,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                               \
 }                                                                                     \
                                                                                       \
@@ -1318,6 +1532,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1);                       \
         }                                                                             \
     }                                                                                 \
@@ -1375,12 +1590,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2);                         \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                             \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1430,6 +1654,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2)                                        \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1459,6 +1696,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);              \
 }                                                                                     \
                                                                                       \
@@ -1471,6 +1709,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);      \
         }                                                                             \
     }                                                                                 \
@@ -1525,12 +1764,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2);                                     \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                             \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1580,6 +1827,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2)
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2)                                         \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2;                                \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1609,6 +1869,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);              \
 }                                                                                     \
                                                                                       \
@@ -1621,6 +1882,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2);      \
         }                                                                             \
     }                                                                                 \
@@ -1678,12 +1940,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3);                  \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;    \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1733,6 +2004,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)                         \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -1762,6 +2046,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
 }                                                                                     \
                                                                                       \
@@ -1774,6 +2059,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
         }                                                                             \
     }                                                                                 \
@@ -1828,12 +2114,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3);                              \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;    \
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -1883,6 +2177,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3)                          \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3;       \
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -1912,6 +2219,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
 }                                                                                     \
                                                                                       \
@@ -1924,6 +2232,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3);\
         }                                                                             \
     }                                                                                 \
@@ -1981,12 +2290,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4);           \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2036,6 +2354,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)          \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -2065,6 +2396,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
 }                                                                                     \
                                                                                       \
@@ -2077,6 +2409,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
         }                                                                             \
     }                                                                                 \
@@ -2131,12 +2464,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4);                       \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2186,6 +2527,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4)           \
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2215,6 +2569,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
 }                                                                                     \
                                                                                       \
@@ -2227,6 +2582,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4);\
         }                                                                             \
     }                                                                                 \
@@ -2284,12 +2640,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);    \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2339,6 +2704,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -2368,6 +2746,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
 }                                                                                     \
                                                                                       \
@@ -2380,6 +2759,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
         }                                                                             \
     }                                                                                 \
@@ -2434,12 +2814,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5);                \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2489,6 +2877,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5)\
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2518,6 +2919,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
 }                                                                                     \
                                                                                       \
@@ -2530,6 +2932,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5);\
         }                                                                             \
     }                                                                                 \
@@ -2587,12 +2990,21 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        RTYPE res = NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);\
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        t->d.res = res;                                                               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2642,6 +3054,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+RTYPE NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ((TD_##NAME *)t)->d.res;                                                   \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                   \
 {                                                                                     \
@@ -2671,6 +3096,7 @@ RTYPE NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return t->d.res;                                          \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
 }                                                                                     \
                                                                                       \
@@ -2683,6 +3109,7 @@ RTYPE NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return t->d.res;                                  \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
         }                                                                             \
     }                                                                                 \
@@ -2737,12 +3164,20 @@ void NAME##_SPAWN(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2, AT
     TailSplit ts;                                                                     \
     uint32_t head, split, newsplit;                                                   \
                                                                                       \
-    if (__dq_head == w->end) lace_abort_stack_overflow();                             \
+    if (unlikely(__dq_head == w->end)) lace_deque_grow(w);                            \
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
-    t->f = &NAME##_WRAP;                                                              \
+    if (w->inline_threshold && !w->allstolen && !w->_public->movesplit &&             \
+            __dq_head - w->split >= (ptrdiff_t)w->inline_threshold) {                 \
+        /* enough private work and no steal requests: execute directly */             \
+        NAME##_CALL(w, __dq_head , arg_1, arg_2, arg_3, arg_4, arg_5, arg_6);         \
+        t->f = (void (*)(WorkerP *, Task *, TD_##NAME *))&lace_inlined;               \
+        PR_COUNTINLINED(w);                                                           \
+    } else {                                                                          \
+        t->f = &NAME##_WRAP;                                                          \
+        t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+    }                                                                                 \
     t->thief = THIEF_TASK;                                                            \
-     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
     compiler_barrier();                                                               \
                                                                                       \
     Worker *wt = w->_public;                                                          \
@@ -2792,6 +3227,19 @@ void NAME##_TOGETHER(WorkerP *w, Task *__dq_head , ATYPE_1 arg_1, ATYPE_2 arg_2,
     lace_do_together(w, __dq_head, &_t);                                              \
 }                                                                                     \
                                                                                       \
+static inline __attribute__((unused))                                                 \
+void NAME##_RUN(ATYPE_1 arg_1, ATYPE_2 arg_2, ATYPE_3 arg_3, ATYPE_4 arg_4, ATYPE_5 arg_5, ATYPE_6 arg_6)\
+{                                                                                     \
+    Task _t;                                                                          \
+    TD_##NAME *t = (TD_##NAME *)&_t;                                                  \
+    t->f = &NAME##_WRAP;                                                              \
+    t->thief = THIEF_TASK;                                                            \
+     t->d.args.arg_1 = arg_1; t->d.args.arg_2 = arg_2; t->d.args.arg_3 = arg_3; t->d.args.arg_4 = arg_4; t->d.args.arg_5 = arg_5; t->d.args.arg_6 = arg_6;\
+                                                                                      \
+    lace_run_task(&_t);                                                               \
+    return ;                                                                          \
+}                                                                                     \
+                                                                                      \
 static __attribute__((noinline))                                                      \
 void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)                                    \
 {                                                                                     \
@@ -2821,6 +3269,7 @@ void NAME##_SYNC_SLOW(WorkerP *w, Task *__dq_head)
                                                                                       \
     t = (TD_##NAME *)__dq_head;                                                       \
     t->thief = THIEF_EMPTY;                                                           \
+    if (TASK_IS_INLINED(t)) return ;                                                  \
     return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
 }                                                                                     \
                                                                                       \
@@ -2833,6 +3282,7 @@ void NAME##_SYNC(WorkerP *w, Task *__dq_head)
         if (likely(w->split <= __dq_head)) {                                          \
             TD_##NAME *t = (TD_##NAME *)__dq_head;                                    \
             t->thief = THIEF_EMPTY;                                                   \
+            if (TASK_IS_INLINED(t)) return ;                                          \
             return NAME##_CALL(w, __dq_head , t->d.args.arg_1, t->d.args.arg_2, t->d.args.arg_3, t->d.args.arg_4, t->d.args.arg_5, t->d.args.arg_6);\
         }                                                                             \
     }                                                                                 \
@@ -21,8 +21,6 @@
 #include <math.h>
 #include <string.h>
 
-#include <avl.h>
-
 static int granularity = 1; // default
 
 void
@@ -37,6 +35,17 @@ sylvan_get_granularity()
     return granularity;
 }
 
+/**
+ * Decide whether to use the operation cache for operation <opid> when going from <prev_level> to <level>.
+ * In adaptive mode, the granularity is taken from the per-operation granularity table.
+ */
+static inline int
+bdd_cachenow(uint64_t opid, BDDVAR prev_level, BDDVAR level)
+{
+    const int g = unlikely(cache_adaptive) ? cache_granularity(opid, level) : granularity;
+    return g < 2 || prev_level == 0 ? 1 : prev_level / g != level / g;
+}
+
 /**
  * Implementation of unary, binary and if-then-else operators.
  */
@@ -69,10 +78,10 @@ TASK_IMPL_3(BDD, sylvan_and, BDD, a, BDD, b, BDDVAR, prev_level)
     BDDVAR vb = bddnode_getvariable(nb);
     BDDVAR level = va < vb ? va : vb;
 
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_AND, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_AND, a, b, sylvan_false, &result)) {
+        if (cache_get3_level(CACHE_BDD_AND, level, a, b, sylvan_false, &result)) {
             sylvan_stats_count(BDD_AND_CACHED);
             return result;
         }
@@ -166,10 +175,10 @@ TASK_IMPL_3(BDD, sylvan_xor, BDD, a, BDD, b, BDDVAR, prev_level)
     BDDVAR vb = bddnode_getvariable(nb);
     BDDVAR level = va < vb ? va : vb;
 
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_XOR, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_XOR, a, b, sylvan_false, &result)) {
+        if (cache_get3_level(CACHE_BDD_XOR, level, a, b, sylvan_false, &result)) {
             sylvan_stats_count(BDD_XOR_CACHED);
             return result;
         }
@@ -280,10 +289,10 @@ TASK_IMPL_4(BDD, sylvan_ite, BDD, a, BDD, b, BDD, c, BDDVAR, prev_level)
     /* Count operation */
     sylvan_stats_count(BDD_ITE);
 
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_ITE, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_ITE, a, b, c, &result)) {
+        if (cache_get3_level(CACHE_BDD_ITE, level, a, b, c, &result)) {
             sylvan_stats_count(BDD_ITE_CACHED);
             return mark ? sylvan_not(result) : result;
         }
@@ -343,6 +352,186 @@ TASK_IMPL_4(BDD, sylvan_ite, BDD, a, BDD, b, BDD, c, BDDVAR, prev_level)
     return mark ? sylvan_not(result) : result;
 }
 
+/**
+ * N-ary conjunction. In every round, the operands are sorted by their number of nodes and
+ * the smallest operands are paired (as in a Huffman merge). All pairs of a round are computed
+ * in parallel. The disjunction is the negation of the conjunction of the negated operands.
+ */
+typedef struct bdd_many_item {
+    BDD bdd;
+    size_t size;
+} bdd_many_item_t;
+
+static int
+bdd_many_cmp(const void *a, const void *b)
+{
+    const size_t sa = ((const bdd_many_item_t*)a)->size;
+    const size_t sb = ((const bdd_many_item_t*)b)->size;
+    return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+VOID_TASK_4(sylvan_and_pairs, const bdd_many_item_t*, items, bdd_many_item_t*, out, size_t, first, size_t, count)
+{
+    if (count > 1) {
+        SPAWN(sylvan_and_pairs, items, out, first, count/2);
+        CALL(sylvan_and_pairs, items, out, first+count/2, count-count/2);
+        SYNC(sylvan_and_pairs);
+    } else {
+        out[first].bdd = sylvan_and(items[2*first].bdd, items[2*first+1].bdd);
+    }
+}
+
+TASK_3(BDD, sylvan_and_many_go, const BDD*, arr, size_t, n, int, negate)
+{
+    bdd_many_item_t *items = (bdd_many_item_t*)malloc(sizeof(bdd_many_item_t[n]));
+    bdd_many_item_t *out = (bdd_many_item_t*)malloc(sizeof(bdd_many_item_t[n/2+1]));
+
+    /* Skip the operands that are true */
+    size_t count = 0;
+    int is_false = 0;
+    for (size_t i=0; i<n && !is_false; i++) {
+        const BDD a = negate ? sylvan_not(arr[i]) : arr[i];
+        if (a == sylvan_false) is_false = 1;
+        else if (a != sylvan_true) items[count++].bdd = a;
+    }
+
+    BDD result;
+    if (is_false) {
+        result = sylvan_false;
+    } else if (count == 0) {
+        result = sylvan_true;
+    } else {
+        for (size_t i=0; i<count; i++) bdd_refs_pushptr(&items[i].bdd);
+        for (size_t i=0; i<count/2; i++) bdd_refs_pushptr(&out[i].bdd);
+        const size_t pushed = count + count/2;
+
+        for (size_t i=0; i<count; i++) items[i].size = sylvan_nodecount(items[i].bdd);
+        while (count > 1) {
+            /* Pair the smallest operands, keep the largest one if the number is odd */
+            qsort(items, count, sizeof(bdd_many_item_t), bdd_many_cmp);
+            const size_t pairs = count/2;
+            for (size_t i=0; i<pairs; i++) out[i].bdd = sylvan_false;
+            CALL(sylvan_and_pairs, items, out, 0, pairs);
+
+            for (size_t i=0; i<pairs; i++) {
+                if (out[i].bdd == sylvan_false) is_false = 1;
+                items[i].bdd = out[i].bdd;
+                items[i].size = sylvan_nodecount(out[i].bdd);
+            }
+            if (count & 1) items[pairs] = items[count-1];
+            count = pairs + (count & 1);
+            if (is_false) {
+                items[0].bdd = sylvan_false;
+                count = 1;
+            }
+        }
+
+        result = items[0].bdd;
+        bdd_refs_popptr(pushed);
+    }
+
+    free(items);
+    free(out);
+    return negate ? sylvan_not(result) : result;
+}
+
+TASK_IMPL_2(BDD, sylvan_and_many, const BDD*, arr, size_t, n)
+{
+    return CALL(sylvan_and_many_go, arr, n, 0);
+}
+
+TASK_IMPL_2(BDD, sylvan_or_many, const BDD*, arr, size_t, n)
+{
+    return CALL(sylvan_and_many_go, arr, n, 1);
+}
+
+/**
+ * Conjunction with early quantification. The conjuncts are scheduled greedily, as in IWLS95:
+ * the next conjunct is the one whose score is highest, where the score is the number of
+ * variables that occur in no other remaining conjunct (and can be quantified right away)
+ * minus the number of variables that it adds to the intermediate product.
+ * Only variables in <vars> are counted. Ties are broken by the order of the conjuncts.
+ * Every variable is quantified together with its last conjunct in the schedule.
+ */
+TASK_IMPL_3(BDD, sylvan_and_exists_many, const BDD*, arr, size_t, n, BDDSET, vars)
+{
+    const size_t nvars = sylvan_set_count(vars);
+    uint32_t *qvars = (uint32_t*)malloc(sizeof(uint32_t[nvars+1]));
+    sylvan_set_toarray(vars, qvars);
+
+    /* For every conjunct, the indices (in qvars) of the variables in its support */
+    uint32_t **supp = (uint32_t**)malloc(sizeof(uint32_t*[n+1]));
+    size_t *supp_len = (size_t*)malloc(sizeof(size_t[n+1]));
+    uint32_t *remaining = (uint32_t*)calloc(nvars+1, sizeof(uint32_t));
+    char *alive = (char*)calloc(nvars+1, 1);
+    char *done = (char*)calloc(n+1, 1);
+    for (size_t i=0; i<n; i++) {
+        const BDD support = sylvan_support(arr[i]);
+        const size_t count = sylvan_set_count(support);
+        uint32_t *support_vars = (uint32_t*)malloc(sizeof(uint32_t[count+1]));
+        sylvan_set_toarray(support, support_vars);
+        /* both arrays are sorted; keep the variables that are quantified */
+        size_t k = 0, len = 0;
+        for (size_t j=0; j<count; j++) {
+            while (k < nvars && qvars[k] < support_vars[j]) k++;
+            if (k < nvars && qvars[k] == support_vars[j]) {
+                support_vars[len++] = k;
+                remaining[k]++;
+            }
+        }
+        supp[i] = support_vars;
+        supp_len[i] = len;
+    }
+
+    uint32_t *step = (uint32_t*)malloc(sizeof(uint32_t[nvars+1]));
+    BDD result = sylvan_true;
+    bdd_refs_pushptr(&result);
+
+    for (size_t k=0; k<n && result != sylvan_false; k++) {
+        /* Select the next conjunct */
+        size_t best = n;
+        long best_score = 0;
+        for (size_t i=0; i<n; i++) {
+            if (done[i]) continue;
+            long score = 0;
+            for (size_t j=0; j<supp_len[i]; j++) {
+                const uint32_t v = supp[i][j];
+                if (remaining[v] == 1) score++;
+                if (!alive[v]) score--;
+            }
+            if (best == n || score > best_score) {
+                best = i;
+                best_score = score;
+            }
+        }
+        done[best] = 1;
+
+        /* Quantify the variables that occur in no remaining conjunct */
+        size_t count = 0;
+        for (size_t j=0; j<supp_len[best]; j++) {
+            const uint32_t v = supp[best][j];
+            alive[v] = 1;
+            if (--remaining[v] == 0) step[count++] = qvars[v];
+        }
+        BDD cube = sylvan_set_fromarray(step, count);
+        bdd_refs_push(cube);
+        result = sylvan_and_exists(result, arr[best], cube);
+        bdd_refs_pop(1);
+    }
+
+    bdd_refs_popptr(1);
+
+    for (size_t i=0; i<n; i++) free(supp[i]);
+    free(supp);
+    free(supp_len);
+    free(remaining);
+    free(alive);
+    free(done);
+    free(step);
+    free(qvars);
+    return result;
+}
+
 /**
  * Compute constrain f@c, also called the generalized co-factor.
  * c is the "care function" - f@c equals f when c evaluates to True.
@@ -377,10 +566,10 @@ TASK_IMPL_3(BDD, sylvan_constrain, BDD, f, BDD, c, BDDVAR, prev_level)
     }
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_CONSTRAIN, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_CONSTRAIN, f, c, 0, &result)) {
+        if (cache_get3_level(CACHE_BDD_CONSTRAIN, level, f, c, 0, &result)) {
             sylvan_stats_count(BDD_CONSTRAIN_CACHED);
             return mark ? sylvan_not(result) : result;
         }
@@ -470,10 +659,10 @@ TASK_IMPL_3(BDD, sylvan_restrict, BDD, f, BDD, c, BDDVAR, prev_level)
     }
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_RESTRICT, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_RESTRICT, f, c, 0, &result)) {
+        if (cache_get3_level(CACHE_BDD_RESTRICT, level, f, c, 0, &result)) {
             sylvan_stats_count(BDD_RESTRICT_CACHED);
             return mark ? sylvan_not(result) : result;
         }
@@ -520,6 +709,228 @@ TASK_IMPL_3(BDD, sylvan_restrict, BDD, f, BDD, c, BDDVAR, prev_level)
     return mark ? sylvan_not(result) : result;
 }
 
+/**
+ * Heavy-branch subsetting: keep the paths of <f> that take the light branch at most <k> times.
+ * The weights of the branches are compared with sylvan_satcount_log2 on <vars>, the variables
+ * of the support of the original BDD below the current level. Since the comparison does not
+ * depend on <vars>, the cache key is just <f> and <k>.
+ */
+TASK_4(BDD, sylvan_subset_heavy_go, BDD, f, BDDSET, vars, uint64_t, k, BDDVAR, prev_level)
+{
+    /* Terminal cases */
+    if (f == sylvan_true || f == sylvan_false) return f;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_SUBSET_HEAVY);
+
+    bddnode_t n = MTBDD_GETNODE(f);
+    BDDVAR level = bddnode_getvariable(n);
+
+    /* Consult cache */
+    BDD result;
+    int cachenow = bdd_cachenow(CACHE_BDD_SUBSET_HEAVY, prev_level, level);
+    if (cachenow) {
+        if (cache_get3_level(CACHE_BDD_SUBSET_HEAVY, level, f, k, 0, &result)) {
+            sylvan_stats_count(BDD_SUBSET_HEAVY_CACHED);
+            return result;
+        }
+    }
+
+    /* Skip the variables of this level and above */
+    while (!sylvan_set_isempty(vars) && sylvan_var(vars) <= level) vars = sylvan_set_next(vars);
+
+    BDD low = node_low(f, n);
+    BDD high = node_high(f, n);
+    SPAWN(sylvan_satcount_log2, high, vars, level);
+    double weight_low = CALL(sylvan_satcount_log2, low, vars, level);
+    double weight_high = SYNC(sylvan_satcount_log2);
+    const int high_is_heavy = weight_high >= weight_low;
+    BDD heavy = high_is_heavy ? high : low;
+    BDD light = high_is_heavy ? low : high;
+
+    if (k == 0) {
+        heavy = CALL(sylvan_subset_heavy_go, heavy, vars, 0, level);
+        light = sylvan_false;
+    } else {
+        bdd_refs_spawn(SPAWN(sylvan_subset_heavy_go, light, vars, k-1, level));
+        heavy = CALL(sylvan_subset_heavy_go, heavy, vars, k, level);
+        bdd_refs_push(heavy);
+        light = bdd_refs_sync(SYNC(sylvan_subset_heavy_go));
+        bdd_refs_pop(1);
+    }
+    result = high_is_heavy ? sylvan_makenode(level, light, heavy) : sylvan_makenode(level, heavy, light);
+
+    if (cachenow) {
+        if (cache_put3(CACHE_BDD_SUBSET_HEAVY, f, k, 0, result)) sylvan_stats_count(BDD_SUBSET_HEAVY_CACHEDPUT);
+    }
+
+    return result;
+}
+
+/**
+ * Short-path subsetting: keep the paths of <f> with at most <k> nodes.
+ */
+TASK_3(BDD, sylvan_subset_short_go, BDD, f, uint64_t, k, BDDVAR, prev_level)
+{
+    /* Terminal cases */
+    if (f == sylvan_true || f == sylvan_false) return f;
+    if (k == 0) return sylvan_false;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_SUBSET_SHORT);
+
+    bddnode_t n = MTBDD_GETNODE(f);
+    BDDVAR level = bddnode_getvariable(n);
+
+    /* Consult cache */
+    BDD result;
+    int cachenow = bdd_cachenow(CACHE_BDD_SUBSET_SHORT, prev_level, level);
+    if (cachenow) {
+        if (cache_get3_level(CACHE_BDD_SUBSET_SHORT, level, f, k, 0, &result)) {
+            sylvan_stats_count(BDD_SUBSET_SHORT_CACHED);
+            return result;
+        }
+    }
+
+    bdd_refs_spawn(SPAWN(sylvan_subset_short_go, node_low(f, n), k-1, level));
+    BDD high = CALL(sylvan_subset_short_go, node_high(f, n), k-1, level);
+    bdd_refs_push(high);
+    BDD low = bdd_refs_sync(SYNC(sylvan_subset_short_go));
+    bdd_refs_pop(1);
+    result = sylvan_makenode(level, low, high);
+
+    if (cachenow) {
+        if (cache_put3(CACHE_BDD_SUBSET_SHORT, f, k, 0, result)) sylvan_stats_count(BDD_SUBSET_SHORT_CACHEDPUT);
+    }
+
+    return result;
+}
+
+/**
+ * Binary search for the largest k (at most the number of variables in the support of <f>)
+ * such that the subset of <f> with parameter k has at most <threshold> nodes.
+ */
+TASK_3(BDD, sylvan_subset, BDD, f, size_t, threshold, int, heavy)
+{
+    if (sylvan_nodecount(f) <= threshold) return f;
+
+    BDDSET vars = sylvan_support(f);
+    bdd_refs_push(vars);
+
+    /* with k = the number of variables, the subset is f itself, which is too large */
+    uint64_t lo = 0, hi = sylvan_set_count(vars);
+    BDD best = heavy ? CALL(sylvan_subset_heavy_go, f, vars, 0, 0) : sylvan_false;
+    bdd_refs_pushptr(&best);
+    while (hi - lo > 1) {
+        const uint64_t k = lo + (hi - lo) / 2;
+        BDD result = heavy ? CALL(sylvan_subset_heavy_go, f, vars, k, 0) : CALL(sylvan_subset_short_go, f, k, 0);
+        if (sylvan_nodecount(result) <= threshold) {
+            best = result;
+            lo = k;
+        } else {
+            hi = k;
+        }
+    }
+
+    bdd_refs_popptr(1);
+    bdd_refs_pop(1);
+    return best;
+}
+
+TASK_IMPL_2(BDD, sylvan_subset_heavy, BDD, f, size_t, threshold)
+{
+    return CALL(sylvan_subset, f, threshold, 1);
+}
+
+TASK_IMPL_2(BDD, sylvan_subset_short, BDD, f, size_t, threshold)
+{
+    return CALL(sylvan_subset, f, threshold, 0);
+}
+
+/**
+ * Count the nodes of every level (<vars> is the sorted array of the <nvars> variables of the support)
+ */
+static void
+bdd_levelcount_mark(BDD bdd, const uint32_t *vars, size_t nvars, size_t *counts)
+{
+    if (sylvan_isconst(bdd)) return;
+    bddnode_t n = MTBDD_GETNODE(bdd);
+    if (bddnode_getmark(n)) return;
+    bddnode_setmark(n, 1);
+
+    /* binary search for the index of the variable */
+    const uint32_t var = bddnode_getvariable(n);
+    size_t lo = 0, hi = nvars;
+    while (hi - lo > 1) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (vars[mid] <= var) lo = mid;
+        else hi = mid;
+    }
+    counts[lo]++;
+
+    bdd_levelcount_mark(bddnode_getlow(n), vars, nvars, counts);
+    bdd_levelcount_mark(bddnode_gethigh(n), vars, nvars, counts);
+}
+
+static void
+bdd_levelcount_unmark(BDD bdd)
+{
+    if (sylvan_isconst(bdd)) return;
+    bddnode_t n = MTBDD_GETNODE(bdd);
+    if (!bddnode_getmark(n)) return;
+    bddnode_setmark(n, 0);
+    bdd_levelcount_unmark(bddnode_getlow(n));
+    bdd_levelcount_unmark(bddnode_gethigh(n));
+}
+
+/**
+ * Abstract from the level with the most nodes (universally or existentially) until <f> fits.
+ * Every step removes one variable from the support, so this terminates.
+ */
+TASK_3(BDD, sylvan_approx_abstract, BDD, f, size_t, threshold, int, under)
+{
+    BDD result = f;
+    bdd_refs_pushptr(&result);
+
+    while (!sylvan_isconst(result) && sylvan_nodecount(result) > threshold) {
+        BDDSET support = sylvan_support(result);
+        const size_t nvars = sylvan_set_count(support);
+        uint32_t vars[nvars];
+        size_t counts[nvars];
+        sylvan_set_toarray(support, vars);
+        for (size_t i=0; i<nvars; i++) counts[i] = 0;
+        bdd_levelcount_mark(result, vars, nvars, counts);
+        bdd_levelcount_unmark(result);
+
+        size_t widest = 0;
+        for (size_t i=1; i<nvars; i++) if (counts[i] > counts[widest]) widest = i;
+
+        BDDSET cube = sylvan_set_fromarray(&vars[widest], 1);
+        bdd_refs_push(cube);
+        result = under ? sylvan_forall(result, cube) : sylvan_exists(result, cube);
+        bdd_refs_pop(1);
+    }
+
+    bdd_refs_popptr(1);
+    return result;
+}
+
+TASK_IMPL_2(BDD, sylvan_underapprox, BDD, f, size_t, threshold)
+{
+    return CALL(sylvan_approx_abstract, f, threshold, 1);
+}
+
+TASK_IMPL_2(BDD, sylvan_overapprox, BDD, f, size_t, threshold)
+{
+    return CALL(sylvan_approx_abstract, f, threshold, 0);
+}
+
 /**
  * Calculates \exists variables . a
  */
@@ -548,10 +959,10 @@ TASK_IMPL_3(BDD, sylvan_exists, BDD, a, BDD, variables, BDDVAR, prev_level)
     /* Count operation */
     sylvan_stats_count(BDD_EXISTS);
 
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_EXISTS, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_EXISTS, a, variables, 0, &result)) {
+        if (cache_get3_level(CACHE_BDD_EXISTS, level, a, variables, 0, &result)) {
             sylvan_stats_count(BDD_EXISTS_CACHED);
             return result;
         }
@@ -748,9 +1159,9 @@ TASK_IMPL_4(BDD, sylvan_and_exists, BDD, a, BDD, b, BDDSET, v, BDDVAR, prev_leve
 
     BDD result;
 
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_AND_EXISTS, prev_level, level);
     if (cachenow) {
-        if (cache_get3(CACHE_BDD_AND_EXISTS, a, b, v, &result)) {
+        if (cache_get3_level(CACHE_BDD_AND_EXISTS, level, a, b, v, &result)) {
             sylvan_stats_count(BDD_AND_EXISTS_CACHED);
             return result;
         }
@@ -982,10 +1393,10 @@ TASK_IMPL_4(BDD, sylvan_relnext, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_leve
     }
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_RELNEXT, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_RELNEXT, a, b, vars, &result)) {
+        if (cache_get3_level(CACHE_BDD_RELNEXT, level, a, b, vars, &result)) {
             sylvan_stats_count(BDD_RELNEXT_CACHED);
             return result;
         }
@@ -1130,24 +1541,23 @@ TASK_IMPL_4(BDD, sylvan_relnext, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_leve
     return result;
 }
 
-TASK_IMPL_4(BDD, sylvan_relprev, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_level)
+TASK_IMPL_5(BDD, sylvan_relnext_rw, BDD, a, BDD, b, BDDSET, read, BDDSET, write, BDDVAR, prev_level)
 {
-    /* Compute \exists x: A(s,x) \and B(x,t)
-     * if vars == sylvan_false, then every level is in s or t
-     * any other levels (outside s,t) in A are ignored / existentially quantified
+    /* Compute R(s) = \exists x: A(x) \and B(x,s) where B is only defined on the s variables in read
+     * and the t variables of the s variables in write; every s variable not in write keeps its value
+     * any other levels in B are ignored / existentially quantified
      */
 
     /* Terminals */
     if (a == sylvan_true && b == sylvan_true) return sylvan_true;
     if (a == sylvan_false) return sylvan_false;
     if (b == sylvan_false) return sylvan_false;
-    if (sylvan_set_isempty(vars)) return b;
 
     /* Perhaps execute garbage collection */
     sylvan_gc_test();
 
     /* Count operation */
-    sylvan_stats_count(BDD_RELPREV);
+    sylvan_stats_count(BDD_RELNEXT_RW);
 
     /* Determine top level */
     bddnode_t na = sylvan_isconst(a) ? 0 : MTBDD_GETNODE(a);
@@ -1156,45 +1566,35 @@ TASK_IMPL_4(BDD, sylvan_relprev, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_leve
     BDDVAR va = na ? bddnode_getvariable(na) : 0xffffffff;
     BDDVAR vb = nb ? bddnode_getvariable(nb) : 0xffffffff;
     BDDVAR level = va < vb ? va : vb;
+    BDDVAR s = level & (~1);
 
-    /* Skip vars */
-    int is_s_or_t = 0;
-    bddnode_t nv = 0;
-    if (vars == sylvan_false) {
-        is_s_or_t = 1;
-    } else {
-        nv = MTBDD_GETNODE(vars);
-        for (;;) {
-            /* check if level is s/t */
-            BDDVAR vv = bddnode_getvariable(nv);
-            if (level == vv || (level^1) == vv) {
-                is_s_or_t = 1;
-                break;
-            }
-            /* check if level < s/t */
-            if (level < vv) break;
-            vars = node_high(vars, nv); // get next in vars
-            if (sylvan_set_isempty(vars)) return b;
-            nv = MTBDD_GETNODE(vars);
-        }
-    }
+    /* Skip read and write variables above the top level */
+    while (!sylvan_set_isempty(read) && sylvan_var(read) < s) read = sylvan_set_next(read);
+    while (!sylvan_set_isempty(write) && sylvan_var(write) < s) write = sylvan_set_next(write);
+    if (sylvan_set_isempty(read) && sylvan_set_isempty(write)) return a;
+
+    const int is_read = !sylvan_set_isempty(read) && sylvan_var(read) == s;
+    const int is_write = !sylvan_set_isempty(write) && sylvan_var(write) == s;
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_RELNEXT_RW, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_RELPREV, a, b, vars, &result)) {
-            sylvan_stats_count(BDD_RELPREV_CACHED);
+        int hit = cache_get4(CACHE_BDD_RELNEXT_RW, a, b, read, write, &result);
+        if (unlikely(cache_adaptive)) cache_granularity_count(CACHE_BDD_RELNEXT_RW, level, hit);
+        if (hit) {
+            sylvan_stats_count(BDD_RELNEXT_RW_CACHED);
             return result;
         }
     }
 
     BDD result;
 
-    if (is_s_or_t) {
-        /* Get s and t */
-        BDDVAR s = level & (~1);
+    if (is_write) {
+        /* Same as relnext for s and t: the new value of s is the value of t in b */
         BDDVAR t = s+1;
+        BDD _read = is_read ? sylvan_set_next(read) : read;
+        BDD _write = sylvan_set_next(write);
 
         BDD a0, a1, b0, b1;
         if (na && va == s) {
@@ -1210,60 +1610,261 @@ TASK_IMPL_4(BDD, sylvan_relprev, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_leve
             b0 = b1 = b;
         }
 
-        BDD a00, a01, a10, a11;
-        if (!sylvan_isconst(a0)) {
-            bddnode_t na0 = MTBDD_GETNODE(a0);
-            if (bddnode_getvariable(na0) == t) {
-                a00 = node_low(a0, na0);
-                a01 = node_high(a0, na0);
-            } else {
-                a00 = a01 = a0;
-            }
+        BDD b00, b01, b10, b11;
+        if (!sylvan_isconst(b0) && sylvan_var(b0) == t) {
+            b00 = node_low(b0, MTBDD_GETNODE(b0));
+            b01 = node_high(b0, MTBDD_GETNODE(b0));
         } else {
-            a00 = a01 = a0;
+            b00 = b01 = b0;
         }
-        if (!sylvan_isconst(a1)) {
-            bddnode_t na1 = MTBDD_GETNODE(a1);
-            if (bddnode_getvariable(na1) == t) {
-                a10 = node_low(a1, na1);
-                a11 = node_high(a1, na1);
-            } else {
-                a10 = a11 = a1;
-            }
+        if (!sylvan_isconst(b1) && sylvan_var(b1) == t) {
+            b10 = node_low(b1, MTBDD_GETNODE(b1));
+            b11 = node_high(b1, MTBDD_GETNODE(b1));
         } else {
-            a10 = a11 = a1;
+            b10 = b11 = b1;
         }
 
-        BDD b00, b01, b10, b11;
-        if (!sylvan_isconst(b0)) {
-            bddnode_t nb0 = MTBDD_GETNODE(b0);
-            if (bddnode_getvariable(nb0) == t) {
-                b00 = node_low(b0, nb0);
-                b01 = node_high(b0, nb0);
-            } else {
-                b00 = b01 = b0;
-            }
+        bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b00, _read, _write, level));
+        bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a1, b10, _read, _write, level));
+        bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b01, _read, _write, level));
+        bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a1, b11, _read, _write, level));
+
+        BDD f = bdd_refs_sync(SYNC(sylvan_relnext_rw)); bdd_refs_push(f);
+        BDD e = bdd_refs_sync(SYNC(sylvan_relnext_rw)); bdd_refs_push(e);
+        BDD d = bdd_refs_sync(SYNC(sylvan_relnext_rw)); bdd_refs_push(d);
+        BDD c = bdd_refs_sync(SYNC(sylvan_relnext_rw)); bdd_refs_push(c);
+
+        bdd_refs_spawn(SPAWN(sylvan_ite, c, sylvan_true, d, 0)); /* a0 b00  \or  a1 b10 */
+        bdd_refs_spawn(SPAWN(sylvan_ite, e, sylvan_true, f, 0)); /* a0 b01  \or  a1 b11 */
+
+        /* R1 */ d = bdd_refs_sync(SYNC(sylvan_ite)); bdd_refs_push(d);
+        /* R0 */ c = bdd_refs_sync(SYNC(sylvan_ite));
+
+        bdd_refs_pop(5);
+        result = sylvan_makenode(s, c, d);
+    } else if (is_read) {
+        /* Read but not written: keep the value of s, restrict b (the t variable is implicitly s) */
+        BDD _read = sylvan_set_next(read);
+
+        BDD a0, a1, b0, b1;
+        if (na && va == s) {
+            a0 = node_low(a, na);
+            a1 = node_high(a, na);
         } else {
-            b00 = b01 = b0;
+            a0 = a1 = a;
         }
-        if (!sylvan_isconst(b1)) {
-            bddnode_t nb1 = MTBDD_GETNODE(b1);
-            if (bddnode_getvariable(nb1) == t) {
-                b10 = node_low(b1, nb1);
-                b11 = node_high(b1, nb1);
-            } else {
-                b10 = b11 = b1;
-            }
+        if (nb && vb == s) {
+            b0 = node_low(b, nb);
+            b1 = node_high(b, nb);
         } else {
-            b10 = b11 = b1;
+            b0 = b1 = b;
         }
 
-        BDD _vars;
-        if (vars != sylvan_false) {
-            _vars = node_high(vars, nv);
-            if (sylvan_set_first(_vars) == t) _vars = sylvan_set_next(_vars);
+        if (a0 == a1 && b0 == b1) {
+            result = CALL(sylvan_relnext_rw, a0, b0, _read, write, level);
         } else {
-            _vars = sylvan_false;
+            bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b0, _read, write, level));
+            BDD r1 = bdd_refs_push(CALL(sylvan_relnext_rw, a1, b1, _read, write, level));
+            BDD r0 = bdd_refs_sync(SYNC(sylvan_relnext_rw));
+            bdd_refs_pop(1);
+            result = sylvan_makenode(s, r0, r1);
+        }
+    } else {
+        /* Variable not read or written! Take a, quantify b */
+        BDD a0, a1, b0, b1;
+        if (na && va == level) {
+            a0 = node_low(a, na);
+            a1 = node_high(a, na);
+        } else {
+            a0 = a1 = a;
+        }
+        if (nb && vb == level) {
+            b0 = node_low(b, nb);
+            b1 = node_high(b, nb);
+        } else {
+            b0 = b1 = b;
+        }
+
+        if (b0 != b1) {
+            if (a0 == a1) {
+                /* Quantify "b" variables */
+                bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b0, read, write, level));
+                BDD r1 = bdd_refs_push(CALL(sylvan_relnext_rw, a1, b1, read, write, level));
+                BDD r0 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext_rw)));
+                result = sylvan_or(r0, r1);
+                bdd_refs_pop(2);
+            } else {
+                /* Quantify "b" variables, but keep "a" variables */
+                bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b0, read, write, level));
+                bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b1, read, write, level));
+                bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a1, b0, read, write, level));
+                bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a1, b1, read, write, level));
+
+                BDD r11 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext_rw)));
+                BDD r10 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext_rw)));
+                BDD r01 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext_rw)));
+                BDD r00 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext_rw)));
+
+                bdd_refs_spawn(SPAWN(sylvan_ite, r00, sylvan_true, r01, 0));
+                bdd_refs_spawn(SPAWN(sylvan_ite, r10, sylvan_true, r11, 0));
+
+                BDD r1 = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_ite)));
+                BDD r0 = bdd_refs_sync(SYNC(sylvan_ite));
+                bdd_refs_pop(5);
+
+                result = sylvan_makenode(level, r0, r1);
+            }
+        } else {
+            /* Keep "a" variables */
+            bdd_refs_spawn(SPAWN(sylvan_relnext_rw, a0, b0, read, write, level));
+            BDD r1 = bdd_refs_push(CALL(sylvan_relnext_rw, a1, b1, read, write, level));
+            BDD r0 = bdd_refs_sync(SYNC(sylvan_relnext_rw));
+            bdd_refs_pop(1);
+            result = sylvan_makenode(level, r0, r1);
+        }
+    }
+
+    if (cachenow) {
+        if (cache_put4(CACHE_BDD_RELNEXT_RW, a, b, read, write, result)) sylvan_stats_count(BDD_RELNEXT_RW_CACHEDPUT);
+    }
+
+    return result;
+}
+
+TASK_IMPL_4(BDD, sylvan_relprev, BDD, a, BDD, b, BDDSET, vars, BDDVAR, prev_level)
+{
+    /* Compute \exists x: A(s,x) \and B(x,t)
+     * if vars == sylvan_false, then every level is in s or t
+     * any other levels (outside s,t) in A are ignored / existentially quantified
+     */
+
+    /* Terminals */
+    if (a == sylvan_true && b == sylvan_true) return sylvan_true;
+    if (a == sylvan_false) return sylvan_false;
+    if (b == sylvan_false) return sylvan_false;
+    if (sylvan_set_isempty(vars)) return b;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_RELPREV);
+
+    /* Determine top level */
+    bddnode_t na = sylvan_isconst(a) ? 0 : MTBDD_GETNODE(a);
+    bddnode_t nb = sylvan_isconst(b) ? 0 : MTBDD_GETNODE(b);
+
+    BDDVAR va = na ? bddnode_getvariable(na) : 0xffffffff;
+    BDDVAR vb = nb ? bddnode_getvariable(nb) : 0xffffffff;
+    BDDVAR level = va < vb ? va : vb;
+
+    /* Skip vars */
+    int is_s_or_t = 0;
+    bddnode_t nv = 0;
+    if (vars == sylvan_false) {
+        is_s_or_t = 1;
+    } else {
+        nv = MTBDD_GETNODE(vars);
+        for (;;) {
+            /* check if level is s/t */
+            BDDVAR vv = bddnode_getvariable(nv);
+            if (level == vv || (level^1) == vv) {
+                is_s_or_t = 1;
+                break;
+            }
+            /* check if level < s/t */
+            if (level < vv) break;
+            vars = node_high(vars, nv); // get next in vars
+            if (sylvan_set_isempty(vars)) return b;
+            nv = MTBDD_GETNODE(vars);
+        }
+    }
+
+    /* Consult cache */
+    int cachenow = bdd_cachenow(CACHE_BDD_RELPREV, prev_level, level);
+    if (cachenow) {
+        BDD result;
+        if (cache_get3_level(CACHE_BDD_RELPREV, level, a, b, vars, &result)) {
+            sylvan_stats_count(BDD_RELPREV_CACHED);
+            return result;
+        }
+    }
+
+    BDD result;
+
+    if (is_s_or_t) {
+        /* Get s and t */
+        BDDVAR s = level & (~1);
+        BDDVAR t = s+1;
+
+        BDD a0, a1, b0, b1;
+        if (na && va == s) {
+            a0 = node_low(a, na);
+            a1 = node_high(a, na);
+        } else {
+            a0 = a1 = a;
+        }
+        if (nb && vb == s) {
+            b0 = node_low(b, nb);
+            b1 = node_high(b, nb);
+        } else {
+            b0 = b1 = b;
+        }
+
+        BDD a00, a01, a10, a11;
+        if (!sylvan_isconst(a0)) {
+            bddnode_t na0 = MTBDD_GETNODE(a0);
+            if (bddnode_getvariable(na0) == t) {
+                a00 = node_low(a0, na0);
+                a01 = node_high(a0, na0);
+            } else {
+                a00 = a01 = a0;
+            }
+        } else {
+            a00 = a01 = a0;
+        }
+        if (!sylvan_isconst(a1)) {
+            bddnode_t na1 = MTBDD_GETNODE(a1);
+            if (bddnode_getvariable(na1) == t) {
+                a10 = node_low(a1, na1);
+                a11 = node_high(a1, na1);
+            } else {
+                a10 = a11 = a1;
+            }
+        } else {
+            a10 = a11 = a1;
+        }
+
+        BDD b00, b01, b10, b11;
+        if (!sylvan_isconst(b0)) {
+            bddnode_t nb0 = MTBDD_GETNODE(b0);
+            if (bddnode_getvariable(nb0) == t) {
+                b00 = node_low(b0, nb0);
+                b01 = node_high(b0, nb0);
+            } else {
+                b00 = b01 = b0;
+            }
+        } else {
+            b00 = b01 = b0;
+        }
+        if (!sylvan_isconst(b1)) {
+            bddnode_t nb1 = MTBDD_GETNODE(b1);
+            if (bddnode_getvariable(nb1) == t) {
+                b10 = node_low(b1, nb1);
+                b11 = node_high(b1, nb1);
+            } else {
+                b10 = b11 = b1;
+            }
+        } else {
+            b10 = b11 = b1;
+        }
+
+        BDD _vars;
+        if (vars != sylvan_false) {
+            _vars = node_high(vars, nv);
+            if (sylvan_set_first(_vars) == t) _vars = sylvan_set_next(_vars);
+        } else {
+            _vars = sylvan_false;
         }
 
         if (b00 == b01) {
@@ -1423,10 +2024,10 @@ TASK_IMPL_2(BDD, sylvan_closure, BDD, a, BDDVAR, prev_level)
     BDDVAR level = bddnode_getvariable(n);
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_CLOSURE, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_CLOSURE, a, 0, 0, &result)) {
+        if (cache_get3_level(CACHE_BDD_CLOSURE, level, a, 0, 0, &result)) {
             sylvan_stats_count(BDD_CLOSURE_CACHED);
             return result;
         }
@@ -1508,6 +2109,352 @@ TASK_IMPL_2(BDD, sylvan_closure, BDD, a, BDDVAR, prev_level)
 }
 
 
+/**
+ * A list of transition relations, sorted by their top variable, then on the relation itself.
+ * Relations with the same top variable form one group. Used by saturation and relnext_multi.
+ */
+typedef struct bdd_relations {
+    BDD *relations;
+    BDDSET *variables;
+    uint32_t *topvars;       // top (s) variable of each relation
+    int count;
+    uint64_t id;             // identifier of the relations (from cache_key_id)
+} bdd_relations_t;
+
+static void
+bdd_relations_init(bdd_relations_t *rels, const BDD *relations, const BDDSET *variables, int count)
+{
+    /* Sort the relations on their top variable, then on the relation itself (insertion sort) */
+    int *order = (int*)malloc(sizeof(int[count]));
+    uint32_t *vars = (uint32_t*)malloc(sizeof(uint32_t[count]));
+    for (int i=0; i<count; i++) {
+        uint32_t v;
+        if (variables[i] == sylvan_false) v = 0; // all variables
+        else if (sylvan_set_isempty(variables[i])) v = 0xffffffff;
+        else v = sylvan_var(variables[i]) & (~1);
+        int j = i;
+        while (j > 0 && (vars[j-1] > v || (vars[j-1] == v && (relations[order[j-1]] > relations[i] ||
+                (relations[order[j-1]] == relations[i] && variables[order[j-1]] > variables[i]))))) {
+            vars[j] = vars[j-1];
+            order[j] = order[j-1];
+            j--;
+        }
+        vars[j] = v;
+        order[j] = i;
+    }
+
+    rels->relations = (BDD*)malloc(sizeof(BDD[count]));
+    rels->variables = (BDDSET*)malloc(sizeof(BDDSET[count]));
+    uint64_t *key = (uint64_t*)malloc(sizeof(uint64_t[2*count]));
+    for (int i=0; i<count; i++) {
+        rels->relations[i] = key[2*i] = relations[order[i]];
+        rels->variables[i] = key[2*i+1] = variables[order[i]];
+    }
+
+    rels->topvars = vars;
+    rels->count = count;
+    rels->id = cache_key_id(key, 2*count);
+
+    free(key);
+    free(order);
+}
+
+static void
+bdd_relations_free(bdd_relations_t *rels)
+{
+    free(rels->relations);
+    free(rels->variables);
+    free(rels->topvars);
+}
+
+/**
+ * Saturation. Every group is applied until a fixpoint, after saturating with the next groups.
+ */
+TASK_3(BDD, sylvan_saturate_go, BDD, set, int, idx, const bdd_relations_t*, ctx)
+{
+    /* Terminal cases */
+    if (set == sylvan_false) return sylvan_false;
+    if (idx == ctx->count) return set;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_SATURATE);
+
+    /* Consult cache */
+    BDD result;
+    const BDD _set = set;
+    const uint64_t key = (ctx->id << 32) | (uint64_t)idx;
+    if (cache_get3(CACHE_BDD_SATURATE, _set, key, 0, &result)) {
+        sylvan_stats_count(BDD_SATURATE_CACHED);
+        return result;
+    }
+    bdd_refs_pushptr(&_set);
+
+    const uint32_t var = ctx->topvars[idx];
+    if (set == sylvan_true || var <= sylvan_var(set)) {
+        /* Count the number of relations in this group */
+        int count = idx+1;
+        while (count < ctx->count && ctx->topvars[count] == var) count++;
+        count -= idx;
+
+        /*
+         * Compute the fixpoint of:
+         * - saturate with the next groups
+         * - apply every relation of this group once
+         */
+        BDD prev = sylvan_false;
+        BDD step = sylvan_false;
+        bdd_refs_pushptr(&set);
+        bdd_refs_pushptr(&prev);
+        bdd_refs_pushptr(&step);
+        while (prev != set) {
+            prev = set;
+            set = CALL(sylvan_saturate_go, set, idx+count, ctx);
+            for (int i=0; i<count; i++) {
+                step = sylvan_relnext(set, ctx->relations[idx+i], ctx->variables[idx+i]);
+                set = sylvan_or(set, step);
+                step = sylvan_false;
+            }
+        }
+        bdd_refs_popptr(3);
+        result = set;
+    } else {
+        /* Saturate both subtrees in parallel */
+        bddnode_t n = MTBDD_GETNODE(set);
+        bdd_refs_spawn(SPAWN(sylvan_saturate_go, node_low(set, n), idx, ctx));
+        BDD high = bdd_refs_push(CALL(sylvan_saturate_go, node_high(set, n), idx, ctx));
+        BDD low = bdd_refs_sync(SYNC(sylvan_saturate_go));
+        bdd_refs_pop(1);
+        result = sylvan_makenode(bddnode_getvariable(n), low, high);
+    }
+
+    if (cache_put3(CACHE_BDD_SATURATE, _set, key, 0, result)) sylvan_stats_count(BDD_SATURATE_CACHEDPUT);
+    bdd_refs_popptr(1);
+    return result;
+}
+
+TASK_IMPL_4(BDD, sylvan_saturate, BDD, set, const BDD*, relations, const BDDSET*, variables, int, count)
+{
+    if (count <= 0 || set == sylvan_false) return set;
+
+    bdd_relations_t rels;
+    bdd_relations_init(&rels, relations, variables, count);
+    BDD result = CALL(sylvan_saturate_go, set, 0, &rels);
+    bdd_relations_free(&rels);
+    return result;
+}
+
+/**
+ * Relnext with many relations. The set is traversed once for all relations, until the top
+ * variable of a group is reached. There, sylvan_relnext is applied for every relation of the
+ * group, and the results are combined with the successors of the next groups.
+ */
+TASK_3(BDD, sylvan_relnext_multi_go, BDD, set, int, idx, const bdd_relations_t*, ctx)
+{
+    /* Terminal cases */
+    if (set == sylvan_false) return sylvan_false;
+    if (idx == ctx->count) return sylvan_false;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_RELNEXT_MULTI);
+
+    /* Consult cache */
+    BDD result;
+    const uint64_t key = (ctx->id << 32) | (uint64_t)idx;
+    if (cache_get3(CACHE_BDD_RELNEXT_MULTI, set, key, 0, &result)) {
+        sylvan_stats_count(BDD_RELNEXT_MULTI_CACHED);
+        return result;
+    }
+
+    const uint32_t var = ctx->topvars[idx];
+    if (set == sylvan_true || var <= sylvan_var(set)) {
+        /* Count the number of relations in this group */
+        int count = idx+1;
+        while (count < ctx->count && ctx->topvars[count] == var) count++;
+        count -= idx;
+
+        /* Apply the relations of this group in parallel with the next groups */
+        for (int i=0; i<count; i++) {
+            bdd_refs_spawn(SPAWN(sylvan_relnext, set, ctx->relations[idx+i], ctx->variables[idx+i], 0));
+        }
+        result = CALL(sylvan_relnext_multi_go, set, idx+count, ctx);
+        bdd_refs_pushptr(&result);
+        for (int i=0; i<count; i++) {
+            BDD succ = bdd_refs_push(bdd_refs_sync(SYNC(sylvan_relnext)));
+            result = sylvan_or(result, succ);
+            bdd_refs_pop(1);
+        }
+        bdd_refs_popptr(1);
+    } else {
+        /* Compute the successors of both subtrees in parallel */
+        bddnode_t n = MTBDD_GETNODE(set);
+        bdd_refs_spawn(SPAWN(sylvan_relnext_multi_go, node_low(set, n), idx, ctx));
+        BDD high = bdd_refs_push(CALL(sylvan_relnext_multi_go, node_high(set, n), idx, ctx));
+        BDD low = bdd_refs_sync(SYNC(sylvan_relnext_multi_go));
+        bdd_refs_pop(1);
+        result = sylvan_makenode(bddnode_getvariable(n), low, high);
+    }
+
+    if (cache_put3(CACHE_BDD_RELNEXT_MULTI, set, key, 0, result)) sylvan_stats_count(BDD_RELNEXT_MULTI_CACHEDPUT);
+    return result;
+}
+
+TASK_IMPL_4(BDD, sylvan_relnext_multi, BDD, set, const BDD*, relations, const BDDSET*, variables, int, count)
+{
+    if (count <= 0 || set == sylvan_false) return sylvan_false;
+
+    bdd_relations_t rels;
+    bdd_relations_init(&rels, relations, variables, count);
+    BDD result = CALL(sylvan_relnext_multi_go, set, 0, &rels);
+    bdd_relations_free(&rels);
+    return result;
+}
+
+/**
+ * Count the variables that are in both <a> and <b>
+ */
+static size_t
+bdd_set_overlap(BDDSET a, BDDSET b)
+{
+    size_t count = 0;
+    while (!sylvan_set_isempty(a) && !sylvan_set_isempty(b)) {
+        const uint32_t va = sylvan_set_first(a);
+        const uint32_t vb = sylvan_set_first(b);
+        if (va <= vb) a = sylvan_set_next(a);
+        if (vb <= va) b = sylvan_set_next(b);
+        if (va == vb) count++;
+    }
+    return count;
+}
+
+/**
+ * Extend the relation on <variables> to the variables <target>, by adding the copy constraint
+ * s=t (t=s+1) for every pair of <target> of which neither s nor t is in <variables>.
+ * As in sylvan_relnext, a pair is a pair of the relation if s or t is in its variables.
+ */
+TASK_3(BDD, sylvan_cluster_extend, BDD, relation, BDDSET, variables, BDDSET, target)
+{
+    const size_t tcount = sylvan_set_count(target);
+    const size_t vcount = sylvan_set_count(variables);
+    uint32_t tvars[tcount+1], vvars[vcount+1], pairs[tcount+1];
+    sylvan_set_toarray(target, tvars);
+    sylvan_set_toarray(variables, vvars);
+
+    /* collect the s variables of the missing pairs (both arrays are sorted) */
+    size_t count = 0;
+    for (size_t i=0, j=0; i<tcount; i++) {
+        const uint32_t s = tvars[i] & (~1);
+        if (count > 0 && pairs[count-1] == s) continue;
+        while (j < vcount && (vvars[j] & (~1)) < s) j++;
+        if (j < vcount && (vvars[j] & (~1)) == s) continue;
+        pairs[count++] = s;
+    }
+    if (count == 0) return relation;
+
+    /* create "s=t" from the bottom up */
+    BDD eq = sylvan_true;
+    bdd_refs_pushptr(&eq);
+    for (size_t i=count; i>0; i--) {
+        const uint32_t v = pairs[i-1];
+        BDD low = sylvan_makenode(v+1, eq, sylvan_false);
+        bdd_refs_push(low);
+        BDD high = sylvan_makenode(v+1, sylvan_false, eq);
+        bdd_refs_pop(1);
+        eq = sylvan_makenode(v, low, high);
+    }
+    BDD result = sylvan_and(relation, eq);
+    bdd_refs_popptr(1);
+    return result;
+}
+
+/**
+ * Greedy clustering. Every relation is merged into the cluster that shares the most variables
+ * with it, skipping clusters that already have at least <threshold> nodes, and clusters for which
+ * the merged relation would have more than <threshold> nodes. If no cluster with overlapping
+ * variables remains, the relation starts a new cluster.
+ */
+TASK_IMPL_6(int, sylvan_cluster_relations, const BDD*, relations, const BDDSET*, variables, int, count, size_t, threshold, BDD*, out_relations, BDDSET*, out_variables)
+{
+    if (count <= 0) return 0;
+
+    BDD *rels = (BDD*)malloc(sizeof(BDD[count]));
+    BDDSET *vars = (BDDSET*)malloc(sizeof(BDDSET[count]));
+    size_t *sizes = (size_t*)malloc(sizeof(size_t[count]));
+    char *tried = (char*)malloc(count);
+    for (int i=0; i<count; i++) {
+        rels[i] = sylvan_false;
+        vars[i] = sylvan_true;
+        bdd_refs_pushptr(&rels[i]);
+        bdd_refs_pushptr(&vars[i]);
+    }
+
+    int n = 0;
+    for (int i=0; i<count; i++) {
+        const BDD rel = relations[i];
+        const BDDSET rel_vars = variables[i];
+
+        /* Relations on all variables (vars == false) are not merged */
+        int merged_into = -1;
+        for (int c=0; c<n; c++) tried[c] = rel_vars == sylvan_false || vars[c] == sylvan_false || sizes[c] >= threshold;
+
+        while (merged_into == -1) {
+            /* Find the remaining cluster with the largest overlap */
+            int best = -1;
+            size_t best_overlap = 0;
+            for (int c=0; c<n; c++) {
+                if (tried[c]) continue;
+                const size_t overlap = bdd_set_overlap(vars[c], rel_vars);
+                if (overlap > best_overlap) {
+                    best = c;
+                    best_overlap = overlap;
+                }
+            }
+            if (best == -1) break;
+            tried[best] = 1;
+
+            BDDSET merged_vars = sylvan_set_addall(vars[best], rel_vars);
+            bdd_refs_push(merged_vars);
+            BDD a = CALL(sylvan_cluster_extend, rels[best], vars[best], merged_vars);
+            bdd_refs_push(a);
+            BDD b = CALL(sylvan_cluster_extend, rel, rel_vars, merged_vars);
+            bdd_refs_push(b);
+            BDD merged = sylvan_or(a, b);
+            bdd_refs_pop(2);
+            const size_t size = sylvan_nodecount(merged);
+            if (size <= threshold) {
+                rels[best] = merged;
+                vars[best] = merged_vars;
+                sizes[best] = size;
+                merged_into = best;
+            }
+            bdd_refs_pop(1);
+        }
+        if (merged_into != -1) continue;
+
+        rels[n] = rel;
+        vars[n] = rel_vars;
+        sizes[n] = sylvan_nodecount(rel);
+        n++;
+    }
+
+    for (int i=0; i<n; i++) {
+        out_relations[i] = rels[i];
+        out_variables[i] = vars[i];
+    }
+
+    bdd_refs_popptr(2*count);
+    free(rels);
+    free(vars);
+    free(sizes);
+    free(tried);
+    return n;
+}
+
 /**
  * Function composition
  */
@@ -1538,10 +2485,10 @@ TASK_IMPL_3(BDD, sylvan_compose, BDD, a, BDDMAP, map, BDDVAR, prev_level)
     }
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_COMPOSE, prev_level, level);
     if (cachenow) {
         BDD result;
-        if (cache_get3(CACHE_BDD_COMPOSE, a, map, 0, &result)) {
+        if (cache_get3_level(CACHE_BDD_COMPOSE, level, a, map, 0, &result)) {
             sylvan_stats_count(BDD_COMPOSE_CACHED);
             return result;
         }
@@ -1585,10 +2532,10 @@ TASK_IMPL_2(double, sylvan_pathcount, BDD, bdd, BDDVAR, prev_level)
     BDD level = sylvan_var(bdd);
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != level / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_PATHCOUNT, prev_level, level);
     if (cachenow) {
         double result;
-        if (cache_get3(CACHE_BDD_PATHCOUNT, bdd, 0, 0, (uint64_t*)&result)) {
+        if (cache_get3_level(CACHE_BDD_PATHCOUNT, level, bdd, 0, 0, (uint64_t*)&result)) {
             sylvan_stats_count(BDD_PATHCOUNT_CACHED);
             return result;
         }
@@ -1641,9 +2588,9 @@ TASK_IMPL_3(double, sylvan_satcount, BDD, bdd, BDDSET, variables, BDDVAR, prev_l
     } hack;
 
     /* Consult cache */
-    int cachenow = granularity < 2 || prev_level == 0 ? 1 : prev_level / granularity != var / granularity;
+    int cachenow = bdd_cachenow(CACHE_BDD_SATCOUNT, prev_level, var);
     if (cachenow) {
-        if (cache_get3(CACHE_BDD_SATCOUNT, bdd, variables, 0, &hack.s)) {
+        if (cache_get3_level(CACHE_BDD_SATCOUNT, var, bdd, variables, 0, &hack.s)) {
             sylvan_stats_count(BDD_SATCOUNT_CACHED);
             return hack.d * powl(2.0L, skipped);
         }
@@ -1661,6 +2608,71 @@ TASK_IMPL_3(double, sylvan_satcount, BDD, bdd, BDDSET, variables, BDDVAR, prev_l
     return result * powl(2.0L, skipped);
 }
 
+/**
+ * Calculate log2 of the number of satisfying variable assignments according to <variables>.
+ * Adds two counts in the log2 domain: log2(2^a + 2^b) = max + log2(1 + 2^(min-max))
+ */
+static inline double
+log2_add(double a, double b)
+{
+    if (a == -INFINITY) return b;
+    if (b == -INFINITY) return a;
+    if (a < b) return b + log2(1.0 + exp2(a - b));
+    else return a + log2(1.0 + exp2(b - a));
+}
+
+TASK_IMPL_3(double, sylvan_satcount_log2, BDD, bdd, BDDSET, variables, BDDVAR, prev_level)
+{
+    /* Trivial cases */
+    if (bdd == sylvan_false) return -INFINITY;
+    if (bdd == sylvan_true) return (double)sylvan_set_count(variables);
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_SATCOUNT_LOG2);
+
+    /* Count variables before var(bdd) */
+    size_t skipped = 0;
+    BDDVAR var = sylvan_var(bdd);
+    bddnode_t set_node = MTBDD_GETNODE(variables);
+    BDDVAR set_var = bddnode_getvariable(set_node);
+    while (var != set_var) {
+        skipped++;
+        variables = node_high(variables, set_node);
+        // if this assertion fails, then variables is not the support of <bdd>
+        assert(!sylvan_set_isempty(variables));
+        set_node = MTBDD_GETNODE(variables);
+        set_var = bddnode_getvariable(set_node);
+    }
+
+    union {
+        double d;
+        uint64_t s;
+    } hack;
+
+    /* Consult cache */
+    int cachenow = bdd_cachenow(CACHE_BDD_SATCOUNT_LOG2, prev_level, var);
+    if (cachenow) {
+        if (cache_get3_level(CACHE_BDD_SATCOUNT_LOG2, var, bdd, variables, 0, &hack.s)) {
+            sylvan_stats_count(BDD_SATCOUNT_LOG2_CACHED);
+            return hack.d + skipped;
+        }
+    }
+
+    SPAWN(sylvan_satcount_log2, sylvan_high(bdd), node_high(variables, set_node), var);
+    double low = CALL(sylvan_satcount_log2, sylvan_low(bdd), node_high(variables, set_node), var);
+    double result = log2_add(low, SYNC(sylvan_satcount_log2));
+
+    if (cachenow) {
+        hack.d = result;
+        if (cache_put3(CACHE_BDD_SATCOUNT_LOG2, bdd, variables, 0, hack.s)) sylvan_stats_count(BDD_SATCOUNT_LOG2_CACHEDPUT);
+    }
+
+    return result + skipped;
+}
+
 int
 sylvan_sat_one(BDD bdd, BDDSET vars, uint8_t *str)
 {
@@ -1762,6 +2774,83 @@ sylvan_sat_one_bdd(BDD bdd)
     return result;
 }
 
+/**
+ * Uniform random sampling. Every sample has its own random number generator (splitmix64),
+ * seeded with <seed> and the index of the sample, so the samples do not depend on the
+ * number of workers or on the scheduling of the tasks.
+ */
+typedef struct sylvan_sample_ctx {
+    BDDSET vars;
+    size_t n;                   // number of variables in vars
+    uint64_t seed;
+    uint8_t *out;
+} sylvan_sample_ctx_t;
+
+static inline uint64_t
+sylvan_sample_rng(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+VOID_TASK_4(sylvan_sample_do, BDD, bdd, size_t, first, size_t, count, const sylvan_sample_ctx_t*, ctx)
+{
+    if (count > 1) {
+        SPAWN(sylvan_sample_do, bdd, first, count/2, ctx);
+        CALL(sylvan_sample_do, bdd, first+count/2, count-count/2, ctx);
+        SYNC(sylvan_sample_do);
+        return;
+    }
+
+    uint64_t state = ctx->seed ^ (first * 0xD1B54A32D192ED03ULL);
+    sylvan_sample_rng(&state);
+
+    uint8_t *str = ctx->out + first * ctx->n;
+    BDDSET vars = ctx->vars;
+    while (!sylvan_set_isempty(vars)) {
+        BDDVAR var = sylvan_var(vars);
+        vars = sylvan_set_next(vars);
+        if (bdd == sylvan_true || var < sylvan_var(bdd)) {
+            /* Variable not in the BDD: both values have the same number of assignments */
+            *str++ = sylvan_sample_rng(&state) >> 63;
+        } else {
+            /* Take the low edge with probability count(low) / (count(low) + count(high)) */
+            BDD low = sylvan_low(bdd);
+            BDD high = sylvan_high(bdd);
+            double l0 = sylvan_satcount_log2(low, vars);
+            double l1 = sylvan_satcount_log2(high, vars);
+            double p0 = l0 == -INFINITY ? 0.0 : 1.0 / (1.0 + exp2(l1 - l0));
+            double r = (double)(sylvan_sample_rng(&state) >> 11) * 0x1.0p-53;
+            if (r < p0) {
+                *str++ = 0;
+                bdd = low;
+            } else {
+                *str++ = 1;
+                bdd = high;
+            }
+        }
+    }
+}
+
+TASK_IMPL_5(int, sylvan_sample, BDD, bdd, BDDSET, vars, size_t, k, uint64_t, seed, uint8_t*, out)
+{
+    if (bdd == sylvan_false) return 0;
+    if (k == 0) return 1;
+
+    /* Compute the number of assignments of all nodes (stored in the operation cache) */
+    sylvan_satcount_log2(bdd, vars);
+
+    sylvan_sample_ctx_t ctx;
+    ctx.vars = vars;
+    ctx.n = sylvan_set_count(vars);
+    ctx.seed = seed;
+    ctx.out = out;
+    CALL(sylvan_sample_do, bdd, 0, k, &ctx);
+    return 1;
+}
+
 BDD
 sylvan_cube(BDDSET vars, uint8_t *cube)
 {
@@ -1962,6 +3051,105 @@ VOID_TASK_IMPL_4(sylvan_enum_par, BDD, bdd, BDDSET, vars, enum_cb, cb, void*, co
     CALL(sylvan_enum_par_do, bdd, vars, cb, context, 0);
 }
 
+/**
+ * Batched enumeration. Every worker has its own cube (the current path) and its own buffer.
+ * The values of a path are written in the cube of the worker; a task that is stolen first copies
+ * the prefix of the path from the cube of the worker that spawned it. This is safe, since the
+ * spawning worker only writes after the prefix until the stolen task is synchronized.
+ */
+typedef struct sylvan_enum_batch_worker {
+    uint8_t *cube;              // values of the current path
+    uint8_t *buffer;            // <batch> cubes of <n> values
+    size_t count;               // number of cubes in the buffer
+    char pad[64-2*sizeof(uint8_t*)-sizeof(size_t)];
+} sylvan_enum_batch_worker_t;
+
+typedef struct sylvan_enum_batch_ctx {
+    size_t n;                   // number of variables
+    size_t batch;               // number of cubes in a buffer
+    sylvan_enum_batch_cb cb;
+    void *context;
+    sylvan_enum_batch_worker_t *workers;
+} sylvan_enum_batch_ctx_t;
+
+/**
+ * Enumerate <bdd> over <vars>, after assigning <val> to the variable at position <depth> (if val >= 0).
+ * The values of the variables before position <depth> are in <prefix>.
+ */
+VOID_TASK_6(sylvan_enum_batch_do, BDD, bdd, BDDSET, vars, size_t, depth, int, val, const uint8_t*, prefix, sylvan_enum_batch_ctx_t*, ctx)
+{
+    if (bdd == sylvan_false) return;
+
+    sylvan_enum_batch_worker_t *w = &ctx->workers[LACE_WORKER_ID];
+    uint8_t *cube = w->cube;
+    if (prefix != cube) memcpy(cube, prefix, depth); // stolen
+    if (val >= 0) cube[depth++] = (uint8_t)val;
+
+    if (bdd == sylvan_true) {
+        /* Enumerate all assignments of the remaining variables */
+        const size_t n = ctx->n;
+        memset(cube+depth, 0, n-depth);
+        for (;;) {
+            if (w->count == ctx->batch) {
+                WRAP(ctx->cb, ctx->context, w->buffer, w->count);
+                w->count = 0;
+            }
+            memcpy(w->buffer + w->count*n, cube, n);
+            w->count++;
+            /* next assignment */
+            size_t i = n;
+            while (i > depth && cube[i-1] == 1) cube[--i] = 0;
+            if (i == depth) break;
+            cube[i-1] = 1;
+        }
+        return;
+    }
+
+    /* assert var <= bdd_var */
+    BDDVAR var = sylvan_var(vars);
+    vars = sylvan_set_next(vars);
+    BDDVAR bdd_var = sylvan_var(bdd);
+    assert(var <= bdd_var);
+
+    if (var < bdd_var) {
+        SPAWN(sylvan_enum_batch_do, bdd, vars, depth, 1, cube, ctx);
+        CALL(sylvan_enum_batch_do, bdd, vars, depth, 0, cube, ctx);
+        SYNC(sylvan_enum_batch_do);
+    } else {
+        SPAWN(sylvan_enum_batch_do, sylvan_high(bdd), vars, depth, 1, cube, ctx);
+        CALL(sylvan_enum_batch_do, sylvan_low(bdd), vars, depth, 0, cube, ctx);
+        SYNC(sylvan_enum_batch_do);
+    }
+}
+
+VOID_TASK_IMPL_5(sylvan_enum_batch, BDD, bdd, BDDSET, vars, size_t, batch, sylvan_enum_batch_cb, cb, void*, context)
+{
+    const size_t n = sylvan_set_count(vars);
+    if (bdd == sylvan_false || n == 0 || batch == 0) return;
+
+    const unsigned int n_workers = lace_workers();
+    sylvan_enum_batch_ctx_t ctx;
+    ctx.n = n;
+    ctx.batch = batch;
+    ctx.cb = cb;
+    ctx.context = context;
+    ctx.workers = (sylvan_enum_batch_worker_t*)calloc(n_workers, sizeof(sylvan_enum_batch_worker_t));
+    for (unsigned int i=0; i<n_workers; i++) {
+        ctx.workers[i].cube = (uint8_t*)malloc(n);
+        ctx.workers[i].buffer = (uint8_t*)malloc(batch*n);
+    }
+
+    CALL(sylvan_enum_batch_do, bdd, vars, 0, -1, ctx.workers[LACE_WORKER_ID].cube, &ctx);
+
+    /* Hand over the remaining cubes */
+    for (unsigned int i=0; i<n_workers; i++) {
+        if (ctx.workers[i].count > 0) WRAP(cb, context, ctx.workers[i].buffer, ctx.workers[i].count);
+        free(ctx.workers[i].cube);
+        free(ctx.workers[i].buffer);
+    }
+    free(ctx.workers);
+}
+
 TASK_5(BDD, sylvan_collect_do, BDD, bdd, BDDSET, vars, sylvan_collect_cb, cb, void*, context, struct bdd_path*, path)
 {
     if (bdd == sylvan_false) {
@@ -2033,81 +3221,37 @@ TASK_IMPL_4(BDD, sylvan_collect, BDD, bdd, BDDSET, vars, sylvan_collect_cb, cb,
  * SERIALIZATION
  */
 
-struct sylvan_ser {
-    BDD bdd;
-    size_t assigned;
-};
-
-// Define a AVL tree type with prefix 'sylvan_ser' holding
-// nodes of struct sylvan_ser with the following compare() function...
-AVL(sylvan_ser, struct sylvan_ser)
-{
-    if (left->bdd > right->bdd) return 1;
-    if (left->bdd < right->bdd) return -1;
-    return 0;
-}
-
-// Define a AVL tree type with prefix 'sylvan_ser_reversed' holding
-// nodes of struct sylvan_ser with the following compare() function...
-AVL(sylvan_ser_reversed, struct sylvan_ser)
+static void
+sylvan_ser_children(uint64_t node, uint64_t *children)
 {
-    if (left->assigned > right->assigned) return 1;
-    if (left->assigned < right->assigned) return -1;
-    return 0;
+    bddnode_t n = MTBDD_GETNODE(node);
+    children[0] = BDD_STRIPMARK(bddnode_getlow(n));
+    children[1] = BDD_STRIPMARK(bddnode_gethigh(n));
 }
 
-// Initially, both sets are empty
-static avl_node_t *sylvan_ser_set = NULL;
-static avl_node_t *sylvan_ser_reversed_set = NULL;
-
-// Start counting (assigning numbers to BDDs) at 1
-static size_t sylvan_ser_counter = 1;
+// The index of serialized nodes (see sylvan_ser.h), numbered from 1
+static ser_index_t sylvan_ser_index;
 static size_t sylvan_ser_done = 0;
 
-// Given a BDD, assign unique numbers to all nodes
-static size_t
-sylvan_serialize_assign_rec(BDD bdd)
+static ser_index_t*
+sylvan_ser(void)
 {
-    if (sylvan_isnode(bdd)) {
-        bddnode_t n = MTBDD_GETNODE(bdd);
-
-        struct sylvan_ser s, *ss;
-        s.bdd = BDD_STRIPMARK(bdd);
-        ss = sylvan_ser_search(sylvan_ser_set, &s);
-        if (ss == NULL) {
-            // assign dummy value
-            s.assigned = 0;
-            ss = sylvan_ser_put(&sylvan_ser_set, &s, NULL);
-
-            // first assign recursively
-            sylvan_serialize_assign_rec(bddnode_getlow(n));
-            sylvan_serialize_assign_rec(bddnode_gethigh(n));
-
-            // assign real value
-            ss->assigned = sylvan_ser_counter++;
-
-            // put a copy in the reversed table
-            sylvan_ser_reversed_insert(&sylvan_ser_reversed_set, ss);
-        }
-
-        return ss->assigned;
-    }
-
-    return BDD_STRIPMARK(bdd);
+    if (sylvan_ser_index.table == NULL) ser_index_create(&sylvan_ser_index, 1, sylvan_ser_children);
+    return &sylvan_ser_index;
 }
 
 size_t
 sylvan_serialize_add(BDD bdd)
 {
-    return BDD_TRANSFERMARK(bdd, sylvan_serialize_assign_rec(bdd));
+    if (!sylvan_isnode(bdd)) return bdd;
+    LACE_ME;
+    return BDD_TRANSFERMARK(bdd, CALL(ser_index_add, sylvan_ser(), BDD_STRIPMARK(bdd)));
 }
 
 void
 sylvan_serialize_reset()
 {
-    sylvan_ser_free(&sylvan_ser_set);
-    sylvan_ser_free(&sylvan_ser_reversed_set);
-    sylvan_ser_counter = 1;
+    ser_index_free(&sylvan_ser_index);
     sylvan_ser_done = 0;
 }
 
@@ -2115,78 +3259,78 @@ size_t
 sylvan_serialize_get(BDD bdd)
 {
     if (!sylvan_isnode(bdd)) return bdd;
-    struct sylvan_ser s, *ss;
-    s.bdd = BDD_STRIPMARK(bdd);
-    ss = sylvan_ser_search(sylvan_ser_set, &s);
-    assert(ss != NULL);
-    return BDD_TRANSFERMARK(bdd, ss->assigned);
+    size_t value = ser_index_get(sylvan_ser(), BDD_STRIPMARK(bdd));
+    assert(value != 0);
+    return BDD_TRANSFERMARK(bdd, value);
 }
 
 BDD
 sylvan_serialize_get_reversed(size_t value)
 {
     if (!sylvan_isnode(value)) return value;
-    struct sylvan_ser s, *ss;
-    s.assigned = BDD_STRIPMARK(value);
-    ss = sylvan_ser_reversed_search(sylvan_ser_reversed_set, &s);
-    assert(ss != NULL);
-    return BDD_TRANSFERMARK(value, ss->bdd);
+    return BDD_TRANSFERMARK(value, ser_index_get_reversed(sylvan_ser(), BDD_STRIPMARK(value)));
 }
 
 void
 sylvan_serialize_totext(FILE *out)
 {
-    fprintf(out, "[");
-    avl_iter_t *it = sylvan_ser_reversed_iter(sylvan_ser_reversed_set);
-    struct sylvan_ser *s;
+    ser_index_t *idx = sylvan_ser();
 
-    while ((s=sylvan_ser_reversed_iter_next(it))) {
-        BDD bdd = s->bdd;
+    fprintf(out, "[");
+    for (size_t i=0; i<idx->count; i++) {
+        BDD bdd = idx->nodes[i];
         bddnode_t n = MTBDD_GETNODE(bdd);
-        fprintf(out, "(%zu,%u,%zu,%zu,%u),", s->assigned,
+        fprintf(out, "(%zu,%u,%zu,%zu,%u),", idx->first+i,
                                              bddnode_getvariable(n),
                                              (size_t)bddnode_getlow(n),
                                              (size_t)BDD_STRIPMARK(bddnode_gethigh(n)),
                                              BDD_HASMARK(bddnode_gethigh(n)) ? 1 : 0);
     }
-
-    sylvan_ser_reversed_iter_free(it);
     fprintf(out, "]");
 }
 
+/**
+ * Encode the <count> nodes in <bdds> in <buffer> (in parallel)
+ */
+VOID_TASK_3(sylvan_serialize_encode, struct bddnode*, buffer, const BDD*, bdds, size_t, count)
+{
+    if (count > 1024) {
+        SPAWN(sylvan_serialize_encode, buffer, bdds, count/2);
+        CALL(sylvan_serialize_encode, buffer+count/2, bdds+count/2, count-count/2);
+        SYNC(sylvan_serialize_encode);
+        return;
+    }
+    for (size_t i=0; i<count; i++) {
+        bddnode_t n = MTBDD_GETNODE(bdds[i]);
+        bddnode_makenode(&buffer[i], bddnode_getvariable(n), sylvan_serialize_get(bddnode_getlow(n)), sylvan_serialize_get(bddnode_gethigh(n)));
+    }
+}
+
 void
 sylvan_serialize_tofile(FILE *out)
 {
-    size_t count = avl_count(sylvan_ser_reversed_set);
-    assert(count >= sylvan_ser_done);
-    assert(count == sylvan_ser_counter-1);
-    count -= sylvan_ser_done;
-    fwrite(&count, sizeof(size_t), 1, out);
+    LACE_ME;
 
-    struct sylvan_ser *s;
-    avl_iter_t *it = sylvan_ser_reversed_iter(sylvan_ser_reversed_set);
+    ser_index_t *idx = sylvan_ser();
+    assert(idx->count >= sylvan_ser_done);
+    size_t count = idx->count - sylvan_ser_done;
+    fwrite(&count, sizeof(size_t), 1, out);
 
-    /* Skip already written entries */
-    size_t index = 0;
-    while (index < sylvan_ser_done && (s=sylvan_ser_reversed_iter_next(it))) {
-        index++;
-        assert(s->assigned == index);
+    /* Write the new entries in chunks */
+    const size_t chunk = 1<<16;
+    struct bddnode *buffer = (struct bddnode*)malloc(sizeof(struct bddnode[chunk]));
+    if (buffer == NULL) {
+        fprintf(stderr, "sylvan_serialize_tofile: Unable to allocate memory!\n");
+        exit(1);
     }
-
-    while ((s=sylvan_ser_reversed_iter_next(it))) {
-        index++;
-        assert(s->assigned == index);
-
-        bddnode_t n = MTBDD_GETNODE(s->bdd);
-
-        struct bddnode node;
-        bddnode_makenode(&node, bddnode_getvariable(n), sylvan_serialize_get(bddnode_getlow(n)), sylvan_serialize_get(bddnode_gethigh(n)));
-
-        fwrite(&node, sizeof(struct bddnode), 1, out);
+    for (size_t i=sylvan_ser_done; i<idx->count; i+=chunk) {
+        const size_t n = idx->count-i < chunk ? idx->count-i : chunk;
+        CALL(sylvan_serialize_encode, buffer, idx->nodes+i, n);
+        fwrite(buffer, sizeof(struct bddnode), n, out);
     }
+    free(buffer);
 
-    sylvan_ser_done = sylvan_ser_counter-1;
-    sylvan_ser_reversed_iter_free(it);
+    sylvan_ser_done = idx->count;
 }
 
 void
@@ -2199,6 +3343,8 @@ sylvan_serialize_fromfile(FILE *in)
         exit(-1);
     }
 
+    ser_index_t *idx = sylvan_ser();
+
     for (i=1; i<=count; i++) {
         struct bddnode node;
         if (fread(&node, sizeof(struct bddnode), 1, in) != 1) {
@@ -2210,12 +3356,11 @@ sylvan_serialize_fromfile(FILE *in)
         BDD low = sylvan_serialize_get_reversed(bddnode_getlow(&node));
         BDD high = sylvan_serialize_get_reversed(bddnode_gethigh(&node));
 
-        struct sylvan_ser s;
-        s.bdd = sylvan_makenode(bddnode_getvariable(&node), low, high);
-        s.assigned = ++sylvan_ser_done; // starts at 0 but we want 1-based...
-
-        sylvan_ser_insert(&sylvan_ser_set, &s);
-        sylvan_ser_reversed_insert(&sylvan_ser_reversed_set, &s);
+        /* sylvan_makenode normalizes the complement edge, so store the node without the mark */
+        BDD bdd = sylvan_makenode(bddnode_getvariable(&node), low, high);
+        assert(!BDD_HASMARK(bdd));
+        ser_index_put(idx, bdd);
+        sylvan_ser_done++;
     }
 }
 
@@ -48,6 +48,7 @@ sylvan_isnode(MTBDD bdd)
  * The appropriate value depends on the number of variables and the structure of
  * the decision diagrams. When in doubt, choose a low value (1-5). The performance
  * gain can be around 0-10%, so it is not extremely important.
+ * See sylvan_set_adaptive_granularity to let Sylvan choose the granularity at runtime.
  */
 void sylvan_set_granularity(int granularity);
 int sylvan_get_granularity(void);
@@ -78,6 +79,25 @@ TASK_DECL_3(BDD, sylvan_xor, BDD, BDD, BDDVAR);
 #define sylvan_diff(a,b) sylvan_and(a,sylvan_not(b))
 #define sylvan_less(a,b) sylvan_and(sylvan_not(a),b)
 
+/**
+ * Compute the conjunction (disjunction) of the <n> BDDs in <arr>.
+ * In every round, the smallest BDDs (by number of nodes) are paired, as in a Huffman merge,
+ * and all pairs of a round are computed in parallel.
+ */
+TASK_DECL_2(BDD, sylvan_and_many, const BDD*, size_t);
+#define sylvan_and_many(arr, n) (CALL(sylvan_and_many, arr, n))
+TASK_DECL_2(BDD, sylvan_or_many, const BDD*, size_t);
+#define sylvan_or_many(arr, n) (CALL(sylvan_or_many, arr, n))
+
+/**
+ * Compute \exists <vars>: <arr>[0] \and ... \and <arr>[n-1], for instance the image of a set under
+ * a conjunctively partitioned transition relation (with the set as one of the conjuncts).
+ * The conjuncts are ordered such that variables are quantified as early as possible:
+ * every variable is quantified with the last conjunct in whose support it occurs.
+ */
+TASK_DECL_3(BDD, sylvan_and_exists_many, const BDD*, size_t, BDDSET);
+#define sylvan_and_exists_many(arr, n, vars) (CALL(sylvan_and_exists_many, arr, n, vars))
+
 /* Create a BDD representing just <var> or the negation of <var> */
 static inline BDD
 sylvan_nithvar(uint32_t var)
@@ -139,6 +159,43 @@ TASK_DECL_4(BDD, sylvan_relprev, BDD, BDD, BDDSET, BDDVAR);
 TASK_DECL_4(BDD, sylvan_relnext, BDD, BDD, BDDSET, BDDVAR);
 #define sylvan_relnext(a,b,vars) CALL(sylvan_relnext,a,b,vars,0)
 
+/**
+ * Compute R(s) = \exists x: A(x) \and B(x,s) for a relation B given with read/write projections.
+ * Parameters read and write are cubes of s variables (even levels).
+ * B is defined on the s variables in read and on the t variables (s+1) of the variables in write.
+ * The s variables that are read but not written keep their value (B only restricts them),
+ * without the copy constraint s=t in B. Variables that are not written also keep their value.
+ * Other variables in B are "ignored" (existential quantification)
+ *
+ * Use this function to take the 'next' of a set with a relation that has no copy constraints.
+ */
+TASK_DECL_5(BDD, sylvan_relnext_rw, BDD, BDD, BDDSET, BDDSET, BDDVAR);
+#define sylvan_relnext_rw(a,b,read,write) CALL(sylvan_relnext_rw,a,b,read,write,0)
+
+/**
+ * Compute the union of sylvan_relnext(set, relations[i], variables[i]) for the <count> relations.
+ * The set is traversed once for all relations until the top variable of each relation is reached,
+ * and the successors are combined on the way up, instead of computing one full image per relation.
+ * The results for every subtree are stored in the operation cache, and reused in later calls
+ * with the same relations (in any order).
+ */
+TASK_DECL_4(BDD, sylvan_relnext_multi, BDD, const BDD*, const BDDSET*, int);
+#define sylvan_relnext_multi(set, relations, variables, count) CALL(sylvan_relnext_multi,set,relations,variables,count)
+
+/**
+ * Cluster the <count> transition relations <relations> (on the s and t variables <variables>,
+ * as for sylvan_relnext) into fewer, larger relations with the same union.
+ * Every relation is merged with the cluster that shares the most variables with it,
+ * as long as the merged relation has at most <threshold> nodes. Relations are extended with
+ * the copy constraint s=t for the pairs of the cluster that they do not have. As in sylvan_relnext,
+ * a relation has the pair (s,t) if s or t is in its variables; the other variable is unconstrained.
+ * Writes the clusters to <out_relations> and <out_variables> (which may be the input arrays)
+ * and returns the number of clusters. The result can be used with sylvan_relnext_multi and
+ * sylvan_saturate, or with sylvan_relnext for every cluster.
+ */
+TASK_DECL_6(int, sylvan_cluster_relations, const BDD*, const BDDSET*, int, size_t, BDD*, BDDSET*);
+#define sylvan_cluster_relations(relations, variables, count, threshold, out_relations, out_variables) CALL(sylvan_cluster_relations,relations,variables,count,threshold,out_relations,out_variables)
+
 /**
  * Computes the transitive closure by traversing the BDD recursively.
  * See Y. Matsunaga, P. C. McGeer, R. K. Brayton
@@ -152,6 +209,18 @@ TASK_DECL_4(BDD, sylvan_relnext, BDD, BDD, BDDSET, BDDVAR);
 TASK_DECL_2(BDD, sylvan_closure, BDD, BDDVAR);
 #define sylvan_closure(a) CALL(sylvan_closure,a,0);
 
+/**
+ * Compute the states reachable from <set> with the <count> transition relations <relations>,
+ * using saturation. For each relation, <variables> is the cube of its s and t variables,
+ * or sylvan_false for a relation on all variables, as for sylvan_relnext. The relations are grouped by their top variable. Every group is
+ * applied until a fixpoint is reached, after saturating the subtrees with the groups below.
+ * Subtrees above the top variable of a group are saturated in parallel.
+ * The results for every subtree are stored in the operation cache, and reused in later calls
+ * with the same relations (in any order).
+ */
+TASK_DECL_4(BDD, sylvan_saturate, BDD, const BDD*, const BDDSET*, int);
+#define sylvan_saturate(set, relations, variables, count) CALL(sylvan_saturate,set,relations,variables,count)
+
 /**
  * Compute f@c (f constrain c), such that f and f@c are the same when c is true
  * The BDD c is also called the "care function"
@@ -173,6 +242,34 @@ TASK_DECL_3(BDD, sylvan_constrain, BDD, BDD, BDDVAR);
 TASK_DECL_3(BDD, sylvan_restrict, BDD, BDD, BDDVAR);
 #define sylvan_restrict(f,c) (CALL(sylvan_restrict, f, c, 0))
 
+/**
+ * Approximate <f> by a BDD with at most <threshold> nodes (as counted by sylvan_nodecount).
+ *
+ * Under-approximations (the result implies f):
+ * - sylvan_subset_heavy: heavy-branch subsetting. At every node, the child with the most minterms
+ *   is the heavy branch. Keeps the paths that take the other branch at most k times,
+ *   for the largest k found by binary search such that the result fits.
+ *   The result is at least the heaviest path of f, even if that does not fit.
+ * - sylvan_subset_short: short-path subsetting. Keeps the paths with at most k nodes,
+ *   for the largest k found by binary search such that the result fits (possibly false).
+ * - sylvan_underapprox: remaps the nodes of the level with the most nodes to the conjunction
+ *   of their children (universal abstraction), until the result fits.
+ *
+ * Over-approximation (f implies the result):
+ * - sylvan_overapprox: existential abstraction of the level with the most nodes, until the result fits.
+ *
+ * The subsetting operations are parallel and use the operation cache.
+ * Node counting and the selection of levels are sequential.
+ */
+TASK_DECL_2(BDD, sylvan_subset_heavy, BDD, size_t);
+#define sylvan_subset_heavy(f, threshold) (CALL(sylvan_subset_heavy, f, threshold))
+TASK_DECL_2(BDD, sylvan_subset_short, BDD, size_t);
+#define sylvan_subset_short(f, threshold) (CALL(sylvan_subset_short, f, threshold))
+TASK_DECL_2(BDD, sylvan_underapprox, BDD, size_t);
+#define sylvan_underapprox(f, threshold) (CALL(sylvan_underapprox, f, threshold))
+TASK_DECL_2(BDD, sylvan_overapprox, BDD, size_t);
+#define sylvan_overapprox(f, threshold) (CALL(sylvan_overapprox, f, threshold))
+
 /**
  * Function composition.
  * For each node with variable <key> which has a <key,value> pair in <map>,
@@ -189,6 +286,15 @@ TASK_DECL_3(BDD, sylvan_compose, BDD, BDDMAP, BDDVAR);
 TASK_DECL_3(double, sylvan_satcount, BDD, BDDSET, BDDVAR);
 #define sylvan_satcount(bdd, variables) CALL(sylvan_satcount, bdd, variables, 0)
 
+/**
+ * Calculate the base-2 logarithm of the number of satisfying variable assignments.
+ * Does not overflow (unlike sylvan_satcount), but is only an estimate for large counts.
+ * Returns -INFINITY if the BDD is sylvan_false.
+ * For the exact number, see sylvan_satcount_mpz in sylvan_gmp.h.
+ */
+TASK_DECL_3(double, sylvan_satcount_log2, BDD, BDDSET, BDDVAR);
+#define sylvan_satcount_log2(bdd, variables) CALL(sylvan_satcount_log2, bdd, variables, 0)
+
 /**
  * Create a BDD cube representing the conjunction of variables in their positive or negative
  * form depending on whether the cube[idx] equals 0 (negative), 1 (positive) or 2 (any).
@@ -223,6 +329,18 @@ BDD sylvan_sat_one_bdd(BDD bdd);
 BDD sylvan_sat_single(BDD bdd, BDDSET vars);
 #define sylvan_pick_single_cube sylvan_sat_single
 
+/**
+ * Draw <k> independent samples, uniformly at random, from the satisfying variable assignments
+ * of <bdd> using the variables in <variables>. The samples are written to <out>, which has room
+ * for <k> arrays of n values 0 and 1, where n is the number of variables in <variables>.
+ * The samples are drawn in parallel; the result only depends on <seed>.
+ * The probabilities are computed with sylvan_satcount_log2 (stored in the operation cache).
+ *
+ * Returns 1 when succesful, or 0 when no assignment is found (i.e. bdd==sylvan_false).
+ */
+TASK_DECL_5(int, sylvan_sample, BDD, BDDSET, size_t, uint64_t, uint8_t*);
+#define sylvan_sample(bdd, variables, k, seed, out) CALL(sylvan_sample, bdd, variables, k, seed, out)
+
 /**
  * Enumerate all satisfying variable assignments from the given <bdd> using variables <vars>.
  * Calls <cb> with four parameters: a user-supplied context, the array of BDD variables in <vars>,
@@ -234,6 +352,18 @@ VOID_TASK_DECL_4(sylvan_enum, BDD, BDDSET, enum_cb, void*);
 VOID_TASK_DECL_4(sylvan_enum_par, BDD, BDDSET, enum_cb, void*);
 #define sylvan_enum_par(bdd, vars, cb, context) CALL(sylvan_enum_par, bdd, vars, cb, context)
 
+/**
+ * Enumerate all satisfying variable assignments from the given <bdd> using variables <vars>, in batches.
+ * Subtrees are enumerated in parallel, and every worker fills its own buffer of <batch> cubes.
+ * Every cube is an array of n values 0 and 1, where n is the number of variables in <vars>.
+ * When a buffer is full (and at the end), <cb> is called with three parameters: a user-supplied context,
+ * the buffer and the number of cubes in the buffer. The buffer is reused after <cb> returns.
+ * Different workers can call <cb> concurrently; <cb> must not spawn Lace tasks.
+ */
+LACE_TYPEDEF_CB(void, sylvan_enum_batch_cb, void*, uint8_t*, size_t);
+VOID_TASK_DECL_5(sylvan_enum_batch, BDD, BDDSET, size_t, sylvan_enum_batch_cb, void*);
+#define sylvan_enum_batch(bdd, vars, batch, cb, context) CALL(sylvan_enum_batch, bdd, vars, batch, cb, context)
+
 /**
  * Enumerate all satisfyable variable assignments of the given <bdd> using variables <vars>.
  * Calls <cb> with two parameters: a user-supplied context and the cube (array of
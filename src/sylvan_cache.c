@@ -310,3 +310,134 @@ cache_getmaxsize()
 {
     return cache_max;
 }
+
+/**
+ * Adaptive granularity: the current granularity of each operation and band,
+ * and the hit counters of each worker.
+ */
+
+#define CACHE_GRANULARITY_WINDOW 1024
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t hits;
+} cache_granularity_counter_t;
+
+int cache_adaptive = 0;
+uint8_t cache_granularity_table[CACHE_GRANULARITY_OPS][CACHE_GRANULARITY_BANDS];
+static cache_granularity_counter_t *cache_granularity_counters = NULL;
+
+void
+cache_set_adaptive(int enabled)
+{
+    cache_adaptive = 0;
+    free(cache_granularity_counters);
+    cache_granularity_counters = NULL;
+    if (!enabled) return;
+
+    // start with granularity 1 (always use the cache) everywhere
+    memset(cache_granularity_table, 1, sizeof(cache_granularity_table));
+    const size_t count = lace_workers() * CACHE_GRANULARITY_OPS * CACHE_GRANULARITY_BANDS;
+    cache_granularity_counters = (cache_granularity_counter_t*)calloc(count, sizeof(cache_granularity_counter_t));
+    if (cache_granularity_counters == NULL) {
+        fprintf(stderr, "cache_set_adaptive: Unable to allocate memory!\n");
+        exit(1);
+    }
+    cache_adaptive = 1;
+}
+
+void
+cache_granularity_count(uint64_t opid, uint32_t level, int hit)
+{
+    WorkerP *w = lace_get_worker();
+    if (w == NULL || cache_granularity_counters == NULL) return;
+
+    const size_t op = (opid >> 40) & (CACHE_GRANULARITY_OPS-1);
+    size_t band = level / CACHE_GRANULARITY_BAND;
+    if (band >= CACHE_GRANULARITY_BANDS) band = CACHE_GRANULARITY_BANDS - 1;
+
+    cache_granularity_counter_t *c = cache_granularity_counters;
+    c += (w->worker * CACHE_GRANULARITY_OPS + op) * CACHE_GRANULARITY_BANDS + band;
+    c->lookups++;
+    if (hit) c->hits++;
+    if (c->lookups < CACHE_GRANULARITY_WINDOW) return;
+
+    // less than 1/64 hits: use the cache less often; more than 1/8 hits: use the cache more often
+    volatile uint8_t *g = &cache_granularity_table[op][band];
+    if (c->hits * 64 < c->lookups) {
+        if (*g < CACHE_GRANULARITY_MAX) *g = *g + 1;
+    } else if (c->hits * 8 > c->lookups) {
+        if (*g > 1) *g = *g - 1;
+    }
+    c->lookups = 0;
+    c->hits = 0;
+}
+
+/**
+ * Registry of arrays for cache_key_id, most recently used first.
+ */
+
+#define CACHE_KEYS_MAX 64
+
+typedef struct cache_key_entry
+{
+    struct cache_key_entry *next;
+    uint64_t id;
+    size_t len;
+    uint64_t key[];
+} *cache_key_entry_t;
+
+static cache_key_entry_t cache_keys = NULL;
+static uint64_t cache_keys_next = 1;
+static pthread_mutex_t cache_keys_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t
+cache_key_id(const uint64_t *key, size_t len)
+{
+    pthread_mutex_lock(&cache_keys_mutex);
+
+    // find the array, move it to the front
+    cache_key_entry_t *prev = &cache_keys, e;
+    size_t count = 0;
+    while ((e = *prev) != NULL) {
+        if (e->len == len && memcmp(e->key, key, len * sizeof(uint64_t)) == 0) {
+            *prev = e->next;
+            e->next = cache_keys;
+            cache_keys = e;
+            pthread_mutex_unlock(&cache_keys_mutex);
+            return e->id;
+        }
+        if (++count == CACHE_KEYS_MAX && e->next != NULL) {
+            // forget the least recently used array
+            free(e->next);
+            e->next = NULL;
+        }
+        prev = &e->next;
+    }
+
+    e = (cache_key_entry_t)malloc(sizeof(struct cache_key_entry) + len * sizeof(uint64_t));
+    if (e == NULL) {
+        fprintf(stderr, "cache_key_id: Unable to allocate memory!\n");
+        exit(1);
+    }
+    e->id = cache_keys_next++;
+    e->len = len;
+    memcpy(e->key, key, len * sizeof(uint64_t));
+    e->next = cache_keys;
+    cache_keys = e;
+
+    pthread_mutex_unlock(&cache_keys_mutex);
+    return e->id;
+}
+
+void
+cache_keys_free()
+{
+    pthread_mutex_lock(&cache_keys_mutex);
+    while (cache_keys != NULL) {
+        cache_key_entry_t e = cache_keys;
+        cache_keys = e->next;
+        free(e);
+    }
+    pthread_mutex_unlock(&cache_keys_mutex);
+}
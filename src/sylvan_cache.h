@@ -109,6 +109,73 @@ cache_put4(uint64_t opid, uint64_t dd, uint64_t dd2, uint64_t dd3, uint64_t dd4,
  * Functions for Sylvan for cache management
  */
 
+/**
+ * Adaptive granularity (see sylvan_set_adaptive_granularity).
+ * For every operation (indexed by opid) and every band of CACHE_GRANULARITY_BAND levels,
+ * each worker measures the hit ratio of the operation cache over a window of lookups,
+ * then increases the granularity if the hit ratio is low and decreases it if the hit ratio is high.
+ */
+#define CACHE_GRANULARITY_OPS 64
+#define CACHE_GRANULARITY_BANDS 16
+#define CACHE_GRANULARITY_BAND 32
+#define CACHE_GRANULARITY_MAX 8
+
+extern int cache_adaptive;
+extern uint8_t cache_granularity_table[CACHE_GRANULARITY_OPS][CACHE_GRANULARITY_BANDS];
+
+void cache_set_adaptive(int enabled);
+
+void cache_granularity_count(uint64_t opid, uint32_t level, int hit);
+
+/**
+ * Get the current granularity of operation <opid> at level <level> (only in adaptive mode)
+ */
+static inline int __attribute__((unused))
+cache_granularity(uint64_t opid, uint32_t level)
+{
+    uint32_t band = level / CACHE_GRANULARITY_BAND;
+    if (band >= CACHE_GRANULARITY_BANDS) band = CACHE_GRANULARITY_BANDS - 1;
+    return cache_granularity_table[(opid >> 40) & (CACHE_GRANULARITY_OPS-1)][band];
+}
+
+/**
+ * Decide whether to use the cache for operation <opid> at level <level> on operands <a> and <b>.
+ * For operations that do not follow a fixed order of levels (such as LDD operations), a hash of the
+ * operands selects the subproblems that use the cache, on average one in the current granularity.
+ * Always 1 if adaptive granularity is disabled.
+ */
+static inline int __attribute__((unused))
+cache_granularity_now(uint64_t opid, uint32_t level, uint64_t a, uint64_t b)
+{
+    if (__builtin_expect(!cache_adaptive, 1)) return 1;
+    const int g = cache_granularity(opid, level);
+    return g < 2 || (((a ^ (b << 21)) * 0x9E3779B97F4A7C15ULL) >> 40) % g == 0;
+}
+
+/**
+ * Like cache_get3, but in adaptive mode, also count the hit or miss for operation <opid> at level <level>.
+ */
+static inline int __attribute__((unused))
+cache_get3_level(uint64_t opid, uint32_t level, uint64_t dd, uint64_t d2, uint64_t d3, uint64_t *res)
+{
+    int hit = cache_get3(opid, dd, d2, d3, res);
+    if (__builtin_expect(cache_adaptive, 0)) cache_granularity_count(opid, level, hit);
+    return hit;
+}
+
+/**
+ * Obtain an identifier for the array <key> of <len> 64-bit values, for operations that are
+ * parameterized by an array (such as saturation with an array of transition relations).
+ * Identical arrays get the same identifier, so results of such operations can be cached across calls.
+ * Identifiers are never reused; only the most recently used arrays are remembered.
+ */
+uint64_t cache_key_id(const uint64_t *key, size_t len);
+
+/**
+ * Forget all arrays registered with cache_key_id.
+ */
+void cache_keys_free(void);
+
 void cache_create(size_t _cache_size, size_t _max_size);
 
 void cache_free(void);
@@ -220,6 +220,7 @@ VOID_TASK_0(sylvan_gc_go)
 {
     sylvan_stats_count(SYLVAN_GC_COUNT);
     sylvan_timer_start(SYLVAN_GC);
+    LACE_TRACE_BEGIN("gc");
 
     // call pre gc hooks
     for (gc_hook_entry_t e = pregc_list; e != NULL; e = e->next) {
@@ -231,20 +232,29 @@ VOID_TASK_0(sylvan_gc_go)
      * Alternatively, we could implement for example some strategy
      * where part of the cache is cleared and part is marked
      */
+    LACE_TRACE_BEGIN("gc clear cache");
     CALL(sylvan_clear_cache);
+    LACE_TRACE_END("gc clear cache");
 
+    LACE_TRACE_BEGIN("gc mark");
     CALL(sylvan_clear_and_mark);
+    LACE_TRACE_END("gc mark");
 
     // call hooks for resizing and all that
+    LACE_TRACE_BEGIN("gc main hook");
     WRAP(main_hook);
+    LACE_TRACE_END("gc main hook");
 
+    LACE_TRACE_BEGIN("gc rehash");
     CALL(sylvan_rehash_all);
+    LACE_TRACE_END("gc rehash");
 
     // call post gc hooks
     for (gc_hook_entry_t e = postgc_list; e != NULL; e = e->next) {
         WRAP(e->cb);
     }
 
+    LACE_TRACE_END("gc");
     sylvan_timer_stop(SYLVAN_GC);
 }
 
@@ -348,6 +358,18 @@ sylvan_set_limits(size_t memorycap, int table_ratio, int initial_ratio)
     cache_max = max_c;
 }
 
+void
+sylvan_set_adaptive_granularity(int enabled)
+{
+    cache_set_adaptive(enabled);
+}
+
+int
+sylvan_get_adaptive_granularity()
+{
+    return cache_adaptive;
+}
+
 /**
  * Initializes Sylvan.
  */
@@ -420,6 +442,8 @@ sylvan_quit()
         free(e);
     }
 
+    cache_set_adaptive(0);
+    cache_keys_free();
     cache_free();
     llmsset_free(nodes);
 }
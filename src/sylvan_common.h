@@ -69,6 +69,21 @@ void sylvan_set_sizes(size_t min_tablesize, size_t max_tablesize, size_t min_cac
  */
 void sylvan_set_limits(size_t memory_cap, int table_ratio, int initial_ratio);
 
+/**
+ * Enable (1) or disable (0) adaptive granularity of the operation cache.
+ *
+ * In adaptive mode, the granularity (see sylvan_set_granularity) is chosen per operation,
+ * and for BDD operations also per band of 32 levels. Every operation starts with granularity 1.
+ * The hit ratio of the operation cache is measured at runtime; when few lookups are hits,
+ * the granularity is increased (up to 8), when many lookups are hits, it is decreased again.
+ * LDD operations (lddmc_union, lddmc_minus, lddmc_intersect, lddmc_match, lddmc_relprod,
+ * lddmc_project and lddmc_project_minus) always use the cache when adaptive mode is disabled.
+ *
+ * Call this after sylvan_init_package, while no Sylvan operations are running.
+ */
+void sylvan_set_adaptive_granularity(int enabled);
+int sylvan_get_adaptive_granularity(void);
+
 /**
  * Frees all Sylvan data (also calls the quit() functions of BDD/LDD parts)
  */
@@ -21,6 +21,8 @@
 #include <math.h>
 #include <string.h>
 
+#define cas(ptr, old, new) (__sync_bool_compare_and_swap((ptr),(old),(new)))
+
 static uint32_t gmp_type;
 
 /**
@@ -753,3 +755,223 @@ TASK_IMPL_3(MTBDD, gmp_and_abstract_max, MTBDD, a, MTBDD, b, MTBDD, v)
 
     return result;
 }
+
+/**
+ * Arbitrary-precision satcount and pathcount.
+ * Big integers do not fit in the operation cache, so every call uses its own memo table,
+ * an open addressing table from BDD (or LDD) nodes to mpz values. A worker claims a bucket before
+ * computing the value; a worker that finds a claimed bucket that is not yet filled simply
+ * computes the value itself. When the table is full, values are not stored.
+ */
+typedef struct gmp_count_bucket {
+    volatile uint64_t key;      // the BDD, or 0 if empty
+    volatile int done;          // set when value is filled
+    mpz_t value;
+} gmp_count_bucket_t;
+
+typedef struct gmp_count_memo {
+    gmp_count_bucket_t *buckets;
+    size_t mask;                // size-1, the size is a power of 2
+} gmp_count_memo_t;
+
+#define GMP_COUNT_PROBES 128
+
+static void
+gmp_count_memo_init(gmp_count_memo_t *memo, size_t nodes)
+{
+    size_t size = 64;
+    while (size < 4*nodes) size <<= 1;
+    memo->buckets = (gmp_count_bucket_t*)calloc(size, sizeof(gmp_count_bucket_t));
+    if (memo->buckets == NULL) {
+        fprintf(stderr, "gmp_count_memo_init: Unable to allocate memory!\n");
+        exit(1);
+    }
+    memo->mask = size-1;
+}
+
+static void
+gmp_count_memo_free(gmp_count_memo_t *memo)
+{
+    for (size_t i=0; i<=memo->mask; i++) {
+        if (memo->buckets[i].done) mpz_clear(memo->buckets[i].value);
+    }
+    free(memo->buckets);
+}
+
+static inline size_t
+gmp_count_memo_hash(uint64_t key)
+{
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20);
+}
+
+static int
+gmp_count_memo_get(gmp_count_memo_t *memo, BDD bdd, mpz_ptr result)
+{
+    size_t idx = gmp_count_memo_hash(bdd);
+    for (int i=0; i<GMP_COUNT_PROBES; i++, idx++) {
+        gmp_count_bucket_t *b = &memo->buckets[idx & memo->mask];
+        const uint64_t key = b->key;
+        if (key == 0) return 0;
+        if (key == bdd) {
+            if (!b->done) return 0;
+            __sync_synchronize();
+            mpz_set(result, b->value);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+gmp_count_memo_put(gmp_count_memo_t *memo, BDD bdd, mpz_srcptr value)
+{
+    size_t idx = gmp_count_memo_hash(bdd);
+    for (int i=0; i<GMP_COUNT_PROBES; i++, idx++) {
+        gmp_count_bucket_t *b = &memo->buckets[idx & memo->mask];
+        const uint64_t key = b->key;
+        if (key == bdd) return; // claimed by another worker
+        if (key == 0) {
+            if (!cas(&b->key, 0, bdd)) {
+                if (b->key == bdd) return;
+                continue;
+            }
+            mpz_init_set(b->value, value);
+            __sync_synchronize();
+            b->done = 1;
+            return;
+        }
+    }
+}
+
+VOID_TASK_4(sylvan_satcount_mpz_rec, mpz_ptr, result, BDD, bdd, BDDSET, variables, gmp_count_memo_t*, memo)
+{
+    /* Trivial cases */
+    if (bdd == sylvan_false) {
+        mpz_set_ui(result, 0);
+        return;
+    }
+    if (bdd == sylvan_true) {
+        mpz_set_ui(result, 1);
+        mpz_mul_2exp(result, result, sylvan_set_count(variables));
+        return;
+    }
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_SATCOUNT);
+
+    /* Count variables before var(bdd) */
+    size_t skipped = 0;
+    BDDVAR var = sylvan_var(bdd);
+    while (sylvan_set_first(variables) != var) {
+        skipped++;
+        variables = sylvan_set_next(variables);
+        // if this assertion fails, then variables is not the support of <bdd>
+        assert(!sylvan_set_isempty(variables));
+    }
+    variables = sylvan_set_next(variables);
+
+    /* Consult memo table */
+    if (!gmp_count_memo_get(memo, bdd, result)) {
+        mpz_t high;
+        mpz_init(high);
+        SPAWN(sylvan_satcount_mpz_rec, high, sylvan_high(bdd), variables, memo);
+        CALL(sylvan_satcount_mpz_rec, result, sylvan_low(bdd), variables, memo);
+        SYNC(sylvan_satcount_mpz_rec);
+        mpz_add(result, result, high);
+        mpz_clear(high);
+        gmp_count_memo_put(memo, bdd, result);
+    }
+
+    mpz_mul_2exp(result, result, skipped);
+}
+
+VOID_TASK_IMPL_3(sylvan_satcount_mpz, mpz_ptr, result, BDD, bdd, BDDSET, variables)
+{
+    gmp_count_memo_t memo;
+    gmp_count_memo_init(&memo, sylvan_nodecount(bdd));
+    CALL(sylvan_satcount_mpz_rec, result, bdd, variables, &memo);
+    gmp_count_memo_free(&memo);
+}
+
+VOID_TASK_3(sylvan_pathcount_mpz_rec, mpz_ptr, result, BDD, bdd, gmp_count_memo_t*, memo)
+{
+    /* Trivial cases */
+    if (bdd == sylvan_false) {
+        mpz_set_ui(result, 0);
+        return;
+    }
+    if (bdd == sylvan_true) {
+        mpz_set_ui(result, 1);
+        return;
+    }
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(BDD_PATHCOUNT);
+
+    /* Consult memo table */
+    if (gmp_count_memo_get(memo, bdd, result)) return;
+
+    mpz_t high;
+    mpz_init(high);
+    SPAWN(sylvan_pathcount_mpz_rec, high, sylvan_high(bdd), memo);
+    CALL(sylvan_pathcount_mpz_rec, result, sylvan_low(bdd), memo);
+    SYNC(sylvan_pathcount_mpz_rec);
+    mpz_add(result, result, high);
+    mpz_clear(high);
+
+    gmp_count_memo_put(memo, bdd, result);
+}
+
+VOID_TASK_IMPL_2(sylvan_pathcount_mpz, mpz_ptr, result, BDD, bdd)
+{
+    gmp_count_memo_t memo;
+    gmp_count_memo_init(&memo, sylvan_nodecount(bdd));
+    CALL(sylvan_pathcount_mpz_rec, result, bdd, &memo);
+    gmp_count_memo_free(&memo);
+}
+
+VOID_TASK_3(lddmc_satcount_mpz_rec, mpz_ptr, result, MDD, mdd, gmp_count_memo_t*, memo)
+{
+    /* Trivial cases */
+    if (mdd == lddmc_false) {
+        mpz_set_ui(result, 0);
+        return;
+    }
+    if (mdd == lddmc_true) {
+        mpz_set_ui(result, 1);
+        return;
+    }
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    /* Count operation */
+    sylvan_stats_count(LDD_SATCOUNT);
+
+    /* Consult memo table */
+    if (gmp_count_memo_get(memo, mdd, result)) return;
+
+    mpz_t down;
+    mpz_init(down);
+    SPAWN(lddmc_satcount_mpz_rec, down, lddmc_getdown(mdd), memo);
+    CALL(lddmc_satcount_mpz_rec, result, lddmc_getright(mdd), memo);
+    SYNC(lddmc_satcount_mpz_rec);
+    mpz_add(result, result, down);
+    mpz_clear(down);
+
+    gmp_count_memo_put(memo, mdd, result);
+}
+
+VOID_TASK_IMPL_2(lddmc_satcount_mpz, mpz_ptr, result, MDD, mdd)
+{
+    gmp_count_memo_t memo;
+    gmp_count_memo_init(&memo, lddmc_nodecount(mdd));
+    CALL(lddmc_satcount_mpz_rec, result, mdd, &memo);
+    gmp_count_memo_free(&memo);
+}
@@ -184,6 +184,29 @@ TASK_DECL_2(MTBDD, gmp_threshold_d, MTBDD, double);
 TASK_DECL_2(MTBDD, gmp_strict_threshold_d, MTBDD, double);
 #define gmp_strict_threshold_d(dd, value) CALL(gmp_strict_threshold_d, dd, value)
 
+/**
+ * Compute the number of satisfying variable assignments of the BDD <bdd>, using the variables in <variables>,
+ * and store it in <result> (which must be initialized). Unlike sylvan_satcount, the result does not overflow.
+ * Intermediate results are stored in a memo table for this call (not in the operation cache).
+ */
+VOID_TASK_DECL_3(sylvan_satcount_mpz, mpz_ptr, BDD, BDDSET);
+#define sylvan_satcount_mpz(result, bdd, variables) CALL(sylvan_satcount_mpz, result, bdd, variables)
+
+/**
+ * Compute the number of distinct paths to sylvan_true in the BDD <bdd> and store it in <result>
+ * (which must be initialized). Unlike sylvan_pathcount, the result does not overflow.
+ */
+VOID_TASK_DECL_2(sylvan_pathcount_mpz, mpz_ptr, BDD);
+#define sylvan_pathcount_mpz(result, bdd) CALL(sylvan_pathcount_mpz, result, bdd)
+
+/**
+ * Compute the number of vectors in the LDD <mdd> and store it in <result> (which must be initialized).
+ * Unlike lddmc_satcount and lddmc_satcount_cached, the result does not overflow or lose precision.
+ * Intermediate results are stored in a memo table for this call (not in the operation cache).
+ */
+VOID_TASK_DECL_2(lddmc_satcount_mpz, mpz_ptr, MDD);
+#define lddmc_satcount_mpz(result, mdd) CALL(lddmc_satcount_mpz, result, mdd)
+
 #ifdef __cplusplus
 }
 }
@@ -67,6 +67,14 @@ static const uint64_t CACHE_BDD_CLOSURE             = (13LL<<40);
 static const uint64_t CACHE_BDD_ISBDD               = (14LL<<40);
 static const uint64_t CACHE_BDD_SUPPORT             = (15LL<<40);
 static const uint64_t CACHE_BDD_PATHCOUNT           = (16LL<<40);
+static const uint64_t CACHE_BDD_SATURATE            = (17LL<<40);
+static const uint64_t CACHE_BDD_RELNEXT_MULTI       = (18LL<<40);
+static const uint64_t CACHE_BDD_RELNEXT_RW          = (19LL<<40);
+// (20-31 are MDD operations)
+static const uint64_t CACHE_BDD_SATCOUNT_LOG2       = (32LL<<40);
+static const uint64_t CACHE_BDD_SUBSET_HEAVY        = (33LL<<40);
+static const uint64_t CACHE_BDD_SUBSET_SHORT        = (34LL<<40);
+// (35-39 are MDD operations)
 
 // MDD operations
 static const uint64_t CACHE_MDD_RELPROD             = (20LL<<40);
@@ -80,6 +88,12 @@ static const uint64_t CACHE_MDD_RELPREV             = (27LL<<40);
 static const uint64_t CACHE_MDD_SATCOUNT            = (28LL<<40);
 static const uint64_t CACHE_MDD_SATCOUNTL1          = (29LL<<40);
 static const uint64_t CACHE_MDD_SATCOUNTL2          = (30LL<<40);
+static const uint64_t CACHE_MDD_SATURATE            = (31LL<<40);
+static const uint64_t CACHE_MDD_TO_BDD              = (35LL<<40);
+static const uint64_t CACHE_MDD_FROM_BDD            = (36LL<<40);
+static const uint64_t CACHE_MDD_SATCOUNT_LOG2       = (37LL<<40);
+static const uint64_t CACHE_MDD_SWAP_LEVELS         = (38LL<<40);
+static const uint64_t CACHE_MDD_INSERT_LEVEL        = (39LL<<40);
 
 // MTBDD operations
 static const uint64_t CACHE_MTBDD_APPLY             = (40LL<<40);
@@ -100,12 +114,21 @@ static const uint64_t CACHE_MTBDD_GEQ               = (54LL<<40);
 static const uint64_t CACHE_MTBDD_GREATER           = (55LL<<40);
 static const uint64_t CACHE_MTBDD_EVAL_COMPOSE      = (56LL<<40);
 
+// ZDD operations
+static const uint64_t CACHE_ZDD_UNION               = (57LL<<40);
+static const uint64_t CACHE_ZDD_INTERSECT           = (58LL<<40);
+static const uint64_t CACHE_ZDD_DIFF                = (59LL<<40);
+static const uint64_t CACHE_ZDD_JOIN                = (60LL<<40);
+static const uint64_t CACHE_ZDD_MEET                = (61LL<<40);
+static const uint64_t CACHE_ZDD_COUNT               = (62LL<<40);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
 
 #include <sylvan_mtbdd_int.h>
 #include <sylvan_ldd_int.h>
+#include <sylvan_ser.h>
 
 #ifdef __cplusplus
 } /* namespace */
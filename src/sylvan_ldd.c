@@ -21,7 +21,6 @@
 #include <math.h>
 #include <string.h>
 
-#include <avl.h>
 #include <sylvan_refs.h>
 #include <sha2.h>
 
@@ -172,16 +171,15 @@ VOID_TASK_2(lddmc_refs_mark_s_par, lddmc_refs_task_t, begin, size_t, count)
 {
     if (count < 32) {
         while (count) {
+            /* inlined tasks (lazy task creation) also hold a result, so check all tasks */
             Task *t = begin->t;
-            if (!TASK_IS_STOLEN(t)) return;
-            if (t->f == begin->f && TASK_IS_COMPLETED(t)) {
+            if (t->f == begin->f && (TASK_IS_INLINED(t) || TASK_IS_COMPLETED(t))) {
                 lddmc_gc_mark_rec(*(BDD*)TASK_RESULT(t));
             }
             begin += 1;
             count -= 1;
         }
     } else {
-        if (!TASK_IS_STOLEN(begin->t)) return;
         SPAWN(lddmc_refs_mark_s_par, begin, count / 2);
         CALL(lddmc_refs_mark_s_par, begin + (count / 2), count - count / 2);
         SYNC(lddmc_refs_mark_s_par);
@@ -305,9 +303,13 @@ VOID_TASK_DECL_0(lddmc_gc_mark_serialize);
  * Initialize and quit functions
  */
 
+VOID_TASK_DECL_0(lddmc_wide_gc);
+
 static void
 lddmc_quit()
 {
+    lddmc_set_wide_levels(0);
+    lddmc_serialize_reset();
     refs_free(&lddmc_refs);
 }
 
@@ -318,6 +320,7 @@ sylvan_init_ldd()
     sylvan_gc_add_mark(TASK(lddmc_gc_mark_external_refs));
     sylvan_gc_add_mark(TASK(lddmc_gc_mark_protected));
     sylvan_gc_add_mark(TASK(lddmc_gc_mark_serialize));
+    sylvan_gc_hook_pregc(TASK(lddmc_wide_gc));
 
     refs_create(&lddmc_refs, 1024);
     if (!lddmc_protected_created) {
@@ -329,6 +332,189 @@ sylvan_init_ldd()
     CALL(lddmc_refs_init);
 }
 
+/**
+ * Wide levels
+ *
+ * Every worker has an index of values and nodes of the (suffixes of) levels that it searched.
+ * Slots map every LDD_WIDE_STRIDE-th node of an indexed level to its position in the index,
+ * so a search starting at any node finds an indexed node within LDD_WIDE_STRIDE steps.
+ * Node indices may be reused after garbage collection, so the pregc hook invalidates all indexes.
+ */
+
+#define LDD_WIDE_STRIDE 8
+#define LDD_WIDE_SLOTS 16384        // power of 2
+#define LDD_WIDE_ENTRIES 262144
+
+typedef struct lddmc_wide_slot
+{
+    MDD mdd;                        // indexed node, or lddmc_false for an empty slot
+    uint32_t pos;                   // position of the node in the index
+    uint32_t end;                   // end of the level in the index
+} lddmc_wide_slot_t;
+
+typedef struct lddmc_wide
+{
+    size_t epoch;
+    size_t used;
+    lddmc_wide_slot_t slots[LDD_WIDE_SLOTS];
+    uint32_t values[LDD_WIDE_ENTRIES];
+    MDD nodes[LDD_WIDE_ENTRIES];
+} *lddmc_wide_t;
+
+static size_t lddmc_wide_width = 0;
+static volatile size_t lddmc_wide_epoch = 0;
+static lddmc_wide_t *lddmc_wide_indexes = NULL;
+
+void
+lddmc_set_wide_levels(size_t width)
+{
+    if (lddmc_wide_indexes != NULL) {
+        for (unsigned int i=0; i<lace_workers(); i++) free(lddmc_wide_indexes[i]);
+        free(lddmc_wide_indexes);
+        lddmc_wide_indexes = NULL;
+    }
+    lddmc_wide_width = 0;
+    if (width == 0) return;
+
+    // the index of every worker is allocated when the worker first needs it
+    lddmc_wide_indexes = (lddmc_wide_t*)calloc(lace_workers(), sizeof(lddmc_wide_t));
+    if (lddmc_wide_indexes == NULL) {
+        fprintf(stderr, "lddmc_set_wide_levels: Unable to allocate memory!\n");
+        exit(1);
+    }
+    lddmc_wide_width = width < LDD_WIDE_STRIDE ? LDD_WIDE_STRIDE : width;
+}
+
+VOID_TASK_IMPL_0(lddmc_wide_gc)
+{
+    lddmc_wide_epoch++;
+}
+
+static inline lddmc_wide_slot_t*
+lddmc_wide_slot(lddmc_wide_t index, MDD mdd)
+{
+    return &index->slots[(mdd * 0x9E3779B97F4A7C15ULL) >> 50];
+}
+
+/**
+ * Get the index of the current worker, or NULL if the caller is not a worker.
+ */
+static lddmc_wide_t
+lddmc_wide_get(void)
+{
+    WorkerP *w = lace_get_worker();
+    if (w == NULL) return NULL;
+    lddmc_wide_t index = lddmc_wide_indexes[w->worker];
+    if (index == NULL) {
+        index = (lddmc_wide_t)malloc(sizeof(struct lddmc_wide));
+        if (index == NULL) return NULL;
+        index->epoch = lddmc_wide_epoch - 1;
+        lddmc_wide_indexes[w->worker] = index;
+    }
+    if (index->epoch != lddmc_wide_epoch) {
+        memset(index->slots, 0, sizeof(index->slots));
+        index->used = 0;
+        index->epoch = lddmc_wide_epoch;
+    }
+    return index;
+}
+
+/**
+ * Add the level starting at node <mdd> to the index, if it has at least lddmc_wide_width nodes.
+ * Returns 1 if the level was added.
+ */
+static int
+lddmc_wide_add(lddmc_wide_t index, MDD mdd)
+{
+    if (index->used + lddmc_wide_width > LDD_WIDE_ENTRIES) {
+        // index full: start over
+        memset(index->slots, 0, sizeof(index->slots));
+        index->used = 0;
+    }
+
+    const size_t start = index->used;
+    size_t end = start;
+    while (mdd != lddmc_false) {
+        if (end == LDD_WIDE_ENTRIES) return 0;
+        mddnode_t n = LDD_GETNODE(mdd);
+        index->values[end] = mddnode_getvalue(n);
+        index->nodes[end] = mdd;
+        end++;
+        mdd = mddnode_getright(n);
+    }
+    if (end - start < lddmc_wide_width) return 0;
+
+    index->used = end;
+    for (size_t pos = start; pos < end; pos += LDD_WIDE_STRIDE) {
+        lddmc_wide_slot_t *slot = lddmc_wide_slot(index, index->nodes[pos]);
+        slot->mdd = index->nodes[pos];
+        slot->pos = pos;
+        slot->end = end;
+    }
+    return 1;
+}
+
+/**
+ * Search the level starting at node <mdd> for the first node with a value of at least <value>,
+ * using the index. Returns lddmc_false if there is no such node.
+ */
+static MDD
+lddmc_wide_skip(MDD mdd, uint32_t value)
+{
+    lddmc_wide_t index = lddmc_wide_get();
+    for (int added = 0; index != NULL; added = 1) {
+        MDD m = mdd;
+        for (int i=0; i<LDD_WIDE_STRIDE && m != lddmc_false; i++) {
+            lddmc_wide_slot_t *slot = lddmc_wide_slot(index, m);
+            if (slot->mdd == m) {
+                // binary search for the first value >= value
+                size_t lo = slot->pos, hi = slot->end;
+                while (lo < hi) {
+                    size_t mid = (lo + hi) / 2;
+                    if (index->values[mid] < value) lo = mid + 1;
+                    else hi = mid;
+                }
+                return lo == slot->end ? lddmc_false : index->nodes[lo];
+            }
+            mddnode_t n = LDD_GETNODE(m);
+            if (mddnode_getvalue(n) >= value) return m;
+            m = mddnode_getright(n);
+        }
+        if (m == lddmc_false) return lddmc_false;
+        if (added || !lddmc_wide_add(index, mdd)) break;
+    }
+
+    // not a wide level (or not a worker): walk the level
+    for (;;) {
+        mddnode_t n = LDD_GETNODE(mdd);
+        if (mddnode_getvalue(n) >= value) return mdd;
+        mdd = mddnode_getright(n);
+        if (mdd == lddmc_false) return lddmc_false;
+    }
+}
+
+/**
+ * Search the level starting at (non-copy) node <mdd> for the first node with a value of at least <value>.
+ * Returns lddmc_false if there is no such node.
+ */
+static inline MDD
+lddmc_skip(MDD mdd, uint32_t value)
+{
+    for (int i=0; i<LDD_WIDE_STRIDE; i++) {
+        mddnode_t n = LDD_GETNODE(mdd);
+        if (mddnode_getvalue(n) >= value) return mdd;
+        mdd = mddnode_getright(n);
+        if (mdd == lddmc_false) return lddmc_false;
+    }
+    if (lddmc_wide_width != 0) return lddmc_wide_skip(mdd, value);
+    for (;;) {
+        mddnode_t n = LDD_GETNODE(mdd);
+        if (mddnode_getvalue(n) >= value) return mdd;
+        mdd = mddnode_getright(n);
+        if (mdd == lddmc_false) return lddmc_false;
+    }
+}
+
 /**
  * Primitives
  */
@@ -429,16 +615,15 @@ lddmc_getright(MDD mdd)
 MDD
 lddmc_follow(MDD mdd, uint32_t value)
 {
-    for (;;) {
-        if (mdd <= lddmc_true) return mdd;
-        const mddnode_t n = LDD_GETNODE(mdd);
-        if (!mddnode_getcopy(n)) {
-            const uint32_t v = mddnode_getvalue(n);
-            if (v == value) return mddnode_getdown(n);
-            if (v > value) return lddmc_false;
-        }
-        mdd = mddnode_getright(n);
+    if (mdd <= lddmc_true) return mdd;
+    if (mddnode_getcopy(LDD_GETNODE(mdd))) {
+        mdd = mddnode_getright(LDD_GETNODE(mdd));
+        if (mdd == lddmc_false) return lddmc_false;
     }
+    mdd = lddmc_skip(mdd, value);
+    if (mdd == lddmc_false) return lddmc_false;
+    const mddnode_t n = LDD_GETNODE(mdd);
+    return mddnode_getvalue(n) == value ? mddnode_getdown(n) : lddmc_false;
 }
 
 int
@@ -472,12 +657,12 @@ match_ldds(MDD *one, MDD *two)
     uint32_t v1 = mddnode_getvalue(n1), v2 = mddnode_getvalue(n2);
     while (v1 != v2) {
         if (v1 < v2) {
-            m1 = mddnode_getright(n1);
+            m1 = lddmc_skip(m1, v2);
             if (m1 == lddmc_false) return 0;
             n1 = LDD_GETNODE(m1);
             v1 = mddnode_getvalue(n1);
         } else if (v1 > v2) {
-            m2 = mddnode_getright(n2);
+            m2 = lddmc_skip(m2, v1);
             if (m2 == lddmc_false) return 0;
             n2 = LDD_GETNODE(m2);
             v2 = mddnode_getvalue(n2);
@@ -488,7 +673,48 @@ match_ldds(MDD *one, MDD *two)
     return 1;
 }
 
-TASK_IMPL_2(MDD, lddmc_union, MDD, a, MDD, b)
+/**
+ * Caching policies (see lddmc_set_cache_policy).
+ * The operations with a policy pass the position of every subproblem to their recursive calls:
+ * the number of down edges followed from the top, times 2, plus 1 if the last edge followed
+ * was a right edge (i.e., the subproblem is not the first of its level).
+ */
+#define LDD_POS_DOWN(pos) ((((pos) >> 1) + 1) << 1)
+#define LDD_POS_RIGHT(pos) ((pos) | 1)
+
+static struct {
+    lddmc_cache_policy_t policy;
+    uint32_t k;
+} lddmc_cache_policies[LDDMC_CACHE_OPS];
+
+void
+lddmc_set_cache_policy(lddmc_cache_op_t op, lddmc_cache_policy_t policy, uint32_t k)
+{
+    assert(op < LDDMC_CACHE_OPS);
+    lddmc_cache_policies[op].policy = policy;
+    lddmc_cache_policies[op].k = k == 0 ? 1 : k;
+}
+
+static inline int
+lddmc_cachenow_pos(lddmc_cache_op_t op, uint64_t opid, MDD a, MDD b, uint32_t pos)
+{
+    switch (lddmc_cache_policies[op].policy) {
+    case LDDMC_CACHE_DOWN:
+        if (pos & 1) return 0;
+        break;
+    case LDDMC_CACHE_EVERY:
+        if ((pos >> 1) % lddmc_cache_policies[op].k != 0) return 0;
+        break;
+    case LDDMC_CACHE_TOP:
+        if ((pos >> 1) >= lddmc_cache_policies[op].k) return 0;
+        break;
+    default:
+        break;
+    }
+    return cache_granularity_now(opid, 0, a, b);
+}
+
+TASK_3(MDD, lddmc_union_rec, MDD, a, MDD, b, uint32_t, pos)
 {
     /* Terminal cases */
     if (a == b) return a;
@@ -506,7 +732,8 @@ TASK_IMPL_2(MDD, lddmc_union, MDD, a, MDD, b)
 
     /* Access cache */
     MDD result;
-    if (cache_get3(CACHE_MDD_UNION, a, b, 0, &result)) {
+    const int cachenow = lddmc_cachenow_pos(LDDMC_UNION, CACHE_MDD_UNION, a, b, pos);
+    if (cachenow && cache_get3_level(CACHE_MDD_UNION, 0, a, b, 0, &result)) {
         sylvan_stats_count(LDD_UNION_CACHED);
         return result;
     }
@@ -522,40 +749,45 @@ TASK_IMPL_2(MDD, lddmc_union, MDD, a, MDD, b)
 
     /* Perform recursive calculation */
     if (na_copy && nb_copy) {
-        lddmc_refs_spawn(SPAWN(lddmc_union, mddnode_getdown(na), mddnode_getdown(nb)));
-        MDD right = CALL(lddmc_union, mddnode_getright(na), mddnode_getright(nb));
+        lddmc_refs_spawn(SPAWN(lddmc_union_rec, mddnode_getdown(na), mddnode_getdown(nb), LDD_POS_DOWN(pos)));
+        MDD right = CALL(lddmc_union_rec, mddnode_getright(na), mddnode_getright(nb), LDD_POS_RIGHT(pos));
         lddmc_refs_push(right);
-        MDD down = lddmc_refs_sync(SYNC(lddmc_union));
+        MDD down = lddmc_refs_sync(SYNC(lddmc_union_rec));
         lddmc_refs_pop(1);
         result = lddmc_make_copynode(down, right);
     } else if (na_copy) {
-        MDD right = CALL(lddmc_union, mddnode_getright(na), b);
+        MDD right = CALL(lddmc_union_rec, mddnode_getright(na), b, LDD_POS_RIGHT(pos));
         result = lddmc_make_copynode(mddnode_getdown(na), right);
     } else if (nb_copy) {
-        MDD right = CALL(lddmc_union, a, mddnode_getright(nb));
+        MDD right = CALL(lddmc_union_rec, a, mddnode_getright(nb), LDD_POS_RIGHT(pos));
         result = lddmc_make_copynode(mddnode_getdown(nb), right);
     } else if (na_value < nb_value) {
-        MDD right = CALL(lddmc_union, mddnode_getright(na), b);
+        MDD right = CALL(lddmc_union_rec, mddnode_getright(na), b, LDD_POS_RIGHT(pos));
         result = lddmc_makenode(na_value, mddnode_getdown(na), right);
     } else if (na_value == nb_value) {
-        lddmc_refs_spawn(SPAWN(lddmc_union, mddnode_getdown(na), mddnode_getdown(nb)));
-        MDD right = CALL(lddmc_union, mddnode_getright(na), mddnode_getright(nb));
+        lddmc_refs_spawn(SPAWN(lddmc_union_rec, mddnode_getdown(na), mddnode_getdown(nb), LDD_POS_DOWN(pos)));
+        MDD right = CALL(lddmc_union_rec, mddnode_getright(na), mddnode_getright(nb), LDD_POS_RIGHT(pos));
         lddmc_refs_push(right);
-        MDD down = lddmc_refs_sync(SYNC(lddmc_union));
+        MDD down = lddmc_refs_sync(SYNC(lddmc_union_rec));
         lddmc_refs_pop(1);
         result = lddmc_makenode(na_value, down, right);
     } else /* na_value > nb_value */ {
-        MDD right = CALL(lddmc_union, a, mddnode_getright(nb));
+        MDD right = CALL(lddmc_union_rec, a, mddnode_getright(nb), LDD_POS_RIGHT(pos));
         result = lddmc_makenode(nb_value, mddnode_getdown(nb), right);
     }
 
     /* Write to cache */
-    if (cache_put3(CACHE_MDD_UNION, a, b, 0, result)) sylvan_stats_count(LDD_UNION_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_UNION, a, b, 0, result)) sylvan_stats_count(LDD_UNION_CACHEDPUT);
 
     return result;
 }
 
-TASK_IMPL_2(MDD, lddmc_minus, MDD, a, MDD, b)
+TASK_IMPL_2(MDD, lddmc_union, MDD, a, MDD, b)
+{
+    return CALL(lddmc_union_rec, a, b, 0);
+}
+
+TASK_3(MDD, lddmc_minus_rec, MDD, a, MDD, b, uint32_t, pos)
 {
     /* Terminal cases */
     if (a == b) return lddmc_false;
@@ -571,7 +803,8 @@ TASK_IMPL_2(MDD, lddmc_minus, MDD, a, MDD, b)
 
     /* Access cache */
     MDD result;
-    if (cache_get3(CACHE_MDD_MINUS, a, b, 0, &result)) {
+    const int cachenow = lddmc_cachenow_pos(LDDMC_MINUS, CACHE_MDD_MINUS, a, b, pos);
+    if (cachenow && cache_get3_level(CACHE_MDD_MINUS, 0, a, b, 0, &result)) {
         sylvan_stats_count(LDD_MINUS_CACHED);
         return result;
     }
@@ -584,25 +817,30 @@ TASK_IMPL_2(MDD, lddmc_minus, MDD, a, MDD, b)
 
     /* Perform recursive calculation */
     if (na_value < nb_value) {
-        MDD right = CALL(lddmc_minus, mddnode_getright(na), b);
+        MDD right = CALL(lddmc_minus_rec, mddnode_getright(na), b, LDD_POS_RIGHT(pos));
         result = lddmc_makenode(na_value, mddnode_getdown(na), right);
     } else if (na_value == nb_value) {
-        lddmc_refs_spawn(SPAWN(lddmc_minus, mddnode_getright(na), mddnode_getright(nb)));
-        MDD down = CALL(lddmc_minus, mddnode_getdown(na), mddnode_getdown(nb));
+        lddmc_refs_spawn(SPAWN(lddmc_minus_rec, mddnode_getright(na), mddnode_getright(nb), LDD_POS_RIGHT(pos)));
+        MDD down = CALL(lddmc_minus_rec, mddnode_getdown(na), mddnode_getdown(nb), LDD_POS_DOWN(pos));
         lddmc_refs_push(down);
-        MDD right = lddmc_refs_sync(SYNC(lddmc_minus));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_minus_rec));
         lddmc_refs_pop(1);
         result = lddmc_makenode(na_value, down, right);
     } else /* na_value > nb_value */ {
-        result = CALL(lddmc_minus, a, mddnode_getright(nb));
+        result = CALL(lddmc_minus_rec, a, mddnode_getright(nb), LDD_POS_RIGHT(pos));
     }
 
     /* Write to cache */
-    if (cache_put3(CACHE_MDD_MINUS, a, b, 0, result)) sylvan_stats_count(LDD_MINUS_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_MINUS, a, b, 0, result)) sylvan_stats_count(LDD_MINUS_CACHEDPUT);
 
     return result;
 }
 
+TASK_IMPL_2(MDD, lddmc_minus, MDD, a, MDD, b)
+{
+    return CALL(lddmc_minus_rec, a, b, 0);
+}
+
 /* result: a plus b; res2: b minus a */
 TASK_IMPL_3(MDD, lddmc_zip, MDD, a, MDD, b, MDD*, res2)
 {
@@ -707,7 +945,8 @@ TASK_IMPL_2(MDD, lddmc_intersect, MDD, a, MDD, b)
 
     /* Access cache */
     MDD result;
-    if (cache_get3(CACHE_MDD_INTERSECT, a, b, 0, &result)) {
+    const int cachenow = cache_granularity_now(CACHE_MDD_INTERSECT, 0, a, b);
+    if (cachenow && cache_get3_level(CACHE_MDD_INTERSECT, 0, a, b, 0, &result)) {
         sylvan_stats_count(LDD_INTERSECT_CACHED);
         return result;
     }
@@ -721,7 +960,7 @@ TASK_IMPL_2(MDD, lddmc_intersect, MDD, a, MDD, b)
     result = lddmc_makenode(na_value, down, right);
 
     /* Write to cache */
-    if (cache_put3(CACHE_MDD_INTERSECT, a, b, 0, result)) sylvan_stats_count(LDD_INTERSECT_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_INTERSECT, a, b, 0, result)) sylvan_stats_count(LDD_INTERSECT_CACHEDPUT);
 
     return result;
 }
@@ -751,7 +990,8 @@ TASK_IMPL_3(MDD, lddmc_match, MDD, a, MDD, b, MDD, proj)
 
     /* Access cache */
     MDD result;
-    if (cache_get3(CACHE_MDD_MATCH, a, b, proj, &result)) {
+    const int cachenow = cache_granularity_now(CACHE_MDD_MATCH, 0, a, b);
+    if (cachenow && cache_get3_level(CACHE_MDD_MATCH, 0, a, b, proj, &result)) {
         sylvan_stats_count(LDD_MATCH_CACHED);
         return result;
     }
@@ -773,18 +1013,20 @@ TASK_IMPL_3(MDD, lddmc_match, MDD, a, MDD, b, MDD, proj)
     result = lddmc_makenode(mddnode_getvalue(na), down, right);
 
     /* Write to cache */
-    if (cache_put3(CACHE_MDD_MATCH, a, b, proj, result)) sylvan_stats_count(LDD_MATCH_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_MATCH, a, b, proj, result)) sylvan_stats_count(LDD_MATCH_CACHEDPUT);
 
     return result;
 }
 
-TASK_4(MDD, lddmc_relprod_help, uint32_t, val, MDD, set, MDD, rel, MDD, proj)
+TASK_DECL_4(MDD, lddmc_relprod_rec, MDD, MDD, MDD, uint32_t);
+
+TASK_5(MDD, lddmc_relprod_help, uint32_t, val, MDD, set, MDD, rel, MDD, proj, uint32_t, pos)
 {
-    return lddmc_makenode(val, CALL(lddmc_relprod, set, rel, proj), lddmc_false);
+    return lddmc_makenode(val, CALL(lddmc_relprod_rec, set, rel, proj, pos), lddmc_false);
 }
 
 // meta: -1 (end; rest not in rel), 0 (not in rel), 1 (read), 2 (write), 3 (only-read), 4 (only-write), 5 (action label)
-TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
+TASK_IMPL_4(MDD, lddmc_relprod_rec, MDD, set, MDD, rel, MDD, meta, uint32_t, pos)
 {
     // for an empty set of source states, or an empty transition relation, return the empty set
     if (set == lddmc_false) return lddmc_false;
@@ -817,7 +1059,8 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
     /* Access cache */
     MDD result;
     MDD _set=set, _rel=rel;
-    if (cache_get3(CACHE_MDD_RELPROD, set, rel, meta, &result)) {
+    const int cachenow = lddmc_cachenow_pos(LDDMC_RELPROD, CACHE_MDD_RELPROD, set, rel, pos);
+    if (cachenow && cache_get3_level(CACHE_MDD_RELPROD, 0, set, rel, meta, &result)) {
         sylvan_stats_count(LDD_RELPROD_CACHED);
         return result;
     }
@@ -827,23 +1070,23 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
 
     /* Recursive operations */
     if (m_val == 0) { // not in rel
-        lddmc_refs_spawn(SPAWN(lddmc_relprod, mddnode_getright(n_set), rel, meta));
-        MDD down = CALL(lddmc_relprod, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta));
+        lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, mddnode_getright(n_set), rel, meta, LDD_POS_RIGHT(pos)));
+        MDD down = CALL(lddmc_relprod_rec, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
         lddmc_refs_push(down);
-        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
         lddmc_refs_pop(1);
         result = lddmc_makenode(mddnode_getvalue(n_set), down, right);
     } else if (m_val == 5) { // action label
-        lddmc_refs_spawn(SPAWN(lddmc_relprod, set, mddnode_getright(n_rel), meta));
-        MDD down = CALL(lddmc_relprod, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta));
+        lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, set, mddnode_getright(n_rel), meta, LDD_POS_RIGHT(pos)));
+        MDD down = CALL(lddmc_relprod_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
         lddmc_refs_push(down);
-        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
         lddmc_refs_push(right);
         result = CALL(lddmc_union, down, right);
         lddmc_refs_pop(2);
     } else if (m_val == 1) { // read
         // read layer: if not copy, then set&rel are already matched
-        lddmc_refs_spawn(SPAWN(lddmc_relprod, set, mddnode_getright(n_rel), meta)); // spawn next read in list
+        lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, set, mddnode_getright(n_rel), meta, LDD_POS_RIGHT(pos))); // spawn next read in list
 
         // for this read, either it is copy ('for all') or it is normal match
         if (mddnode_getcopy(n_rel)) {
@@ -851,7 +1094,7 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
             int count = 0;
             for (;;) {
                 // stay same level of set (for write)
-                lddmc_refs_spawn(SPAWN(lddmc_relprod, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta)));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos)));
                 count++;
                 set = mddnode_getright(n_set);
                 if (set == lddmc_false) break;
@@ -862,18 +1105,18 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
             result = lddmc_false;
             while (count--) {
                 lddmc_refs_push(result);
-                MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod));
+                MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
                 lddmc_refs_push(result2);
                 result = CALL(lddmc_union, result, result2);
                 lddmc_refs_pop(2);
             }
         } else {
             // stay same level of set (for write)
-            result = CALL(lddmc_relprod, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta));
+            result = CALL(lddmc_relprod_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
         }
 
         lddmc_refs_push(result);
-        MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod)); // sync next read in list
+        MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_rec)); // sync next read in list
         lddmc_refs_push(result2);
         result = CALL(lddmc_union, result, result2);
         lddmc_refs_pop(2);
@@ -881,12 +1124,12 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
         if (mddnode_getcopy(n_rel)) {
             // copy on read ('for any value')
             // result = union(result_with_copy, result_without_copy)
-            lddmc_refs_spawn(SPAWN(lddmc_relprod, set, mddnode_getright(n_rel), meta)); // spawn without_copy
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, set, mddnode_getright(n_rel), meta, LDD_POS_RIGHT(pos))); // spawn without_copy
 
             // spawn for every value to copy (set)
             int count = 0;
             for (;;) {
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_help, mddnode_getvalue(n_set), mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta)));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_help, mddnode_getvalue(n_set), mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos)));
                 count++;
                 set = mddnode_getright(n_set);
                 if (set == lddmc_false) break;
@@ -905,16 +1148,16 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
 
             // add result from without_copy
             lddmc_refs_push(result);
-            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod));
+            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
             lddmc_refs_push(result2);
             result = CALL(lddmc_union, result, result2);
             lddmc_refs_pop(2);
         } else {
             // only-read, without copy
-            lddmc_refs_spawn(SPAWN(lddmc_relprod, mddnode_getright(n_set), mddnode_getright(n_rel), meta));
-            MDD down = CALL(lddmc_relprod, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta));
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, mddnode_getright(n_set), mddnode_getright(n_rel), meta, LDD_POS_RIGHT(pos)));
+            MDD down = CALL(lddmc_relprod_rec, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
             lddmc_refs_push(down);
-            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod));
+            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
             lddmc_refs_pop(1);
             result = lddmc_makenode(mddnode_getvalue(n_set), down, right);
         }
@@ -923,7 +1166,7 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
         if (m_val == 4) {
             // only-write, so we need to include 'for all variables'
             // the reason is that we did not have a read phase, so we need to 'insert' a read phase here
-            lddmc_refs_spawn(SPAWN(lddmc_relprod, mddnode_getright(n_set), rel, meta)); // next in set
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_rec, mddnode_getright(n_set), rel, meta, LDD_POS_RIGHT(pos))); // next in set
         }
 
         // if we're here and we are only-write, then we read the current value
@@ -934,7 +1177,7 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
             uint32_t value;
             if (mddnode_getcopy(n_rel)) value = mddnode_getvalue(n_set);
             else value = mddnode_getvalue(n_rel);
-            lddmc_refs_spawn(SPAWN(lddmc_relprod_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta)));
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos)));
             count++;
             rel = mddnode_getright(n_rel);
             if (rel == lddmc_false) break;
@@ -954,7 +1197,7 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
         if (m_val == 4) {
             // sync+union with other variables
             lddmc_refs_push(result);
-            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod));
+            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_rec));
             lddmc_refs_push(result2);
             result = CALL(lddmc_union, result, result2);
             lddmc_refs_pop(2);
@@ -962,22 +1205,29 @@ TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
     }
 
     /* Write to cache */
-    if (cache_put3(CACHE_MDD_RELPROD, _set, _rel, meta, result)) sylvan_stats_count(LDD_RELPROD_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_RELPROD, _set, _rel, meta, result)) sylvan_stats_count(LDD_RELPROD_CACHEDPUT);
 
     return result;
 }
 
-TASK_5(MDD, lddmc_relprod_union_help, uint32_t, val, MDD, set, MDD, rel, MDD, proj, MDD, un)
+TASK_IMPL_3(MDD, lddmc_relprod, MDD, set, MDD, rel, MDD, meta)
+{
+    return CALL(lddmc_relprod_rec, set, rel, meta, 0);
+}
+
+TASK_DECL_5(MDD, lddmc_relprod_union_rec, MDD, MDD, MDD, MDD, uint32_t);
+
+TASK_6(MDD, lddmc_relprod_union_help, uint32_t, val, MDD, set, MDD, rel, MDD, proj, MDD, un, uint32_t, pos)
 {
-    return lddmc_makenode(val, CALL(lddmc_relprod_union, set, rel, proj, un), lddmc_false);
+    return lddmc_makenode(val, CALL(lddmc_relprod_union_rec, set, rel, proj, un, pos), lddmc_false);
 }
 
 // meta: -1 (end; rest not in rel), 0 (not in rel), 1 (read), 2 (write), 3 (only-read), 4 (only-write)
-TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
+TASK_IMPL_5(MDD, lddmc_relprod_union_rec, MDD, set, MDD, rel, MDD, meta, MDD, un, uint32_t, pos)
 {
     if (set == lddmc_false) return un;
     if (rel == lddmc_false) return un;
-    if (un == lddmc_false) return CALL(lddmc_relprod, set, rel, meta);
+    if (un == lddmc_false) return CALL(lddmc_relprod_rec, set, rel, meta, pos);
     if (meta == lddmc_true) return CALL(lddmc_union, set, un);
 
     mddnode_t n_meta = LDD_GETNODE(meta);
@@ -1004,7 +1254,8 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
     /* Access cache */
     MDD result;
     MDD _set=set, _rel=rel, _un=un;
-    if (cache_get4(CACHE_MDD_RELPROD, set, rel, meta, un, &result)) {
+    const int cachenow = lddmc_cachenow_pos(LDDMC_RELPROD_UNION, CACHE_MDD_RELPROD, set, rel, pos);
+    if (cachenow && cache_get4(CACHE_MDD_RELPROD, set, rel, meta, un, &result)) {
         sylvan_stats_count(LDD_RELPROD_UNION_CACHED);
         return result;
     }
@@ -1021,7 +1272,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
         uint32_t set_value = mddnode_getvalue(n_set);
         uint32_t un_value = mddnode_getvalue(n_un);
         if (un_value < set_value) {
-            MDD right = CALL(lddmc_relprod_union, set, rel, meta, mddnode_getright(n_un));
+            MDD right = CALL(lddmc_relprod_union_rec, set, rel, meta, mddnode_getright(n_un), LDD_POS_RIGHT(pos));
             if (right == mddnode_getright(n_un)) return un;
             else return lddmc_makenode(mddnode_getvalue(n_un), mddnode_getdown(n_un), right);
         }
@@ -1032,7 +1283,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
             uint32_t rel_value = mddnode_getvalue(n_rel);
             uint32_t un_value = mddnode_getvalue(n_un);
             if (un_value < rel_value) {
-                MDD right = CALL(lddmc_relprod_union, set, rel, meta, mddnode_getright(n_un));
+                MDD right = CALL(lddmc_relprod_union_rec, set, rel, meta, mddnode_getright(n_un), LDD_POS_RIGHT(pos));
                 if (right == mddnode_getright(n_un)) return un;
                 else return lddmc_makenode(mddnode_getvalue(n_un), mddnode_getdown(n_un), right);
             }
@@ -1046,34 +1297,34 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
         uint32_t un_value = mddnode_getvalue(n_un);
         // set_value > un_value already checked above
         if (set_value < un_value) {
-            lddmc_refs_spawn(SPAWN(lddmc_relprod_union, mddnode_getright(n_set), rel, meta, un));
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, mddnode_getright(n_set), rel, meta, un, LDD_POS_RIGHT(pos)));
             // going down, we don't need _union, since un does not contain this subtree
-            MDD down = CALL(lddmc_relprod, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta));
+            MDD down = CALL(lddmc_relprod_rec, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
             lddmc_refs_push(down);
-            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
             lddmc_refs_pop(1);
             result = lddmc_makenode(mddnode_getvalue(n_set), down, right);
         } else /* set_value == un_value */ {
             assert(set_value == un_value);
-            lddmc_refs_spawn(SPAWN(lddmc_relprod_union, mddnode_getright(n_set), rel, meta, mddnode_getright(n_un)));
-            MDD down = CALL(lddmc_relprod_union, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta), mddnode_getdown(n_un));
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, mddnode_getright(n_set), rel, meta, mddnode_getright(n_un), LDD_POS_RIGHT(pos)));
+            MDD down = CALL(lddmc_relprod_union_rec, mddnode_getdown(n_set), rel, mddnode_getdown(n_meta), mddnode_getdown(n_un), LDD_POS_DOWN(pos));
             lddmc_refs_push(down);
-            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+            MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
             lddmc_refs_pop(1);
             if (right == mddnode_getright(n_un) && down == mddnode_getdown(n_un)) result = un;
             else result = lddmc_makenode(mddnode_getvalue(n_set), down, right);
         }
     } else if (m_val == 5) {
-        lddmc_refs_spawn(SPAWN(lddmc_relprod_union, set, mddnode_getright(n_rel), meta, un));
-        MDD down = CALL(lddmc_relprod_union, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un);
+        lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, set, mddnode_getright(n_rel), meta, un, LDD_POS_RIGHT(pos)));
+        MDD down = CALL(lddmc_relprod_union_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un, LDD_POS_DOWN(pos));
         lddmc_refs_push(down);
-        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
         lddmc_refs_push(right);
         result = CALL(lddmc_union, down, right);
         lddmc_refs_pop(2);
     } else if (m_val == 1) {
         // First we also spawn for the next read value, and merge results after
-        lddmc_refs_spawn(SPAWN(lddmc_relprod_union, set, mddnode_getright(n_rel), meta, un));
+        lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, set, mddnode_getright(n_rel), meta, un, LDD_POS_RIGHT(pos)));
 
         // for this read, either it is a copy read ('for all') or it is normal match
         if (mddnode_getcopy(n_rel)) {
@@ -1081,7 +1332,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
             int count = 0;
             for (;;) {
                 // stay same level of set and un (for write level, this was no only-read)
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un, LDD_POS_DOWN(pos)));
                 count++;
                 set = mddnode_getright(n_set);
                 if (set == lddmc_false) break;
@@ -1092,7 +1343,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
             result = lddmc_false;
             while (count--) {
                 lddmc_refs_push(result);
-                MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+                MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
                 lddmc_refs_push(result2);
                 result = CALL(lddmc_union, result, result2);
                 lddmc_refs_pop(2);
@@ -1100,12 +1351,12 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
         } else {
             // read level: if not copy read, then set and rel are already matched
             // stay same level of set and un (for write level, this was no only-read)
-            result = CALL(lddmc_relprod_union, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un);
+            result = CALL(lddmc_relprod_union_rec, set, mddnode_getdown(n_rel), mddnode_getdown(n_meta), un, LDD_POS_DOWN(pos));
         }
 
         // now merge the result with the result from the next read value
         lddmc_refs_push(result);
-        MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+        MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
         lddmc_refs_push(result2);
         result = CALL(lddmc_union, result, result2);
         lddmc_refs_pop(2);
@@ -1114,7 +1365,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
         if (mddnode_getcopy(n_rel)) {
             // copy on read ('for any value')
             // result = union(result_with_copy, result_without_copy)
-            lddmc_refs_spawn(SPAWN(lddmc_relprod_union, set, mddnode_getright(n_rel), meta, un)); // spawn without_copy
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, set, mddnode_getright(n_rel), meta, un, LDD_POS_RIGHT(pos))); // spawn without_copy
 
             // spawn for every value to copy (iterate over set)
             int count = 0;
@@ -1125,19 +1376,19 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
                 if (un_value < set_value) {
                     // this is a bit tricky because the SYNC assumes we SPAWN a relprod_union_help
                     // the result of this will simply be "un_value, mddnode_getdown(n_un), false" which is intended
-                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, un_value, lddmc_false, lddmc_false, lddmc_true, mddnode_getdown(n_un)));
+                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, un_value, lddmc_false, lddmc_false, lddmc_true, mddnode_getdown(n_un), LDD_POS_DOWN(pos)));
                     count++;
                     un = mddnode_getright(n_un);
                     if (un == lddmc_false) {
                         // if un is now false, then we have a normal relprod for the rest...
-                        result = CALL(lddmc_relprod, set, rel, meta);
+                        result = CALL(lddmc_relprod_rec, set, rel, meta, pos);
                         break;
                     }
                     n_un = LDD_GETNODE(un);
                 } else if (un_value > set_value) {
                     // this is a bit tricky because the SYNC assumes we SPAWN a relprod_union_help
                     // the result of this will simply be a normal relprod
-                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, set_value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), lddmc_false));
+                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, set_value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), lddmc_false, LDD_POS_DOWN(pos)));
                     count++;
                     set = mddnode_getright(n_set);
                     if (set == lddmc_false) {
@@ -1147,7 +1398,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
                     }
                     n_set = LDD_GETNODE(set);
                 } else /* un_value == set_value */ {
-                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, set_value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un)));
+                    lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, set_value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un), LDD_POS_DOWN(pos)));
                     count++;
                     set = mddnode_getright(n_set);
                     un = mddnode_getright(n_un);
@@ -1157,7 +1408,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
                         break;
                     } else if (un == lddmc_false) {
                         // if un is now false, then we have a normal relprod for the rest...
-                        result = CALL(lddmc_relprod, set, rel, meta);
+                        result = CALL(lddmc_relprod_rec, set, rel, meta, pos);
                         break;
                     }
                     n_set = LDD_GETNODE(set);
@@ -1176,7 +1427,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
 
             // add result from without_copy
             lddmc_refs_push(result);
-            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
             lddmc_refs_push(result2);
             result = CALL(lddmc_union, result, result2);
             lddmc_refs_pop(2);
@@ -1187,18 +1438,18 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
 
             // we already checked un_value < set_value
             if (un_value > set_value) {
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union, mddnode_getright(n_set), mddnode_getright(n_rel), meta, un));
-                MDD down = CALL(lddmc_relprod, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, mddnode_getright(n_set), mddnode_getright(n_rel), meta, un, LDD_POS_RIGHT(pos)));
+                MDD down = CALL(lddmc_relprod_rec, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), LDD_POS_DOWN(pos));
                 lddmc_refs_push(down);
-                MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+                MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
                 lddmc_refs_pop(1);
                 result = lddmc_makenode(set_value, down, right);
             } else /* un_value == set_value */ {
                 assert(un_value == set_value);
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union, mddnode_getright(n_set), mddnode_getright(n_rel), meta, mddnode_getright(n_un)));
-                MDD down = CALL(lddmc_relprod_union, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, mddnode_getright(n_set), mddnode_getright(n_rel), meta, mddnode_getright(n_un), LDD_POS_RIGHT(pos)));
+                MDD down = CALL(lddmc_relprod_union_rec, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un), LDD_POS_DOWN(pos));
                 lddmc_refs_push(down);
-                MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+                MDD right = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
                 lddmc_refs_pop(1);
                 result = lddmc_makenode(set_value, down, right);
             }
@@ -1206,7 +1457,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
     } else if (m_val == 2 || m_val == 4) { // write, only-write
         if (m_val == 4) {
             // only-write, so we need to include 'for all variables' because we did not 'read'
-            lddmc_refs_spawn(SPAWN(lddmc_relprod_union, mddnode_getright(n_set), rel, meta, un)); // next in set
+            lddmc_refs_spawn(SPAWN(lddmc_relprod_union_rec, mddnode_getright(n_set), rel, meta, un, LDD_POS_RIGHT(pos))); // next in set
         }
 
         // spawn for every value to write (rel)
@@ -1219,16 +1470,16 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
             uint32_t un_value = mddnode_getvalue(n_un);
             if (un_value < value) {
                 // the result of this will simply be "un_value, mddnode_getdown(n_un), false" which is intended
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, un_value, lddmc_false, lddmc_false, lddmc_true, mddnode_getdown(n_un)));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, un_value, lddmc_false, lddmc_false, lddmc_true, mddnode_getdown(n_un), LDD_POS_DOWN(pos)));
                 count++;
                 un = mddnode_getright(n_un);
                 if (un == lddmc_false) {
-                    result = CALL(lddmc_relprod, set, rel, meta);
+                    result = CALL(lddmc_relprod_rec, set, rel, meta, pos);
                     break;
                 }
                 n_un = LDD_GETNODE(un);
             } else if (un_value > value) {
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), lddmc_false));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), lddmc_false, LDD_POS_DOWN(pos)));
                 count++;
                 rel = mddnode_getright(n_rel);
                 if (rel == lddmc_false) {
@@ -1237,7 +1488,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
                 }
                 n_rel = LDD_GETNODE(rel);
             } else /* un_value == value */ {
-                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un)));
+                lddmc_refs_spawn(SPAWN(lddmc_relprod_union_help, value, mddnode_getdown(n_set), mddnode_getdown(n_rel), mddnode_getdown(n_meta), mddnode_getdown(n_un), LDD_POS_DOWN(pos)));
                 count++;
                 rel = mddnode_getright(n_rel);
                 un = mddnode_getright(n_un);
@@ -1245,7 +1496,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
                     result = un;
                     break;
                 } else if (un == lddmc_false) {
-                    result = CALL(lddmc_relprod, set, rel, meta);
+                    result = CALL(lddmc_relprod_rec, set, rel, meta, pos);
                     break;
                 }
                 n_rel = LDD_GETNODE(rel);
@@ -1265,7 +1516,7 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
         if (m_val == 4) {
             // sync+union with other variables
             lddmc_refs_push(result);
-            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union));
+            MDD result2 = lddmc_refs_sync(SYNC(lddmc_relprod_union_rec));
             lddmc_refs_push(result2);
             result = CALL(lddmc_union, result, result2);
             lddmc_refs_pop(2);
@@ -1273,11 +1524,16 @@ TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
     }
 
     /* Write to cache */
-    if (cache_put4(CACHE_MDD_RELPROD, _set, _rel, meta, _un, result)) sylvan_stats_count(LDD_RELPROD_UNION_CACHEDPUT);
+    if (cachenow && cache_put4(CACHE_MDD_RELPROD, _set, _rel, meta, _un, result)) sylvan_stats_count(LDD_RELPROD_UNION_CACHEDPUT);
 
     return result;
 }
 
+TASK_IMPL_4(MDD, lddmc_relprod_union, MDD, set, MDD, rel, MDD, meta, MDD, un)
+{
+    return CALL(lddmc_relprod_union_rec, set, rel, meta, un, 0);
+}
+
 TASK_5(MDD, lddmc_relprev_help, uint32_t, val, MDD, set, MDD, rel, MDD, proj, MDD, uni)
 {
     return lddmc_makenode(val, CALL(lddmc_relprev, set, rel, proj, uni), lddmc_false);
@@ -1537,6 +1793,137 @@ TASK_IMPL_4(MDD, lddmc_relprev, MDD, set, MDD, rel, MDD, meta, MDD, uni)
     return result;
 }
 
+/**
+ * Saturation. Every relation starts at the first variable that its meta does not skip (firstvar).
+ * The relations are sorted by firstvar, and relations with the same firstvar form one group.
+ */
+typedef struct lddmc_saturate_ctx {
+    const MDD *relations;
+    const MDD *topmetas;     // meta of each relation, without the skipped variables
+    const uint32_t *topvars; // firstvar of each relation
+    int count;
+    uint64_t id;             // identifier of the relations (from cache_key_id)
+} lddmc_saturate_ctx;
+
+TASK_4(MDD, lddmc_saturate_go, MDD, set, int, idx, uint32_t, depth, const lddmc_saturate_ctx*, ctx)
+{
+    /* Terminal cases */
+    if (set == lddmc_false) return lddmc_false;
+    if (idx == ctx->count) return set;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(LDD_SATURATE);
+
+    /* Access cache */
+    MDD result;
+    const MDD _set = set;
+    const uint64_t key = (ctx->id << 32) | (uint64_t)idx;
+    if (cache_get3(CACHE_MDD_SATURATE, _set, key, 0, &result)) {
+        sylvan_stats_count(LDD_SATURATE_CACHED);
+        return result;
+    }
+    lddmc_refs_pushptr(&_set);
+
+    const uint32_t var = ctx->topvars[idx];
+    if (depth == var) {
+        /* Count the number of relations in this group */
+        int count = 1;
+        while (idx+count < ctx->count && ctx->topvars[idx+count] == var) count++;
+
+        /*
+         * Compute the fixpoint of:
+         * - saturate with the next groups
+         * - apply every relation of this group once
+         */
+        MDD prev = lddmc_false;
+        lddmc_refs_pushptr(&set);
+        lddmc_refs_pushptr(&prev);
+        while (prev != set) {
+            prev = set;
+            set = CALL(lddmc_saturate_go, set, idx+count, depth, ctx);
+            for (int i=0; i<count; i++) {
+                set = CALL(lddmc_relprod_union, set, ctx->relations[idx+i], ctx->topmetas[idx+i], set);
+            }
+        }
+        lddmc_refs_popptr(2);
+        result = set;
+    } else if (set == lddmc_true) {
+        /* The remaining relations start below the last variable */
+        result = set;
+    } else {
+        /* Saturate all values of this level in parallel */
+        mddnode_t n_set = LDD_GETNODE(set);
+        lddmc_refs_spawn(SPAWN(lddmc_saturate_go, mddnode_getright(n_set), idx, depth, ctx));
+        MDD down = lddmc_refs_push(CALL(lddmc_saturate_go, mddnode_getdown(n_set), idx, depth+1, ctx));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_saturate_go));
+        lddmc_refs_pop(1);
+        result = lddmc_makenode(mddnode_getvalue(n_set), down, right);
+    }
+
+    if (cache_put3(CACHE_MDD_SATURATE, _set, key, 0, result)) sylvan_stats_count(LDD_SATURATE_CACHEDPUT);
+    lddmc_refs_popptr(1);
+    return result;
+}
+
+TASK_IMPL_4(MDD, lddmc_saturate, MDD, set, const MDD*, relations, const MDD*, metas, int, count)
+{
+    if (count <= 0 || set == lddmc_false) return set;
+
+    /* Compute firstvar and topmeta, skip relations that do not read or write any variable */
+    uint32_t *vars = (uint32_t*)malloc(sizeof(uint32_t[count]));
+    MDD *tops = (MDD*)malloc(sizeof(MDD[count]));
+    int *order = (int*)malloc(sizeof(int[count]));
+    int n = 0;
+    for (int i=0; i<count; i++) {
+        MDD meta = metas[i];
+        uint32_t v = 0;
+        while (meta != lddmc_true && lddmc_getvalue(meta) == 0) {
+            meta = lddmc_getdown(meta);
+            v++;
+        }
+        if (meta == lddmc_true || lddmc_getvalue(meta) == (uint32_t)-1) continue;
+        if (relations[i] == lddmc_false) continue;
+
+        /* Insert sorted on firstvar, then on the relation itself (insertion sort) */
+        int j = n++;
+        while (j > 0 && (vars[j-1] > v || (vars[j-1] == v && (relations[order[j-1]] > relations[i] ||
+                (relations[order[j-1]] == relations[i] && tops[j-1] > meta))))) {
+            vars[j] = vars[j-1];
+            tops[j] = tops[j-1];
+            order[j] = order[j-1];
+            j--;
+        }
+        vars[j] = v;
+        tops[j] = meta;
+        order[j] = i;
+    }
+
+    MDD *rels = (MDD*)malloc(sizeof(MDD[n > 0 ? n : 1]));
+    uint64_t *key = (uint64_t*)malloc(sizeof(uint64_t[n > 0 ? 2*n : 1]));
+    for (int i=0; i<n; i++) {
+        rels[i] = key[2*i] = relations[order[i]];
+        key[2*i+1] = tops[i];
+    }
+
+    lddmc_saturate_ctx ctx;
+    ctx.relations = rels;
+    ctx.topmetas = tops;
+    ctx.topvars = vars;
+    ctx.count = n;
+    ctx.id = n > 0 ? cache_key_id(key, 2*n) : 0;
+
+    MDD result = n > 0 ? CALL(lddmc_saturate_go, set, 0, 0, &ctx) : set;
+
+    free(key);
+    free(rels);
+    free(order);
+    free(tops);
+    free(vars);
+    return result;
+}
+
 // Same 'proj' as project. So: proj: -2 (end; quantify rest), -1 (end; keep rest), 0 (quantify), 1 (keep)
 TASK_IMPL_4(MDD, lddmc_join, MDD, a, MDD, b, MDD, a_proj, MDD, b_proj)
 {
@@ -1623,7 +2010,7 @@ TASK_IMPL_4(MDD, lddmc_join, MDD, a, MDD, b, MDD, a_proj, MDD, b_proj)
 }
 
 // so: proj: -2 (end; quantify rest), -1 (end; keep rest), 0 (quantify), 1 (keep)
-TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
+TASK_3(MDD, lddmc_project_rec, MDD, mdd, MDD, proj, uint32_t, pos)
 {
     if (mdd == lddmc_false) return lddmc_false; // projection of empty is empty
     if (mdd == lddmc_true) return lddmc_true; // projection of universe is universe...
@@ -1638,7 +2025,8 @@ TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
     sylvan_stats_count(LDD_PROJECT);
 
     MDD result;
-    if (cache_get3(CACHE_MDD_PROJECT, mdd, proj, 0, &result)) {
+    const int cachenow = lddmc_cachenow_pos(LDDMC_PROJECT, CACHE_MDD_PROJECT, mdd, proj, pos);
+    if (cachenow && cache_get3_level(CACHE_MDD_PROJECT, 0, mdd, proj, 0, &result)) {
         sylvan_stats_count(LDD_PROJECT_CACHED);
         return result;
     }
@@ -1646,10 +2034,10 @@ TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
     mddnode_t n = LDD_GETNODE(mdd);
 
     if (p_val == 1) { // keep
-        lddmc_refs_spawn(SPAWN(lddmc_project, mddnode_getright(n), proj));
-        MDD down = CALL(lddmc_project, mddnode_getdown(n), mddnode_getdown(p_node));
+        lddmc_refs_spawn(SPAWN(lddmc_project_rec, mddnode_getright(n), proj, LDD_POS_RIGHT(pos)));
+        MDD down = CALL(lddmc_project_rec, mddnode_getdown(n), mddnode_getdown(p_node), LDD_POS_DOWN(pos));
         lddmc_refs_push(down);
-        MDD right = lddmc_refs_sync(SYNC(lddmc_project));
+        MDD right = lddmc_refs_sync(SYNC(lddmc_project_rec));
         lddmc_refs_pop(1);
         result = lddmc_makenode(mddnode_getvalue(n), down, right);
     } else { // quantify
@@ -1659,7 +2047,7 @@ TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
             int count = 0;
             MDD p_down = mddnode_getdown(p_node), _mdd=mdd;
             while (1) {
-                lddmc_refs_spawn(SPAWN(lddmc_project, mddnode_getdown(n), p_down));
+                lddmc_refs_spawn(SPAWN(lddmc_project_rec, mddnode_getdown(n), p_down, LDD_POS_DOWN(pos)));
                 count++;
                 _mdd = mddnode_getright(n);
                 assert(_mdd != lddmc_true);
@@ -1669,7 +2057,7 @@ TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
             result = lddmc_false;
             while (count--) {
                 lddmc_refs_push(result);
-                MDD down = lddmc_refs_sync(SYNC(lddmc_project));
+                MDD down = lddmc_refs_sync(SYNC(lddmc_project_rec));
                 lddmc_refs_push(down);
                 result = CALL(lddmc_union, result, down);
                 lddmc_refs_pop(2);
@@ -1677,11 +2065,16 @@ TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
         }
     }
 
-    if (cache_put3(CACHE_MDD_PROJECT, mdd, proj, 0, result)) sylvan_stats_count(LDD_PROJECT_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_PROJECT, mdd, proj, 0, result)) sylvan_stats_count(LDD_PROJECT_CACHEDPUT);
 
     return result;
 }
 
+TASK_IMPL_2(MDD, lddmc_project, const MDD, mdd, const MDD, proj)
+{
+    return CALL(lddmc_project_rec, mdd, proj, 0);
+}
+
 // so: proj: -2 (end; quantify rest), -1 (end; keep rest), 0 (quantify), 1 (keep)
 TASK_IMPL_3(MDD, lddmc_project_minus, const MDD, mdd, const MDD, proj, MDD, avoid)
 {
@@ -1701,7 +2094,8 @@ TASK_IMPL_3(MDD, lddmc_project_minus, const MDD, mdd, const MDD, proj, MDD, avoi
     sylvan_stats_count(LDD_PROJECT_MINUS);
 
     MDD result;
-    if (cache_get3(CACHE_MDD_PROJECT, mdd, proj, avoid, &result)) {
+    const int cachenow = cache_granularity_now(CACHE_MDD_PROJECT, 0, mdd, proj);
+    if (cachenow && cache_get3_level(CACHE_MDD_PROJECT, 0, mdd, proj, avoid, &result)) {
         sylvan_stats_count(LDD_PROJECT_MINUS_CACHED);
         return result;
     }
@@ -1754,7 +2148,7 @@ TASK_IMPL_3(MDD, lddmc_project_minus, const MDD, mdd, const MDD, proj, MDD, avoi
         }
     }
 
-    if (cache_put3(CACHE_MDD_PROJECT, mdd, proj, avoid, result)) sylvan_stats_count(LDD_PROJECT_MINUS_CACHEDPUT);
+    if (cachenow && cache_put3(CACHE_MDD_PROJECT, mdd, proj, avoid, result)) sylvan_stats_count(LDD_PROJECT_MINUS_CACHEDPUT);
 
     return result;
 }
@@ -1873,115 +2267,713 @@ lddmc_cube_copy(uint32_t* values, int* copy, size_t count)
 }
 
 /**
- * Count number of nodes for each level
+ * Bottom-up construction from sorted vectors.
+ * The vectors <lo> to <hi> agree on the first <depth> values, so they are sorted on value <depth>.
+ * The groups of vectors with the same value are processed from right to left, in batches of
+ * LDD_FROM_SORTED_BATCH groups whose subtrees are created in parallel.
  */
 
-static void
-lddmc_nodecount_levels_mark(MDD mdd, size_t *variables)
+#define LDD_FROM_SORTED_BATCH 64
+
+TASK_5(MDD, lddmc_from_sorted_rec, const uint32_t*, states, size_t, lo, size_t, hi, size_t, len, size_t, depth)
 {
-    if (mdd <= lddmc_true) return;
-    mddnode_t n = LDD_GETNODE(mdd);
-    if (!mddnode_getmark(n)) {
-        mddnode_setmark(n, 1);
-        (*variables) += 1;
-        lddmc_nodecount_levels_mark(mddnode_getright(n), variables);
-        lddmc_nodecount_levels_mark(mddnode_getdown(n), variables+1);
+    if (depth == len) return lddmc_true;
+
+    MDD result = lddmc_false;
+    size_t end = hi;
+    while (end > lo) {
+        /* Find the starts of the next batch of groups, right to left */
+        size_t starts[LDD_FROM_SORTED_BATCH];
+        int count = 0;
+        size_t e = end;
+        while (e > lo && count < LDD_FROM_SORTED_BATCH) {
+            const uint32_t value = states[(e-1)*len+depth];
+            size_t a = lo, b = e-1;
+            while (a < b) {
+                size_t mid = (a + b) / 2;
+                if (states[mid*len+depth] < value) a = mid + 1;
+                else b = mid;
+            }
+            starts[count++] = a;
+            e = a;
+        }
+
+        /* Spawn the subtrees, the rightmost group last (so it is synced first) */
+        for (int i=count-1; i>=0; i--) {
+            const size_t group_end = i == 0 ? end : starts[i-1];
+            lddmc_refs_spawn(SPAWN(lddmc_from_sorted_rec, states, starts[i], group_end, len, depth+1));
+        }
+
+        /* Sync the subtrees and create the nodes */
+        for (int i=0; i<count; i++) {
+            lddmc_refs_push(result);
+            MDD down = lddmc_refs_sync(SYNC(lddmc_from_sorted_rec));
+            lddmc_refs_pop(1);
+            result = lddmc_makenode(states[starts[i]*len+depth], down, result);
+        }
+
+        end = e;
     }
+
+    return result;
 }
 
-static void
-lddmc_nodecount_levels_unmark(MDD mdd)
+TASK_IMPL_3(MDD, lddmc_from_sorted, const uint32_t*, states, size_t, n, size_t, len)
 {
-    if (mdd <= lddmc_true) return;
-    mddnode_t n = LDD_GETNODE(mdd);
-    if (mddnode_getmark(n)) {
-        mddnode_setmark(n, 0);
-        lddmc_nodecount_levels_unmark(mddnode_getright(n));
-        lddmc_nodecount_levels_unmark(mddnode_getdown(n));
-    }
+    if (n == 0) return lddmc_false;
+    return CALL(lddmc_from_sorted_rec, states, 0, n, len, 0);
 }
 
-void
-lddmc_nodecount_levels(MDD mdd, size_t *variables)
+static inline int
+lddmc_vector_cmp(const uint32_t *a, const uint32_t *b, size_t len)
 {
-    lddmc_nodecount_levels_mark(mdd, variables);
-    lddmc_nodecount_levels_unmark(mdd);
+    for (size_t i=0; i<len; i++) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
 }
 
 /**
- * Count number of nodes in MDD
+ * Sort the <n> vectors of length <len> in <states>, using <tmp> (of the same size) for merging.
  */
+VOID_TASK_4(lddmc_sort_vectors, uint32_t*, states, uint32_t*, tmp, size_t, n, size_t, len)
+{
+    if (n <= 16) {
+        // insertion sort
+        for (size_t i=1; i<n; i++) {
+            memcpy(tmp, states+i*len, sizeof(uint32_t)*len);
+            size_t j = i;
+            while (j > 0 && lddmc_vector_cmp(states+(j-1)*len, tmp, len) > 0) {
+                memcpy(states+j*len, states+(j-1)*len, sizeof(uint32_t)*len);
+                j--;
+            }
+            memcpy(states+j*len, tmp, sizeof(uint32_t)*len);
+        }
+        return;
+    }
 
-static size_t
-lddmc_nodecount_mark(MDD mdd)
-{
-    if (mdd <= lddmc_true) return 0;
-    mddnode_t n = LDD_GETNODE(mdd);
-    if (mddnode_getmark(n)) return 0;
-    mddnode_setmark(n, 1);
-    return 1 + lddmc_nodecount_mark(mddnode_getdown(n)) + lddmc_nodecount_mark(mddnode_getright(n));
-}
+    const size_t half = n/2;
+    SPAWN(lddmc_sort_vectors, states, tmp, half, len);
+    CALL(lddmc_sort_vectors, states+half*len, tmp+half*len, n-half, len);
+    SYNC(lddmc_sort_vectors);
 
-static void
-lddmc_nodecount_unmark(MDD mdd)
-{
-    if (mdd <= lddmc_true) return;
-    mddnode_t n = LDD_GETNODE(mdd);
-    if (mddnode_getmark(n)) {
-        mddnode_setmark(n, 0);
-        lddmc_nodecount_unmark(mddnode_getright(n));
-        lddmc_nodecount_unmark(mddnode_getdown(n));
+    // merge both halves into tmp, then copy back
+    uint32_t *a = states, *a_end = states+half*len, *b = a_end, *b_end = states+n*len, *out = tmp;
+    while (a != a_end && b != b_end) {
+        if (lddmc_vector_cmp(b, a, len) < 0) { memcpy(out, b, sizeof(uint32_t)*len); b += len; }
+        else { memcpy(out, a, sizeof(uint32_t)*len); a += len; }
+        out += len;
     }
+    if (a != a_end) memcpy(out, a, sizeof(uint32_t)*(a_end-a));
+    else if (b != b_end) memcpy(out, b, sizeof(uint32_t)*(b_end-b));
+    memcpy(states, tmp, sizeof(uint32_t)*n*len);
 }
 
-size_t
-lddmc_nodecount(MDD mdd)
+TASK_IMPL_3(MDD, lddmc_from_unsorted, uint32_t*, states, size_t, n, size_t, len)
 {
-    size_t result = lddmc_nodecount_mark(mdd);
-    lddmc_nodecount_unmark(mdd);
-    return result;
+    if (n == 0) return lddmc_false;
+    if (len != 0) {
+        uint32_t *tmp = (uint32_t*)malloc(sizeof(uint32_t)*n*len);
+        if (tmp == NULL) {
+            fprintf(stderr, "lddmc_from_unsorted: Unable to allocate memory!\n");
+            exit(1);
+        }
+        CALL(lddmc_sort_vectors, states, tmp, n, len);
+        free(tmp);
+    }
+    return CALL(lddmc_from_sorted_rec, states, 0, n, len, 0);
 }
 
 /**
- * CALCULATE NUMBER OF VAR ASSIGNMENTS THAT YIELD TRUE
+ * Conversion between LDDs and BDDs.
+ * The number of bits of every level is given as an LDD cube <bits>, which is a valid cache key.
  */
 
-TASK_IMPL_1(lddmc_satcount_double_t, lddmc_satcount_cached, MDD, mdd)
+TASK_3(BDD, lddmc_to_bdd_rec, MDD, mdd, MDD, bits, BDDSET, variables)
 {
-    if (mdd == lddmc_false) return 0.0;
-    if (mdd == lddmc_true) return 1.0;
+    if (mdd == lddmc_false) return sylvan_false;
+    if (mdd == lddmc_true) return sylvan_true;
 
-    /* Perhaps execute garbage collection */
+    /* Test gc */
     sylvan_gc_test();
 
-    union {
-        lddmc_satcount_double_t d;
-        uint64_t s;
-    } hack;
+    sylvan_stats_count(LDD_TO_BDD);
 
-    sylvan_stats_count(LDD_SATCOUNT);
+    /* Access cache */
+    BDD result;
+    if (cache_get3(CACHE_MDD_TO_BDD, mdd, bits, variables, &result)) return result;
 
-    if (cache_get3(CACHE_MDD_SATCOUNT, mdd, 0, 0, &hack.s)) {
-        sylvan_stats_count(LDD_SATCOUNT_CACHED);
-        return hack.d;
+    mddnode_t n = LDD_GETNODE(mdd);
+    mddnode_t n_bits = LDD_GETNODE(bits);
+    assert(!mddnode_getcopy(n));
+
+    /* Get the variables of this level */
+    const uint32_t b = mddnode_getvalue(n_bits);
+    assert(b <= 32);
+    BDDVAR level_vars[32];
+    BDDSET next_vars = variables;
+    for (uint32_t i=0; i<b; i++) {
+        level_vars[i] = sylvan_var(next_vars);
+        next_vars = sylvan_set_next(next_vars);
     }
 
-    mddnode_t n = LDD_GETNODE(mdd);
+    /* Convert the other values of this level in parallel */
+    bdd_refs_spawn(SPAWN(lddmc_to_bdd_rec, mddnode_getright(n), bits, variables));
+    result = CALL(lddmc_to_bdd_rec, mddnode_getdown(n), mddnode_getdown(n_bits), next_vars);
 
-    SPAWN(lddmc_satcount_cached, mddnode_getdown(n));
-    lddmc_satcount_double_t right = CALL(lddmc_satcount_cached, mddnode_getright(n));
-    hack.d = right + SYNC(lddmc_satcount_cached);
+    /* Encode the value of this node, bottom-up */
+    const uint32_t value = mddnode_getvalue(n);
+    for (uint32_t i=b; i>0; i--) {
+        if (value & (1U << (b-i))) result = sylvan_makenode(level_vars[i-1], sylvan_false, result);
+        else result = sylvan_makenode(level_vars[i-1], result, sylvan_false);
+    }
 
-    if (cache_put3(CACHE_MDD_SATCOUNT, mdd, 0, 0, hack.s)) sylvan_stats_count(LDD_SATCOUNT_CACHEDPUT);
+    bdd_refs_push(result);
+    BDD right = bdd_refs_sync(SYNC(lddmc_to_bdd_rec));
+    bdd_refs_push(right);
+    result = sylvan_or(result, right);
+    bdd_refs_pop(2);
 
-    return hack.d;
+    /* Write to cache */
+    cache_put3(CACHE_MDD_TO_BDD, mdd, bits, variables, result);
+
+    return result;
 }
 
-TASK_IMPL_1(long double, lddmc_satcount, MDD, mdd)
+TASK_IMPL_4(BDD, lddmc_to_bdd, MDD, mdd, const uint32_t*, bits_per_level, size_t, levels, BDDSET, variables)
 {
-    if (mdd == lddmc_false) return 0.0;
-    if (mdd == lddmc_true) return 1.0;
-
+    MDD bits = lddmc_cube((uint32_t*)bits_per_level, levels);
+    lddmc_refs_push(bits);
+    BDD result = CALL(lddmc_to_bdd_rec, mdd, bits, variables);
+    lddmc_refs_pop(1);
+    return result;
+}
+
+TASK_DECL_3(MDD, bdd_to_lddmc_rec, BDD, MDD, BDDSET);
+
+/**
+ * Convert the values of bits <i> and further of the current level, where <value> holds the first <i> bits.
+ * The values are collected in a single LDD level, from the union of the levels for bit value 0 and 1.
+ */
+TASK_5(MDD, bdd_to_lddmc_level, BDD, bdd, MDD, bits, BDDSET, variables, uint32_t, i, uint32_t, value)
+{
+    if (bdd == sylvan_false) return lddmc_false;
+
+    mddnode_t n_bits = LDD_GETNODE(bits);
+    const uint32_t b = mddnode_getvalue(n_bits);
+    if (i == b) {
+        MDD down = CALL(bdd_to_lddmc_rec, bdd, mddnode_getdown(n_bits), variables);
+        return lddmc_makenode(value, down, lddmc_false);
+    }
+
+    const BDDVAR var = sylvan_var(variables);
+    BDD low = bdd, high = bdd;
+    if (!sylvan_isconst(bdd) && sylvan_var(bdd) == var) {
+        low = sylvan_low(bdd);
+        high = sylvan_high(bdd);
+    }
+    assert(sylvan_isconst(bdd) || sylvan_var(bdd) >= var);
+
+    variables = sylvan_set_next(variables);
+    lddmc_refs_spawn(SPAWN(bdd_to_lddmc_level, high, bits, variables, i+1, value | (1U << (b-i-1))));
+    MDD result = CALL(bdd_to_lddmc_level, low, bits, variables, i+1, value);
+    lddmc_refs_push(result);
+    MDD right = lddmc_refs_sync(SYNC(bdd_to_lddmc_level));
+    lddmc_refs_push(right);
+    result = CALL(lddmc_union, result, right);
+    lddmc_refs_pop(2);
+    return result;
+}
+
+TASK_IMPL_3(MDD, bdd_to_lddmc_rec, BDD, bdd, MDD, bits, BDDSET, variables)
+{
+    if (bdd == sylvan_false) return lddmc_false;
+    if (bits == lddmc_true) {
+        assert(bdd == sylvan_true);
+        return lddmc_true;
+    }
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(LDD_FROM_BDD);
+
+    /* Access cache */
+    MDD result;
+    if (cache_get3(CACHE_MDD_FROM_BDD, bdd, bits, variables, &result)) return result;
+
+    result = CALL(bdd_to_lddmc_level, bdd, bits, variables, 0, 0);
+
+    /* Write to cache */
+    cache_put3(CACHE_MDD_FROM_BDD, bdd, bits, variables, result);
+
+    return result;
+}
+
+TASK_IMPL_4(MDD, bdd_to_lddmc, BDD, bdd, const uint32_t*, bits_per_level, size_t, levels, BDDSET, variables)
+{
+    MDD bits = lddmc_cube((uint32_t*)bits_per_level, levels);
+    lddmc_refs_push(bits);
+    MDD result = CALL(bdd_to_lddmc_rec, bdd, bits, variables);
+    lddmc_refs_pop(1);
+    return result;
+}
+
+static void
+lddmc_nodecount_levels_mark(MDD mdd, size_t *variables)
+{
+    if (mdd <= lddmc_true) return;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (!mddnode_getmark(n)) {
+        mddnode_setmark(n, 1);
+        (*variables) += 1;
+        lddmc_nodecount_levels_mark(mddnode_getright(n), variables);
+        lddmc_nodecount_levels_mark(mddnode_getdown(n), variables+1);
+    }
+}
+
+static void
+lddmc_nodecount_levels_unmark(MDD mdd)
+{
+    if (mdd <= lddmc_true) return;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (mddnode_getmark(n)) {
+        mddnode_setmark(n, 0);
+        lddmc_nodecount_levels_unmark(mddnode_getright(n));
+        lddmc_nodecount_levels_unmark(mddnode_getdown(n));
+    }
+}
+
+void
+lddmc_nodecount_levels(MDD mdd, size_t *variables)
+{
+    lddmc_nodecount_levels_mark(mdd, variables);
+    lddmc_nodecount_levels_unmark(mdd);
+}
+
+/**
+ * Count number of nodes in MDD
+ */
+
+static size_t
+lddmc_nodecount_mark(MDD mdd)
+{
+    if (mdd <= lddmc_true) return 0;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (mddnode_getmark(n)) return 0;
+    mddnode_setmark(n, 1);
+    return 1 + lddmc_nodecount_mark(mddnode_getdown(n)) + lddmc_nodecount_mark(mddnode_getright(n));
+}
+
+static void
+lddmc_nodecount_unmark(MDD mdd)
+{
+    if (mdd <= lddmc_true) return;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (mddnode_getmark(n)) {
+        mddnode_setmark(n, 0);
+        lddmc_nodecount_unmark(mddnode_getright(n));
+        lddmc_nodecount_unmark(mddnode_getdown(n));
+    }
+}
+
+size_t
+lddmc_nodecount(MDD mdd)
+{
+    size_t result = lddmc_nodecount_mark(mdd);
+    lddmc_nodecount_unmark(mdd);
+    return result;
+}
+
+/**
+ * Variable reordering.
+ * A node of the level that moves down in lddmc_swap_levels is inserted with lddmc_insert_level
+ * above the subtrees at the level below the other block. The value of the inserted node is in
+ * the lower 32 bits of <value>; bit 32 is set for a copy node.
+ */
+
+static inline MDD
+lddmc_remake(mddnode_t n, MDD down, MDD right)
+{
+    if (mddnode_getcopy(n)) return lddmc_make_copynode(down, right);
+    else return lddmc_makenode(mddnode_getvalue(n), down, right);
+}
+
+TASK_3(MDD, lddmc_insert_level, MDD, mdd, uint32_t, depth, uint64_t, value)
+{
+    if (mdd == lddmc_false) return lddmc_false;
+    if (depth == 0) {
+        if (value >> 32) return lddmc_make_copynode(mdd, lddmc_false);
+        else return lddmc_makenode((uint32_t)value, mdd, lddmc_false);
+    }
+    assert(mdd != lddmc_true);
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(LDD_SWAP_LEVELS);
+
+    /* Access cache */
+    MDD result;
+    if (cache_get3(CACHE_MDD_INSERT_LEVEL, mdd, depth, value, &result)) {
+        sylvan_stats_count(LDD_SWAP_LEVELS_CACHED);
+        return result;
+    }
+
+    mddnode_t n = LDD_GETNODE(mdd);
+    lddmc_refs_spawn(SPAWN(lddmc_insert_level, mddnode_getright(n), depth, value));
+    MDD down = CALL(lddmc_insert_level, mddnode_getdown(n), depth-1, value);
+    lddmc_refs_push(down);
+    MDD right = lddmc_refs_sync(SYNC(lddmc_insert_level));
+    lddmc_refs_pop(1);
+    result = lddmc_remake(n, down, right);
+
+    /* Write to cache */
+    if (cache_put3(CACHE_MDD_INSERT_LEVEL, mdd, depth, value, result)) sylvan_stats_count(LDD_SWAP_LEVELS_CACHEDPUT);
+
+    return result;
+}
+
+TASK_DECL_4(MDD, lddmc_swap_chain, MDD, size_t, uint32_t, uint32_t);
+
+TASK_IMPL_4(MDD, lddmc_swap_levels, MDD, mdd, uint32_t, level, uint32_t, n1, uint32_t, n2)
+{
+    if (mdd == lddmc_false) return lddmc_false;
+    if (n1 == 0 || n2 == 0) return mdd;
+    assert(mdd != lddmc_true); // expecting at least level+n1+n2 levels
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(LDD_SWAP_LEVELS);
+
+    /* Access cache */
+    MDD result;
+    const uint64_t blocks = ((uint64_t)n1 << 32) | n2;
+    if (cache_get3(CACHE_MDD_SWAP_LEVELS, mdd, level, blocks, &result)) {
+        sylvan_stats_count(LDD_SWAP_LEVELS_CACHED);
+        return result;
+    }
+
+    if (level > 0) {
+        mddnode_t n = LDD_GETNODE(mdd);
+        lddmc_refs_spawn(SPAWN(lddmc_swap_levels, mddnode_getright(n), level, n1, n2));
+        MDD down = CALL(lddmc_swap_levels, mddnode_getdown(n), level-1, n1, n2);
+        lddmc_refs_push(down);
+        MDD right = lddmc_refs_sync(SYNC(lddmc_swap_levels));
+        lddmc_refs_pop(1);
+        result = lddmc_remake(n, down, right);
+    } else {
+        size_t count = 0;
+        for (MDD m = mdd; m != lddmc_false; m = mddnode_getright(LDD_GETNODE(m))) count++;
+        result = CALL(lddmc_swap_chain, mdd, count, n1, n2);
+    }
+
+    /* Write to cache */
+    if (cache_put3(CACHE_MDD_SWAP_LEVELS, mdd, level, blocks, result)) sylvan_stats_count(LDD_SWAP_LEVELS_CACHEDPUT);
+
+    return result;
+}
+
+/**
+ * Swap the blocks for the first <count> nodes of the level starting at <mdd>.
+ * Every node is moved below the second block separately, and the results are merged pairwise
+ * with union, so a level of k nodes costs log(k) rounds of unions instead of k.
+ */
+TASK_IMPL_4(MDD, lddmc_swap_chain, MDD, mdd, size_t, count, uint32_t, n1, uint32_t, n2)
+{
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (count == 1) {
+        /* Move the rest of the first block below the second block, then insert this node below the second block */
+        MDD down = CALL(lddmc_swap_levels, mddnode_getdown(n), 0, n1-1, n2);
+        lddmc_refs_push(down);
+        const uint64_t value = mddnode_getcopy(n) ? (1ULL << 32) : mddnode_getvalue(n);
+        MDD result = CALL(lddmc_insert_level, down, n2, value);
+        lddmc_refs_pop(1);
+        return result;
+    }
+
+    MDD second = mdd;
+    for (size_t i=0; i<count/2; i++) second = mddnode_getright(LDD_GETNODE(second));
+    lddmc_refs_spawn(SPAWN(lddmc_swap_chain, mdd, count/2, n1, n2));
+    MDD right = CALL(lddmc_swap_chain, second, count-count/2, n1, n2);
+    lddmc_refs_push(right);
+    MDD left = lddmc_refs_sync(SYNC(lddmc_swap_chain));
+    lddmc_refs_push(left);
+    MDD result = CALL(lddmc_union, left, right);
+    lddmc_refs_pop(2);
+    return result;
+}
+
+/**
+ * Sifting. The meta of every relation is decoded into one code for every state variable
+ * (0: not in the relation, 1: read and write, 3: only-read, 4: only-write) and the tail of the meta
+ * after the last variable of the relation (the action label and the end marker), which does not move.
+ */
+typedef struct lddmc_sift_job {
+    MDD *dd;
+    uint32_t level, n1, n2;
+} lddmc_sift_job_t;
+
+typedef struct lddmc_sift {
+    size_t vars;
+    uint32_t *order;
+    MDD *sets;
+    size_t set_count;
+    MDD *relations;
+    size_t rel_count;
+    uint8_t *codes;             // rel_count * vars codes
+    lddmc_sift_job_t *jobs;     // set_count + rel_count jobs
+    size_t size;                // current sum of the numbers of nodes of the sets and relations
+    size_t best;                // smallest total number of nodes of the current variable
+    size_t best_pos;            // level of the current variable for the smallest size
+    double max_growth;
+} lddmc_sift_t;
+
+static inline uint32_t
+lddmc_sift_width(uint8_t code)
+{
+    return code == 0 ? 0 : (code == 1 ? 2 : 1);
+}
+
+static size_t
+lddmc_sift_size(lddmc_sift_t *s)
+{
+    size_t result = 0;
+    for (size_t i=0; i<s->set_count; i++) result += lddmc_nodecount(s->sets[i]);
+    for (size_t i=0; i<s->rel_count; i++) result += lddmc_nodecount(s->relations[i]);
+    return result;
+}
+
+/**
+ * Count the nodes of <mdd> on the levels <from> to <to> (exclusive), where <mdd> is on level <level>.
+ * A swap only changes the nodes on the swapped levels: the nodes below are the same nodes, and the
+ * nodes above represent the same sets of permuted vectors, so their number per level does not change.
+ */
+static size_t
+lddmc_sift_levels_mark(MDD mdd, size_t level, size_t from, size_t to)
+{
+    if (mdd <= lddmc_true || level >= to) return 0;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (mddnode_getmark(n)) return 0;
+    mddnode_setmark(n, 1);
+    return (level >= from ? 1 : 0) + lddmc_sift_levels_mark(mddnode_getdown(n), level+1, from, to) +
+        lddmc_sift_levels_mark(mddnode_getright(n), level, from, to);
+}
+
+static void
+lddmc_sift_levels_unmark(MDD mdd, size_t level, size_t to)
+{
+    if (mdd <= lddmc_true || level >= to) return;
+    mddnode_t n = LDD_GETNODE(mdd);
+    if (mddnode_getmark(n)) {
+        mddnode_setmark(n, 0);
+        lddmc_sift_levels_unmark(mddnode_getright(n), level, to);
+        lddmc_sift_levels_unmark(mddnode_getdown(n), level+1, to);
+    }
+}
+
+static size_t
+lddmc_sift_levels(lddmc_sift_job_t *job)
+{
+    const size_t to = job->level + job->n1 + job->n2;
+    size_t result = lddmc_sift_levels_mark(*job->dd, 0, job->level, to);
+    lddmc_sift_levels_unmark(*job->dd, 0, to);
+    return result;
+}
+
+VOID_TASK_2(lddmc_sift_swap_par, lddmc_sift_job_t*, jobs, size_t, count)
+{
+    if (count == 1) {
+        *jobs->dd = CALL(lddmc_swap_levels, *jobs->dd, jobs->level, jobs->n1, jobs->n2);
+    } else if (count > 1) {
+        SPAWN(lddmc_sift_swap_par, jobs, count/2);
+        CALL(lddmc_sift_swap_par, jobs+count/2, count-count/2);
+        SYNC(lddmc_sift_swap_par);
+    }
+}
+
+/**
+ * Swap the state variables at levels <level> and <level+1> in all sets and relations.
+ */
+VOID_TASK_2(lddmc_sift_swap, lddmc_sift_t*, s, size_t, level)
+{
+    size_t count = 0;
+    for (size_t i=0; i<s->set_count; i++) {
+        s->jobs[count++] = (lddmc_sift_job_t){&s->sets[i], level, 1, 1};
+    }
+    for (size_t i=0; i<s->rel_count; i++) {
+        uint8_t *codes = s->codes + i*s->vars;
+        uint32_t rel_level = 0;
+        for (size_t j=0; j<level; j++) rel_level += lddmc_sift_width(codes[j]);
+        const uint32_t n1 = lddmc_sift_width(codes[level]);
+        const uint32_t n2 = lddmc_sift_width(codes[level+1]);
+        if (n1 != 0 && n2 != 0) s->jobs[count++] = (lddmc_sift_job_t){&s->relations[i], rel_level, n1, n2};
+        uint8_t c = codes[level];
+        codes[level] = codes[level+1];
+        codes[level+1] = c;
+    }
+    for (size_t i=0; i<count; i++) s->size -= lddmc_sift_levels(&s->jobs[i]);
+    CALL(lddmc_sift_swap_par, s->jobs, count);
+    for (size_t i=0; i<count; i++) s->size += lddmc_sift_levels(&s->jobs[i]);
+
+    uint32_t v = s->order[level];
+    s->order[level] = s->order[level+1];
+    s->order[level+1] = v;
+}
+
+/**
+ * Move the variable at level <*pos> up (dir -1) or down (dir 1) until the first or last level,
+ * or until the total size exceeds max_growth times the best size.
+ */
+VOID_TASK_3(lddmc_sift_dir, lddmc_sift_t*, s, size_t*, pos, int, dir)
+{
+    while (dir < 0 ? *pos > 0 : *pos+1 < s->vars) {
+        if (dir < 0) CALL(lddmc_sift_swap, s, --(*pos));
+        else CALL(lddmc_sift_swap, s, (*pos)++);
+        if (s->size < s->best) {
+            s->best = s->size;
+            s->best_pos = *pos;
+        } else if ((double)s->size > s->max_growth * (double)s->best) {
+            break;
+        }
+    }
+}
+
+size_t
+lddmc_sift(size_t vars, uint32_t *order, MDD *sets, size_t set_count, MDD *relations, MDD *metas, size_t rel_count, double max_growth)
+{
+    LACE_ME;
+
+    lddmc_sift_t s;
+    s.vars = vars;
+    s.order = order;
+    s.sets = sets;
+    s.set_count = set_count;
+    s.relations = relations;
+    s.rel_count = rel_count;
+    s.codes = (uint8_t*)calloc(rel_count*vars+1, sizeof(uint8_t));
+    s.jobs = (lddmc_sift_job_t*)malloc(sizeof(lddmc_sift_job_t[set_count+rel_count+1]));
+    s.max_growth = max_growth;
+    MDD *tails = (MDD*)malloc(sizeof(MDD[rel_count+1]));
+
+    for (size_t i=0; i<set_count; i++) lddmc_refs_pushptr(&sets[i]);
+    for (size_t i=0; i<rel_count; i++) lddmc_refs_pushptr(&relations[i]);
+    for (size_t i=0; i<rel_count; i++) lddmc_refs_pushptr(&metas[i]);
+
+    /* Decode the metas */
+    for (size_t i=0; i<rel_count; i++) {
+        MDD meta = metas[i];
+        for (size_t j=0; j<vars && meta != lddmc_true; j++) {
+            const uint32_t code = lddmc_getvalue(meta);
+            if (code != 0 && code != 1 && code != 3 && code != 4) break;
+            s.codes[i*vars+j] = (uint8_t)code;
+            meta = lddmc_getdown(meta);
+            if (code == 1) meta = lddmc_getdown(meta); // skip the write
+        }
+        tails[i] = meta;
+    }
+
+    /* Sift the variables in the order of the number of nodes of their level in the sets, largest first */
+    size_t *level_nodes = (size_t*)calloc(vars+1, sizeof(size_t));
+    uint32_t *levels = (uint32_t*)malloc(sizeof(uint32_t[vars+1]));
+    for (size_t i=0; i<set_count; i++) lddmc_nodecount_levels(sets[i], level_nodes);
+    for (size_t i=0; i<vars; i++) {
+        size_t j = i;
+        while (j > 0 && level_nodes[levels[j-1]] < level_nodes[i]) {
+            levels[j] = levels[j-1];
+            j--;
+        }
+        levels[j] = i;
+    }
+    for (size_t i=0; i<vars; i++) levels[i] = order[levels[i]];
+
+    s.size = lddmc_sift_size(&s);
+    for (size_t i=0; i<vars; i++) {
+        size_t pos = 0;
+        while (order[pos] != levels[i]) pos++;
+        s.best = s.size;
+        s.best_pos = pos;
+        // first move to the nearest end
+        if (pos < vars/2) {
+            CALL(lddmc_sift_dir, &s, &pos, -1);
+            CALL(lddmc_sift_dir, &s, &pos, 1);
+        } else {
+            CALL(lddmc_sift_dir, &s, &pos, 1);
+            CALL(lddmc_sift_dir, &s, &pos, -1);
+        }
+        while (pos > s.best_pos) CALL(lddmc_sift_swap, &s, --pos);
+        while (pos < s.best_pos) CALL(lddmc_sift_swap, &s, pos++);
+    }
+
+    /* Encode the metas */
+    for (size_t i=0; i<rel_count; i++) {
+        const uint8_t *codes = s.codes + i*vars;
+        size_t last = vars;
+        while (last > 0 && codes[last-1] == 0) last--;
+        MDD meta = tails[i];
+        for (size_t j=last; j>0; j--) {
+            if (codes[j-1] == 1) {
+                meta = lddmc_makenode(2, meta, lddmc_false);
+                meta = lddmc_makenode(1, meta, lddmc_false);
+            } else {
+                meta = lddmc_makenode(codes[j-1], meta, lddmc_false);
+            }
+        }
+        metas[i] = meta;
+    }
+
+    lddmc_refs_popptr(set_count + 2*rel_count);
+
+    free(levels);
+    free(level_nodes);
+    free(tails);
+    free(s.jobs);
+    free(s.codes);
+
+    return s.size;
+}
+
+/**
+ * CALCULATE NUMBER OF VAR ASSIGNMENTS THAT YIELD TRUE
+ */
+
+TASK_IMPL_1(lddmc_satcount_double_t, lddmc_satcount_cached, MDD, mdd)
+{
+    if (mdd == lddmc_false) return 0.0;
+    if (mdd == lddmc_true) return 1.0;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    union {
+        lddmc_satcount_double_t d;
+        uint64_t s;
+    } hack;
+
+    sylvan_stats_count(LDD_SATCOUNT);
+
+    if (cache_get3(CACHE_MDD_SATCOUNT, mdd, 0, 0, &hack.s)) {
+        sylvan_stats_count(LDD_SATCOUNT_CACHED);
+        return hack.d;
+    }
+
+    mddnode_t n = LDD_GETNODE(mdd);
+
+    SPAWN(lddmc_satcount_cached, mddnode_getdown(n));
+    lddmc_satcount_double_t right = CALL(lddmc_satcount_cached, mddnode_getright(n));
+    hack.d = right + SYNC(lddmc_satcount_cached);
+
+    if (cache_put3(CACHE_MDD_SATCOUNT, mdd, 0, 0, hack.s)) sylvan_stats_count(LDD_SATCOUNT_CACHEDPUT);
+
+    return hack.d;
+}
+
+TASK_IMPL_1(long double, lddmc_satcount, MDD, mdd)
+{
+    if (mdd == lddmc_false) return 0.0;
+    if (mdd == lddmc_true) return 1.0;
+
     /* Perhaps execute garbage collection */
     sylvan_gc_test();
 
@@ -2014,6 +3006,42 @@ TASK_IMPL_1(long double, lddmc_satcount, MDD, mdd)
     return hack.d;
 }
 
+TASK_IMPL_1(double, lddmc_satcount_log2, MDD, mdd)
+{
+    if (mdd == lddmc_false) return -INFINITY;
+    if (mdd == lddmc_true) return 0.0;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    sylvan_stats_count(LDD_SATCOUNT_LOG2);
+
+    union {
+        double d;
+        uint64_t s;
+    } hack;
+
+    if (cache_get3(CACHE_MDD_SATCOUNT_LOG2, mdd, 0, 0, &hack.s)) {
+        sylvan_stats_count(LDD_SATCOUNT_LOG2_CACHED);
+        return hack.d;
+    }
+
+    mddnode_t n = LDD_GETNODE(mdd);
+
+    SPAWN(lddmc_satcount_log2, mddnode_getdown(n));
+    double right = CALL(lddmc_satcount_log2, mddnode_getright(n));
+    double down = SYNC(lddmc_satcount_log2);
+
+    /* log2(2^a + 2^b) = max + log2(1 + 2^(min-max)) */
+    if (right == -INFINITY) hack.d = down;
+    else if (right < down) hack.d = down + log2(1.0 + exp2(right - down));
+    else hack.d = right + log2(1.0 + exp2(down - right));
+
+    if (cache_put3(CACHE_MDD_SATCOUNT_LOG2, mdd, 0, 0, hack.s)) sylvan_stats_count(LDD_SATCOUNT_LOG2_CACHEDPUT);
+
+    return hack.d;
+}
+
 TASK_IMPL_5(MDD, lddmc_collect, MDD, mdd, lddmc_collect_cb, cb, void*, context, uint32_t*, values, size_t, count)
 {
     if (mdd == lddmc_false) return lddmc_false;
@@ -2098,6 +3126,268 @@ VOID_TASK_IMPL_5(lddmc_sat_all_par, MDD, mdd, lddmc_enum_cb, cb, void*, context,
     SYNC(lddmc_sat_all_par);
 }
 
+/**
+ * Batched enumeration, as sylvan_enum_batch for BDDs. Every worker writes the values of the current
+ * path in its own cube; a task that is stolen first copies the prefix of the path from the cube of
+ * the worker that spawned it.
+ */
+typedef struct lddmc_sat_batch_worker {
+    uint32_t *cube;             // values of the current path
+    uint32_t *buffer;           // <batch> cubes of <width> values
+    size_t count;               // number of cubes in the buffer
+    char pad[64-2*sizeof(uint32_t*)-sizeof(size_t)];
+} lddmc_sat_batch_worker_t;
+
+typedef struct lddmc_sat_batch_ctx {
+    size_t width;               // number of values of each cube
+    size_t batch;               // number of cubes in a buffer
+    lddmc_batch_cb cb;
+    void *context;
+    lddmc_sat_batch_worker_t *workers;
+} lddmc_sat_batch_ctx_t;
+
+/**
+ * Enumerate <mdd> at position <depth>; the values before position <depth> are in <prefix>.
+ */
+VOID_TASK_4(lddmc_sat_all_batch_do, MDD, mdd, size_t, depth, const uint32_t*, prefix, lddmc_sat_batch_ctx_t*, ctx)
+{
+    if (mdd == lddmc_false) return;
+
+    lddmc_sat_batch_worker_t *w = &ctx->workers[LACE_WORKER_ID];
+    uint32_t *cube = w->cube;
+    if (prefix != cube) memcpy(cube, prefix, sizeof(uint32_t[depth])); // stolen
+
+    if (mdd == lddmc_true) {
+        assert(depth == ctx->width);
+        if (w->count == ctx->batch) {
+            WRAP(ctx->cb, w->buffer, w->count, ctx->context);
+            w->count = 0;
+        }
+        memcpy(w->buffer + w->count*ctx->width, cube, sizeof(uint32_t[ctx->width]));
+        w->count++;
+        return;
+    }
+
+    mddnode_t n = LDD_GETNODE(mdd);
+
+    SPAWN(lddmc_sat_all_batch_do, mddnode_getright(n), depth, cube, ctx);
+    cube[depth] = mddnode_getvalue(n);
+    CALL(lddmc_sat_all_batch_do, mddnode_getdown(n), depth+1, cube, ctx);
+    SYNC(lddmc_sat_all_batch_do);
+}
+
+VOID_TASK_IMPL_5(lddmc_sat_all_batch, MDD, mdd, size_t, width, size_t, batch, lddmc_batch_cb, cb, void*, context)
+{
+    if (mdd == lddmc_false || batch == 0) return;
+
+    const unsigned int n_workers = lace_workers();
+    lddmc_sat_batch_ctx_t ctx;
+    ctx.width = width;
+    ctx.batch = batch;
+    ctx.cb = cb;
+    ctx.context = context;
+    ctx.workers = (lddmc_sat_batch_worker_t*)calloc(n_workers, sizeof(lddmc_sat_batch_worker_t));
+    for (unsigned int i=0; i<n_workers; i++) {
+        ctx.workers[i].cube = (uint32_t*)malloc(sizeof(uint32_t[width+1]));
+        ctx.workers[i].buffer = (uint32_t*)malloc(sizeof(uint32_t[batch*width+1]));
+    }
+
+    CALL(lddmc_sat_all_batch_do, mdd, 0, ctx.workers[LACE_WORKER_ID].cube, &ctx);
+
+    /* Hand over the remaining cubes */
+    for (unsigned int i=0; i<n_workers; i++) {
+        if (ctx.workers[i].count > 0) WRAP(cb, ctx.workers[i].buffer, ctx.workers[i].count, context);
+        free(ctx.workers[i].cube);
+        free(ctx.workers[i].buffer);
+    }
+    free(ctx.workers);
+}
+
+/**
+ * Reachability with on-the-fly learning
+ */
+
+#define LDD_LEARN_BATCH 1024
+
+struct lddmc_learn_buffer {
+    uint32_t *data;             // <count> transitions of <width> values
+    size_t count;
+    size_t capacity;
+    size_t width;
+};
+
+void
+lddmc_learn_add(lddmc_learn_buffer_t buffer, const uint32_t *transition)
+{
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? LDD_LEARN_BATCH : buffer->capacity * 2;
+        buffer->data = (uint32_t*)realloc(buffer->data, sizeof(uint32_t[buffer->capacity*buffer->width+1]));
+        if (buffer->data == NULL) {
+            fprintf(stderr, "lddmc_learn_add: Unable to allocate memory!\n");
+            exit(1);
+        }
+    }
+    memcpy(buffer->data + buffer->count*buffer->width, transition, sizeof(uint32_t[buffer->width]));
+    buffer->count++;
+}
+
+typedef struct lddmc_learn {
+    const MDD *metas;
+    MDD *relations;
+    MDD *projs;                 // for every group, the projection on the variables read by the group
+    MDD *learned;               // for every group, the short vectors given to the callback
+    size_t *read_widths;        // for every group, the number of variables read by the group
+    size_t *widths;             // for every group, the number of levels of the relation
+    lddmc_next_cb cb;
+    void *context;
+} lddmc_learn_t;
+
+typedef struct lddmc_learn_group {
+    int group;
+    size_t read_width;
+    lddmc_next_cb cb;
+    void *context;
+    struct lddmc_learn_buffer *buffers; // one for every worker
+} lddmc_learn_group_t;
+
+VOID_TASK_3(lddmc_learn_batch, uint32_t*, vectors, size_t, count, void*, context)
+{
+    lddmc_learn_group_t *g = (lddmc_learn_group_t*)context;
+    lddmc_learn_buffer_t buffer = &g->buffers[LACE_WORKER_ID];
+    for (size_t i=0; i<count; i++) WRAP(g->cb, g->group, vectors + i*g->read_width, buffer, g->context);
+}
+
+/**
+ * Learn the transitions of group <group> from the short vectors of <states> that were not seen before.
+ */
+VOID_TASK_3(lddmc_learn_group, lddmc_learn_t*, l, MDD, states, int, group)
+{
+    MDD fresh = CALL(lddmc_project_minus, states, l->projs[group], l->learned[group]);
+    if (fresh == lddmc_false) return;
+    lddmc_refs_push(fresh);
+
+    const unsigned int n_workers = lace_workers();
+    lddmc_learn_group_t g;
+    g.group = group;
+    g.read_width = l->read_widths[group];
+    g.cb = l->cb;
+    g.context = l->context;
+    g.buffers = (struct lddmc_learn_buffer*)calloc(n_workers, sizeof(struct lddmc_learn_buffer));
+    if (g.buffers == NULL) {
+        fprintf(stderr, "lddmc_learn_group: Unable to allocate memory!\n");
+        exit(1);
+    }
+    for (unsigned int i=0; i<n_workers; i++) g.buffers[i].width = l->widths[group];
+
+    CALL(lddmc_sat_all_batch, fresh, g.read_width, LDD_LEARN_BATCH, TASK(lddmc_learn_batch), &g);
+
+    /* Add the transitions of every worker to the relation (the array entries are protected) */
+    for (unsigned int i=0; i<n_workers; i++) {
+        if (g.buffers[i].count > 0) {
+            MDD r = CALL(lddmc_from_unsorted, g.buffers[i].data, g.buffers[i].count, g.buffers[i].width);
+            lddmc_refs_push(r);
+            l->relations[group] = CALL(lddmc_union, l->relations[group], r);
+            lddmc_refs_pop(1);
+        }
+        free(g.buffers[i].data);
+    }
+    free(g.buffers);
+
+    l->learned[group] = CALL(lddmc_union, l->learned[group], fresh);
+    lddmc_refs_pop(1);
+}
+
+VOID_TASK_4(lddmc_learn_par, lddmc_learn_t*, l, MDD, states, int, from, int, count)
+{
+    if (count == 1) {
+        CALL(lddmc_learn_group, l, states, from);
+    } else if (count > 1) {
+        SPAWN(lddmc_learn_par, l, states, from, count/2);
+        CALL(lddmc_learn_par, l, states, from+count/2, count-count/2);
+        SYNC(lddmc_learn_par);
+    }
+}
+
+/**
+ * Compute the union of <visited> and the successors of <frontier> for groups <from> to <from+count>.
+ */
+TASK_5(MDD, lddmc_learn_image, lddmc_learn_t*, l, MDD, frontier, MDD, visited, int, from, int, count)
+{
+    if (count == 0) return visited;
+    if (count == 1) return CALL(lddmc_relprod_union, frontier, l->relations[from], l->metas[from], visited);
+    lddmc_refs_spawn(SPAWN(lddmc_learn_image, l, frontier, visited, from, count/2));
+    MDD right = CALL(lddmc_learn_image, l, frontier, visited, from+count/2, count-count/2);
+    lddmc_refs_push(right);
+    MDD left = lddmc_refs_sync(SYNC(lddmc_learn_image));
+    lddmc_refs_push(left);
+    MDD result = CALL(lddmc_union, left, right);
+    lddmc_refs_pop(2);
+    return result;
+}
+
+TASK_IMPL_6(MDD, lddmc_learn_reachability, MDD, initial, MDD*, relations, const MDD*, metas, int, count, lddmc_next_cb, cb, void*, context)
+{
+    lddmc_learn_t l;
+    l.metas = metas;
+    l.relations = relations;
+    l.projs = (MDD*)malloc(sizeof(MDD[count+1]));
+    l.learned = (MDD*)malloc(sizeof(MDD[count+1]));
+    l.read_widths = (size_t*)malloc(sizeof(size_t[count+1]));
+    l.widths = (size_t*)malloc(sizeof(size_t[count+1]));
+    if (l.projs == NULL || l.learned == NULL || l.read_widths == NULL || l.widths == NULL) {
+        fprintf(stderr, "lddmc_learn_reachability: Unable to allocate memory!\n");
+        exit(1);
+    }
+    l.cb = cb;
+    l.context = context;
+
+    for (int i=0; i<count; i++) {
+        relations[i] = lddmc_false;
+        l.learned[i] = lddmc_false;
+        l.projs[i] = lddmc_false;
+        lddmc_refs_pushptr(&relations[i]);
+        lddmc_refs_pushptr(&l.learned[i]);
+        lddmc_refs_pushptr(&l.projs[i]);
+
+        /* Derive the projection on the read variables and the widths from the meta */
+        size_t depth = 0;
+        for (MDD m = metas[i]; m > lddmc_true; m = lddmc_getdown(m)) depth++;
+        uint32_t proj[depth+1];
+        size_t k = 0;
+        l.read_widths[i] = l.widths[i] = 0;
+        for (MDD m = metas[i]; m > lddmc_true; m = lddmc_getdown(m)) {
+            const uint32_t v = lddmc_getvalue(m);
+            if (v == (uint32_t)-1) break;
+            assert(v <= 4);
+            if (v != 0) l.widths[i]++;
+            if (v == 1 || v == 3) { proj[k++] = 1; l.read_widths[i]++; }
+            else if (v == 0 || v == 4) proj[k++] = 0;
+        }
+        proj[k++] = (uint32_t)-2;
+        l.projs[i] = lddmc_cube(proj, k);
+    }
+
+    MDD visited = initial, frontier = initial;
+    lddmc_refs_pushptr(&visited);
+    lddmc_refs_pushptr(&frontier);
+
+    while (frontier != lddmc_false) {
+        CALL(lddmc_learn_par, &l, frontier, 0, count);
+        MDD next = CALL(lddmc_learn_image, &l, frontier, visited, 0, count);
+        lddmc_refs_push(next);
+        frontier = CALL(lddmc_minus, next, visited);
+        visited = next;
+        lddmc_refs_pop(1);
+    }
+
+    lddmc_refs_popptr(3*count+2);
+    free(l.projs);
+    free(l.learned);
+    free(l.read_widths);
+    free(l.widths);
+    return visited;
+}
+
 struct lddmc_match_sat_info
 {
     MDD mdd;
@@ -2407,79 +3697,39 @@ lddmc_print(MDD mdd)
  * SERIALIZATION
  */
 
-struct lddmc_ser {
-    MDD mdd;
-    size_t assigned;
-};
-
-// Define a AVL tree type with prefix 'lddmc_ser' holding
-// nodes of struct lddmc_ser with the following compare() function...
-AVL(lddmc_ser, struct lddmc_ser)
-{
-    if (left->mdd > right->mdd) return 1;
-    if (left->mdd < right->mdd) return -1;
-    return 0;
-}
-
-// Define a AVL tree type with prefix 'lddmc_ser_reversed' holding
-// nodes of struct lddmc_ser with the following compare() function...
-AVL(lddmc_ser_reversed, struct lddmc_ser)
+static void
+lddmc_ser_children(uint64_t node, uint64_t *children)
 {
-    if (left->assigned > right->assigned) return 1;
-    if (left->assigned < right->assigned) return -1;
-    return 0;
+    mddnode_t n = LDD_GETNODE(node);
+    const MDD down = mddnode_getdown(n);
+    const MDD right = mddnode_getright(n);
+    children[0] = down > lddmc_true ? down : 0;
+    children[1] = right > lddmc_true ? right : 0;
 }
 
-// Initially, both sets are empty
-static avl_node_t *lddmc_ser_set = NULL;
-static avl_node_t *lddmc_ser_reversed_set = NULL;
-
-// Start counting (assigning numbers to MDDs) at 2
-static volatile size_t lddmc_ser_counter = 2;
+// The index of serialized nodes (see sylvan_ser.h), numbered from 2
+static ser_index_t lddmc_ser_index;
 static size_t lddmc_ser_done = 0;
 
-// Given a MDD, assign unique numbers to all nodes
-static size_t
-lddmc_serialize_assign_rec(MDD mdd)
+static ser_index_t*
+lddmc_ser(void)
 {
-    if (mdd <= lddmc_true) return mdd;
-
-    mddnode_t n = LDD_GETNODE(mdd);
-
-    struct lddmc_ser s, *ss;
-    s.mdd = mdd;
-    ss = lddmc_ser_search(lddmc_ser_set, &s);
-    if (ss == NULL) {
-        // assign dummy value
-        s.assigned = 0;
-        ss = lddmc_ser_put(&lddmc_ser_set, &s, NULL);
-
-        // first assign recursively
-        lddmc_serialize_assign_rec(mddnode_getright(n));
-        lddmc_serialize_assign_rec(mddnode_getdown(n));
-
-        // assign real value
-        ss->assigned = lddmc_ser_counter++;
-
-        // put a copy in the reversed table
-        lddmc_ser_reversed_insert(&lddmc_ser_reversed_set, ss);
-    }
-
-    return ss->assigned;
+    if (lddmc_ser_index.table == NULL) ser_index_create(&lddmc_ser_index, 2, lddmc_ser_children);
+    return &lddmc_ser_index;
 }
 
 size_t
 lddmc_serialize_add(MDD mdd)
 {
-    return lddmc_serialize_assign_rec(mdd);
+    if (mdd <= lddmc_true) return mdd;
+    LACE_ME;
+    return CALL(ser_index_add, lddmc_ser(), mdd);
 }
 
 void
 lddmc_serialize_reset()
 {
-    lddmc_ser_free(&lddmc_ser_set);
-    lddmc_ser_free(&lddmc_ser_reversed_set);
-    lddmc_ser_counter = 2;
+    ser_index_free(&lddmc_ser_index);
     lddmc_ser_done = 0;
 }
 
@@ -2487,83 +3737,80 @@ size_t
 lddmc_serialize_get(MDD mdd)
 {
     if (mdd <= lddmc_true) return mdd;
-    struct lddmc_ser s, *ss;
-    s.mdd = mdd;
-    ss = lddmc_ser_search(lddmc_ser_set, &s);
-    assert(ss != NULL);
-    return ss->assigned;
+    size_t value = ser_index_get(lddmc_ser(), mdd);
+    assert(value != 0);
+    return value;
 }
 
 MDD
 lddmc_serialize_get_reversed(size_t value)
 {
     if ((MDD)value <= lddmc_true) return (MDD)value;
-    struct lddmc_ser s, *ss;
-    s.assigned = value;
-    ss = lddmc_ser_reversed_search(lddmc_ser_reversed_set, &s);
-    assert(ss != NULL);
-    return ss->mdd;
+    return ser_index_get_reversed(lddmc_ser(), value);
 }
 
 void
 lddmc_serialize_totext(FILE *out)
 {
-    avl_iter_t *it = lddmc_ser_reversed_iter(lddmc_ser_reversed_set);
-    struct lddmc_ser *s;
+    ser_index_t *idx = lddmc_ser();
 
     fprintf(out, "[");
-    while ((s=lddmc_ser_reversed_iter_next(it))) {
-        MDD mdd = s->mdd;
+    for (size_t i=0; i<idx->count; i++) {
+        MDD mdd = idx->nodes[i];
         mddnode_t n = LDD_GETNODE(mdd);
-        fprintf(out, "(%zu,v=%u,d=%zu,r=%zu),", s->assigned,
+        fprintf(out, "(%zu,v=%u,d=%zu,r=%zu),", idx->first+i,
                                                 mddnode_getvalue(n),
                                                 lddmc_serialize_get(mddnode_getdown(n)),
                                                 lddmc_serialize_get(mddnode_getright(n)));
     }
     fprintf(out, "]");
+}
 
-    lddmc_ser_reversed_iter_free(it);
+/**
+ * Encode the <count> nodes in <mdds> in <buffer> (in parallel)
+ */
+VOID_TASK_3(lddmc_serialize_encode, struct mddnode*, buffer, const MDD*, mdds, size_t, count)
+{
+    if (count > 1024) {
+        SPAWN(lddmc_serialize_encode, buffer, mdds, count/2);
+        CALL(lddmc_serialize_encode, buffer+count/2, mdds+count/2, count-count/2);
+        SYNC(lddmc_serialize_encode);
+        return;
+    }
+    for (size_t i=0; i<count; i++) {
+        mddnode_t n = LDD_GETNODE(mdds[i]);
+        uint64_t right = lddmc_serialize_get(mddnode_getright(n));
+        uint64_t down = lddmc_serialize_get(mddnode_getdown(n));
+        if (mddnode_getcopy(n)) mddnode_makecopy(&buffer[i], right, down);
+        else mddnode_make(&buffer[i], mddnode_getvalue(n), right, down);
+    }
 }
 
 void
 lddmc_serialize_tofile(FILE *out)
 {
-    size_t count = avl_count(lddmc_ser_reversed_set);
-    assert(count >= lddmc_ser_done);
-    assert(count == lddmc_ser_counter-2);
-    count -= lddmc_ser_done;
-    fwrite(&count, sizeof(size_t), 1, out);
+    LACE_ME;
 
-    struct lddmc_ser *s;
-    avl_iter_t *it = lddmc_ser_reversed_iter(lddmc_ser_reversed_set);
+    ser_index_t *idx = lddmc_ser();
+    assert(idx->count >= lddmc_ser_done);
+    size_t count = idx->count - lddmc_ser_done;
+    fwrite(&count, sizeof(size_t), 1, out);
 
-    /* Skip already written entries */
-    size_t index = 0;
-    while (index < lddmc_ser_done && (s=lddmc_ser_reversed_iter_next(it))) {
-        assert(s->assigned == index+2);
-        index++;
+    /* Write the new entries in chunks */
+    const size_t chunk = 1<<16;
+    struct mddnode *buffer = (struct mddnode*)malloc(sizeof(struct mddnode[chunk]));
+    if (buffer == NULL) {
+        fprintf(stderr, "lddmc_serialize_tofile: Unable to allocate memory!\n");
+        exit(1);
     }
-
-    while ((s=lddmc_ser_reversed_iter_next(it))) {
-        assert(s->assigned == index+2);
-        index++;
-
-        mddnode_t n = LDD_GETNODE(s->mdd);
-
-        struct mddnode node;
-        uint64_t right = lddmc_serialize_get(mddnode_getright(n));
-        uint64_t down = lddmc_serialize_get(mddnode_getdown(n));
-        if (mddnode_getcopy(n)) mddnode_makecopy(&node, right, down);
-        else mddnode_make(&node, mddnode_getvalue(n), right, down);
-
-        assert(right <= index);
-        assert(down <= index);
-
-        fwrite(&node, sizeof(struct mddnode), 1, out);
+    for (size_t i=lddmc_ser_done; i<idx->count; i+=chunk) {
+        const size_t n = idx->count-i < chunk ? idx->count-i : chunk;
+        CALL(lddmc_serialize_encode, buffer, idx->nodes+i, n);
+        fwrite(buffer, sizeof(struct mddnode), n, out);
     }
+    free(buffer);
 
-    lddmc_ser_done = lddmc_ser_counter-2;
-    lddmc_ser_reversed_iter_free(it);
+    lddmc_ser_done = idx->count;
 }
 
 void
@@ -2576,6 +3823,8 @@ lddmc_serialize_fromfile(FILE *in)
         exit(-1);
     }
 
+    ser_index_t *idx = lddmc_ser();
+
     for (i=1; i<=count; i++) {
         struct mddnode node;
         if (fread(&node, sizeof(struct mddnode), 1, in) != 1) {
@@ -2590,25 +3839,19 @@ lddmc_serialize_fromfile(FILE *in)
         MDD right = lddmc_serialize_get_reversed(mddnode_getright(&node));
         MDD down = lddmc_serialize_get_reversed(mddnode_getdown(&node));
 
-        struct lddmc_ser s;
-        if (mddnode_getcopy(&node)) s.mdd = lddmc_make_copynode(down, right);
-        else s.mdd = lddmc_makenode(mddnode_getvalue(&node), down, right);
-        s.assigned = lddmc_ser_done+2; // starts at 0 but we want 2-based...
+        MDD mdd;
+        if (mddnode_getcopy(&node)) mdd = lddmc_make_copynode(down, right);
+        else mdd = lddmc_makenode(mddnode_getvalue(&node), down, right);
+        ser_index_put(idx, mdd);
         lddmc_ser_done++;
-
-        lddmc_ser_insert(&lddmc_ser_set, &s);
-        lddmc_ser_reversed_insert(&lddmc_ser_reversed_set, &s);
     }
 }
 
 VOID_TASK_IMPL_0(lddmc_gc_mark_serialize)
 {
-    struct lddmc_ser *s;
-    avl_iter_t *it = lddmc_ser_iter(lddmc_ser_set);
-
     /* Iterate through nodes in serialization */
-    while ((s=lddmc_ser_iter_next(it))) {
-        CALL(lddmc_gc_mark_rec, s->mdd);
+    for (size_t i=0; i<lddmc_ser_index.count; i++) {
+        CALL(lddmc_gc_mark_rec, lddmc_ser_index.nodes[i]);
     }
 }
 
@@ -52,6 +52,17 @@ MDD lddmc_make_copynode(MDD ifeq, MDD ifneq);
 int lddmc_iscopy(MDD mdd);
 MDD lddmc_followcopy(MDD mdd);
 
+/**
+ * Wide levels.
+ * A level of an LDD is a chain of nodes linked by right edges, which lddmc_follow and the operations
+ * that match two levels (lddmc_match, lddmc_relprod, lddmc_relprev, lddmc_join) walk one node at a time.
+ * With lddmc_set_wide_levels(<width>), every worker indexes the levels of at least <width> nodes
+ * that it searches: a sorted array of the values of the level and their nodes, searched by binary search.
+ * The index is transparent to all operations, and is discarded at garbage collection.
+ * Width 0 (the default) disables the index. Call this function when no LDD operations are running.
+ */
+void lddmc_set_wide_levels(size_t width);
+
 /**
  * Infrastructure for external references using a hash table.
  * Two hash tables store external references: a pointers table and a values table.
@@ -125,12 +136,103 @@ MDD lddmc_union_cube_copy(MDD a, uint32_t* values, int* copy, size_t count);
 int lddmc_member_cube_copy(MDD a, uint32_t* values, int* copy, size_t count);
 MDD lddmc_cube_copy(uint32_t* values, int* copy, size_t count);
 
+/**
+ * Create the LDD of the <n> vectors of length <len> stored consecutively in <states>,
+ * which must be sorted lexicographically (duplicates are allowed).
+ * The LDD is built bottom-up in one pass, creating the subtrees of different values in parallel.
+ */
+TASK_DECL_3(MDD, lddmc_from_sorted, const uint32_t*, size_t, size_t);
+#define lddmc_from_sorted(states, n, len) CALL(lddmc_from_sorted, states, n, len)
+
+/**
+ * Same as lddmc_from_sorted, but first sorts <states> in place (using parallel merge sort).
+ */
+TASK_DECL_3(MDD, lddmc_from_unsorted, uint32_t*, size_t, size_t);
+#define lddmc_from_unsorted(states, n, len) CALL(lddmc_from_unsorted, states, n, len)
+
+/**
+ * Convert between LDDs of sets and BDDs.
+ * The value on level i of the LDD (of <levels> levels) is encoded with <bits_per_level>[i] bits,
+ * most significant bit first, using the next BDD variables of the set <variables>.
+ * The set <variables> contains the sum of <bits_per_level> variables, for example consecutive
+ * variables starting at some offset, or only the even variables to interleave with next-state variables.
+ * Independent subtrees are converted in parallel, and results are cached.
+ */
+TASK_DECL_4(BDD, lddmc_to_bdd, MDD, const uint32_t*, size_t, BDDSET);
+#define lddmc_to_bdd(mdd, bits_per_level, levels, variables) CALL(lddmc_to_bdd, mdd, bits_per_level, levels, variables)
+
+TASK_DECL_4(MDD, bdd_to_lddmc, BDD, const uint32_t*, size_t, BDDSET);
+#define bdd_to_lddmc(bdd, bits_per_level, levels, variables) CALL(bdd_to_lddmc, bdd, bits_per_level, levels, variables)
+
+/**
+ * Swap the <n1> levels starting at level <level> of <mdd> with the <n2> levels that follow them.
+ * The order of the levels within each block is kept, so copy nodes (in the write levels of a
+ * relation) stay below their read level when the read and write levels are in the same block.
+ */
+TASK_DECL_4(MDD, lddmc_swap_levels, MDD, uint32_t, uint32_t, uint32_t);
+#define lddmc_swap_levels(mdd, level, n1, n2) CALL(lddmc_swap_levels, mdd, level, n1, n2)
+
+/**
+ * Reorder the <vars> state variables with sifting (Rudell), to reduce the total number of nodes
+ * of the <set_count> sets in <sets> and the <rel_count> relations in <relations>.
+ * Every set has one level for every state variable. Every relation has a meta LDD in <metas>,
+ * as for lddmc_relprod; the levels of the relation move with the state variables.
+ * The array <order> holds the original variable at every level and is updated with the new order.
+ * The sets, relations and metas are replaced by the reordered LDDs.
+ * The size is the sum of the numbers of nodes of the sets and relations (see lddmc_nodecount).
+ * A variable stops moving in one direction when the size grows beyond <max_growth> times
+ * the smallest size seen (for example 1.2). Returns the size after sifting.
+ */
+size_t lddmc_sift(size_t vars, uint32_t *order, MDD *sets, size_t set_count, MDD *relations, MDD *metas, size_t rel_count, double max_growth);
+
+/**
+ * Caching policies for LDD operations.
+ * By default, the LDD operations use the operation cache for every node, including every node
+ * along the right edges of a level. Wide levels then fill the cache with entries that are rarely reused.
+ * A policy restricts which subproblems of an operation use the cache:
+ * - LDDMC_CACHE_ALL: all subproblems (the default)
+ * - LDDMC_CACHE_DOWN: only subproblems reached by a down edge, not along the right edges of a level
+ * - LDDMC_CACHE_EVERY: only subproblems on every <k>-th level, starting with the first level
+ * - LDDMC_CACHE_TOP: only subproblems on the first <k> levels, where the subproblems are largest
+ * Levels are counted from the top of the operands of the operation call.
+ * In adaptive mode (see sylvan_set_adaptive_granularity), the adaptive granularity applies as well.
+ */
+typedef enum lddmc_cache_op {
+    LDDMC_UNION,
+    LDDMC_MINUS,
+    LDDMC_RELPROD,
+    LDDMC_RELPROD_UNION,
+    LDDMC_PROJECT,
+    LDDMC_CACHE_OPS
+} lddmc_cache_op_t;
+
+typedef enum lddmc_cache_policy {
+    LDDMC_CACHE_ALL,
+    LDDMC_CACHE_DOWN,
+    LDDMC_CACHE_EVERY,
+    LDDMC_CACHE_TOP
+} lddmc_cache_policy_t;
+
+void lddmc_set_cache_policy(lddmc_cache_op_t op, lddmc_cache_policy_t policy, uint32_t k);
+
 TASK_DECL_3(MDD, lddmc_relprod, MDD, MDD, MDD);
 #define lddmc_relprod(a, b, proj) CALL(lddmc_relprod, a, b, proj)
 
 TASK_DECL_4(MDD, lddmc_relprod_union, MDD, MDD, MDD, MDD);
 #define lddmc_relprod_union(a, b, meta, un) CALL(lddmc_relprod_union, a, b, meta, un)
 
+/**
+ * Compute the states reachable from <set> with the <count> transition relations <relations>,
+ * using saturation. Each relation has a meta LDD in <metas>, as for lddmc_relprod.
+ * The relations are grouped by the first variable that they read or write. Every group is
+ * applied until a fixpoint is reached, after saturating the subtrees with the groups below.
+ * Subtrees above the first variable of a group are saturated in parallel.
+ * The results for every subtree are stored in the operation cache, and reused in later calls
+ * with the same relations (in any order).
+ */
+TASK_DECL_4(MDD, lddmc_saturate, MDD, const MDD*, const MDD*, int);
+#define lddmc_saturate(set, relations, metas, count) CALL(lddmc_saturate, set, relations, metas, count)
+
 /**
  * Calculate all predecessors to a in uni according to rel[proj]
  * <proj> follows the same semantics as relprod
@@ -178,6 +280,14 @@ TASK_DECL_1(lddmc_satcount_double_t, lddmc_satcount_cached, MDD);
 TASK_DECL_1(long double, lddmc_satcount, MDD);
 #define lddmc_satcount(mdd) CALL(lddmc_satcount, mdd)
 
+/**
+ * Calculate log2 of the number of vectors in the MDD (-INFINITY for lddmc_false).
+ * Uses the operation cache. Counts are added in the log domain, so the result does not overflow,
+ * even when lddmc_satcount_cached and lddmc_satcount do. See also lddmc_satcount_mpz (sylvan_gmp.h).
+ */
+TASK_DECL_1(double, lddmc_satcount_log2, MDD);
+#define lddmc_satcount_log2(mdd) CALL(lddmc_satcount_log2, mdd)
+
 /**
  * A callback for enumerating functions like sat_all_par, collect and match
  * Example:
@@ -191,6 +301,39 @@ LACE_TYPEDEF_CB(MDD, lddmc_collect_cb, uint32_t*, size_t, void*);
 VOID_TASK_DECL_5(lddmc_sat_all_par, MDD, lddmc_enum_cb, void*, uint32_t*, size_t);
 #define lddmc_sat_all_par(mdd, cb, context) CALL(lddmc_sat_all_par, mdd, cb, context, 0, 0)
 
+/**
+ * Enumerate all paths of <mdd> in batches. Every path must have <width> values.
+ * Subtrees are enumerated in parallel, and every worker fills its own buffer of <batch> cubes
+ * of <width> values. When a buffer is full (and at the end), <cb> is called with the buffer,
+ * the number of cubes in the buffer and the user-supplied context.
+ * The buffer is reused after <cb> returns.
+ * Different workers can call <cb> concurrently; <cb> must not spawn Lace tasks.
+ */
+LACE_TYPEDEF_CB(void, lddmc_batch_cb, uint32_t*, size_t, void*);
+VOID_TASK_DECL_5(lddmc_sat_all_batch, MDD, size_t, size_t, lddmc_batch_cb, void*);
+#define lddmc_sat_all_batch(mdd, width, batch, cb, context) CALL(lddmc_sat_all_batch, mdd, width, batch, cb, context)
+
+/**
+ * Reachability with on-the-fly learning of the transition relations, as in LTSmin.
+ * There are <count> transition groups, each with a meta LDD in <metas> (as for lddmc_relprod,
+ * using 0, 1, 2, 3, 4 and -1). The relations are learned from scratch and written to <relations>.
+ *
+ * In every iteration, the new states are projected on the variables read by every group (minus
+ * the short vectors seen before), the short vectors are enumerated in batches per worker, and <cb>
+ * is called for every short vector, in parallel. The callback gets the group, the short vector,
+ * an output buffer and <context>, and calls lddmc_learn_add(buffer, transition) for every transition,
+ * with the values in the order of the levels of the relation (one value for each meta value 1, 2, 3, 4).
+ * The transitions are added to the relation of the group with lddmc_from_unsorted, and the next
+ * states are computed with lddmc_relprod_union. The result is the set of reachable states.
+ * Different workers call <cb> concurrently; <cb> must not spawn Lace tasks.
+ */
+typedef struct lddmc_learn_buffer *lddmc_learn_buffer_t;
+void lddmc_learn_add(lddmc_learn_buffer_t buffer, const uint32_t *transition);
+
+LACE_TYPEDEF_CB(void, lddmc_next_cb, int, uint32_t*, lddmc_learn_buffer_t, void*);
+TASK_DECL_6(MDD, lddmc_learn_reachability, MDD, MDD*, const MDD*, int, lddmc_next_cb, void*);
+#define lddmc_learn_reachability(initial, relations, metas, count, cb, context) CALL(lddmc_learn_reachability, initial, relations, metas, count, cb, context)
+
 VOID_TASK_DECL_3(lddmc_sat_all_nopar, MDD, lddmc_enum_cb, void*);
 #define lddmc_sat_all_nopar(mdd, cb, context) CALL(lddmc_sat_all_nopar, mdd, cb, context)
 
@@ -231,16 +231,15 @@ VOID_TASK_2(mtbdd_refs_mark_s_par, mtbdd_refs_task_t, begin, size_t, count)
 {
     if (count < 32) {
         while (count > 0) {
+            /* inlined tasks (lazy task creation) also hold a result, so check all tasks */
             Task *t = begin->t;
-            if (!TASK_IS_STOLEN(t)) return;
-            if (t->f == begin->f && TASK_IS_COMPLETED(t)) {
+            if (t->f == begin->f && (TASK_IS_INLINED(t) || TASK_IS_COMPLETED(t))) {
                 mtbdd_gc_mark_rec(*(MTBDD*)TASK_RESULT(t));
             }
             begin += 1;
             count -= 1;
         }
     } else {
-        if (!TASK_IS_STOLEN(begin->t)) return;
         SPAWN(mtbdd_refs_mark_s_par, begin, count / 2);
         CALL(mtbdd_refs_mark_s_par, begin + (count / 2), count - count / 2);
         SYNC(mtbdd_refs_mark_s_par);
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016-2017 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_int.h>
+
+#include <string.h>
+
+#ifndef cas
+#define cas(ptr, old, new) (__sync_bool_compare_and_swap((ptr),(old),(new)))
+#endif
+
+/**
+ * Every bucket of the hash table holds a node and a value. The value of a node in the index is its number.
+ * During ser_index_add, the value of a new node is ser_new plus the number of edges from new nodes to the
+ * node that are not yet processed. Empty buckets have value ser_new, so new nodes start with 0 edges.
+ * When all edges to a new node are processed, ser_ready and the key of its first edge are added (see ser_index_link).
+ * The table is grown when it is 3/4 full, and when a new node cannot be inserted within SER_PROBES buckets.
+ */
+static const uint64_t ser_new = 0x8000000000000000LL;
+static const uint64_t ser_ready = 0x4000000000000000LL;
+
+#define SER_PROBES 1024
+#define SER_GRAIN 256
+
+/* MurmurHash3 finalizer */
+static inline uint64_t
+ser_hash(uint64_t a)
+{
+    a ^= a >> 33;
+    a *= 0xff51afd7ed558ccdULL;
+    a ^= a >> 33;
+    a *= 0xc4ceb9fe1a85ec53ULL;
+    a ^= a >> 33;
+    return a;
+}
+
+/**
+ * Find the bucket of <node>. If <created> is not NULL, claim an empty bucket if <node> is not found
+ * and set *created. Returns NULL if <node> is not found (and no bucket could be claimed).
+ */
+static uint64_t*
+ser_table_find(ser_index_t *idx, uint64_t node, int *created)
+{
+    const size_t mask = idx->table_size - 1;
+    size_t i = ser_hash(node) & mask;
+    for (int n=0; n<SER_PROBES; n++, i=(i+1)&mask) {
+        uint64_t *bucket = idx->table + 2*i;
+        const uint64_t key = *(volatile uint64_t*)bucket;
+        if (key == node) return bucket;
+        if (key == 0) {
+            if (created == NULL) return NULL;
+            if (cas(bucket, 0, node)) {
+                *created = 1;
+                return bucket;
+            }
+            if (*(volatile uint64_t*)bucket == node) return bucket;
+        }
+    }
+    return NULL;
+}
+
+/* Lower the value of <bucket> to <value>, keeping the lowest number for nodes that are in the index twice */
+static inline void
+ser_bucket_set(uint64_t *bucket, uint64_t value)
+{
+    for (;;) {
+        uint64_t old = *(volatile uint64_t*)(bucket+1);
+        if (old <= value || cas(bucket+1, old, value)) return;
+    }
+}
+
+/* Insert nodes <from> to <from+count> of the index in the hash table */
+VOID_TASK_3(ser_table_fill, ser_index_t*, idx, size_t, from, size_t, count)
+{
+    if (count > SER_GRAIN) {
+        SPAWN(ser_table_fill, idx, from, count/2);
+        CALL(ser_table_fill, idx, from+count/2, count-count/2);
+        SYNC(ser_table_fill);
+        return;
+    }
+    for (size_t i=from; i<from+count; i++) {
+        int created = 0;
+        uint64_t *bucket = ser_table_find(idx, idx->nodes[i], &created);
+        if (bucket == NULL) idx->full = 1;
+        else ser_bucket_set(bucket, idx->first + i);
+    }
+}
+
+/* Rebuild the hash table from the nodes in the index, with at least <size> buckets */
+static void
+ser_table_rebuild(ser_index_t *idx, size_t size)
+{
+    LACE_ME;
+    while (size < 4*idx->count/3+1) size <<= 1;
+    for (;;) {
+        free(idx->table);
+        idx->table = (uint64_t*)malloc(sizeof(uint64_t[2*size]));
+        if (idx->table == NULL) {
+            fprintf(stderr, "ser_table_rebuild: Unable to allocate memory!\n");
+            exit(1);
+        }
+        idx->table_size = size;
+        for (size_t i=0; i<size; i++) {
+            idx->table[2*i] = 0;
+            idx->table[2*i+1] = ser_new;
+        }
+        idx->full = 0;
+        CALL(ser_table_fill, idx, 0, idx->count);
+        if (!idx->full) break;
+        size <<= 1;
+    }
+}
+
+/* Ensure that <count> more nodes fit in the nodes array */
+static void
+ser_nodes_reserve(ser_index_t *idx, size_t count)
+{
+    if (idx->count + count <= idx->nodes_size) return;
+    size_t size = idx->nodes_size < 1024 ? 1024 : idx->nodes_size;
+    while (size < idx->count + count) size <<= 1;
+    uint64_t *nodes = (uint64_t*)realloc(idx->nodes, sizeof(uint64_t[size]));
+    if (nodes == NULL) {
+        fprintf(stderr, "ser_nodes_reserve: Unable to allocate memory!\n");
+        exit(1);
+    }
+    idx->nodes = nodes;
+    idx->nodes_size = size;
+}
+
+void
+ser_index_create(ser_index_t *idx, size_t first, ser_children_cb children)
+{
+    memset(idx, 0, sizeof(ser_index_t));
+    idx->first = first;
+    idx->children = children;
+    ser_table_rebuild(idx, 1024);
+}
+
+void
+ser_index_free(ser_index_t *idx)
+{
+    free(idx->table);
+    free(idx->nodes);
+    memset(idx, 0, sizeof(ser_index_t));
+}
+
+size_t
+ser_index_get(ser_index_t *idx, uint64_t node)
+{
+    uint64_t *bucket = ser_table_find(idx, node, NULL);
+    return bucket == NULL ? 0 : bucket[1];
+}
+
+size_t
+ser_index_put(ser_index_t *idx, uint64_t node)
+{
+    if (4*(idx->count+1) > 3*idx->table_size) ser_table_rebuild(idx, 2*idx->table_size);
+    ser_nodes_reserve(idx, 1);
+    const size_t value = idx->first + idx->count;
+    idx->nodes[idx->count++] = node;
+    for (;;) {
+        int created = 0;
+        uint64_t *bucket = ser_table_find(idx, node, &created);
+        if (bucket != NULL) {
+            ser_bucket_set(bucket, value);
+            return value;
+        }
+        ser_table_rebuild(idx, 2*idx->table_size);
+    }
+}
+
+/**
+ * Claim all new nodes reachable from <node>, and count the edges from new nodes (if <from_new>).
+ */
+VOID_TASK_3(ser_index_visit, ser_index_t*, idx, uint64_t, node, int, from_new)
+{
+    if (node == 0 || idx->full) return;
+
+    int created = 0;
+    uint64_t *bucket = ser_table_find(idx, node, &created);
+    if (bucket == NULL) {
+        idx->full = 1;
+        return;
+    }
+
+    if (from_new && (bucket[1] & ser_new)) __sync_fetch_and_add(bucket+1, 1);
+    if (!created) return;
+    __sync_fetch_and_add(&idx->added, 1);
+
+    uint64_t children[2];
+    idx->children(node, children);
+    SPAWN(ser_index_visit, idx, children[0], 1);
+    CALL(ser_index_visit, idx, children[1], 1);
+    SYNC(ser_index_visit);
+}
+
+/**
+ * Process the new nodes <from> to <from+count> of <order>: remove their edges, and append the children
+ * that have no other unprocessed edges from new nodes to <order>.
+ */
+VOID_TASK_4(ser_index_round, ser_index_t*, idx, uint64_t*, order, size_t, from, size_t, count)
+{
+    if (count > SER_GRAIN) {
+        SPAWN(ser_index_round, idx, order, from, count/2);
+        CALL(ser_index_round, idx, order, from+count/2, count-count/2);
+        SYNC(ser_index_round);
+        return;
+    }
+    for (size_t i=from; i<from+count; i++) {
+        uint64_t children[2];
+        idx->children(order[i], children);
+        for (int c=0; c<2; c++) {
+            if (children[c] == 0) continue;
+            uint64_t *bucket = ser_table_find(idx, children[c], NULL);
+            assert(bucket != NULL);
+            if ((bucket[1] & ser_new) == 0) continue;
+            if (__sync_sub_and_fetch(bucket+1, 1) == ser_new) {
+                order[__sync_fetch_and_add(&idx->ordered, 1)] = children[c];
+            }
+        }
+    }
+}
+
+/**
+ * Give the children of the new nodes <from> to <from+count> of <order> that are in the next round the
+ * key of their first edge from this round, i.e., 2*i+c for child c of order[i]. This orders the next round
+ * by the structure of the DD only, and not by the location of the nodes in the nodes table.
+ */
+VOID_TASK_4(ser_index_link, ser_index_t*, idx, uint64_t*, order, size_t, from, size_t, count)
+{
+    if (count > SER_GRAIN) {
+        SPAWN(ser_index_link, idx, order, from, count/2);
+        CALL(ser_index_link, idx, order, from+count/2, count-count/2);
+        SYNC(ser_index_link);
+        return;
+    }
+    for (size_t i=from; i<from+count; i++) {
+        uint64_t children[2];
+        idx->children(order[i], children);
+        for (int c=0; c<2; c++) {
+            if (children[c] == 0) continue;
+            uint64_t *bucket = ser_table_find(idx, children[c], NULL);
+            assert(bucket != NULL);
+            const uint64_t key = ser_new | ser_ready | (2*i+c);
+            for (;;) {
+                uint64_t old = *(volatile uint64_t*)(bucket+1);
+                if (old != ser_new && ((old & ser_ready) == 0 || old <= key)) break;
+                if (cas(bucket+1, old, key)) break;
+            }
+        }
+    }
+}
+
+/**
+ * Replace the nodes <from> to <from+count> of <order> by their keys, or (if <decode>) the keys by the nodes.
+ */
+VOID_TASK_5(ser_index_key, ser_index_t*, idx, uint64_t*, order, size_t, from, size_t, count, int, decode)
+{
+    if (count > SER_GRAIN) {
+        SPAWN(ser_index_key, idx, order, from, count/2, decode);
+        CALL(ser_index_key, idx, order, from+count/2, count-count/2, decode);
+        SYNC(ser_index_key);
+        return;
+    }
+    for (size_t i=from; i<from+count; i++) {
+        if (decode) {
+            uint64_t children[2];
+            idx->children(order[order[i]>>1], children);
+            order[i] = children[order[i]&1];
+        } else {
+            uint64_t *bucket = ser_table_find(idx, order[i], NULL);
+            assert(bucket != NULL && (bucket[1] & ser_ready));
+            order[i] = bucket[1] & ~(ser_new | ser_ready);
+        }
+    }
+}
+
+/**
+ * Sort <count> keys in <keys> in parallel (merge sort), using <tmp> of the same size.
+ */
+static int
+ser_compare(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+VOID_TASK_3(ser_sort, uint64_t*, keys, uint64_t*, tmp, size_t, count)
+{
+    if (count <= 4096) {
+        qsort(keys, count, sizeof(uint64_t), ser_compare);
+        return;
+    }
+    const size_t half = count/2;
+    SPAWN(ser_sort, keys, tmp, half);
+    CALL(ser_sort, keys+half, tmp+half, count-half);
+    SYNC(ser_sort);
+
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < count) tmp[k++] = keys[i] <= keys[j] ? keys[i++] : keys[j++];
+    while (i < half) tmp[k++] = keys[i++];
+    while (j < count) tmp[k++] = keys[j++];
+    memcpy(keys, tmp, sizeof(uint64_t[count]));
+}
+
+/**
+ * Give the new nodes <from> to <from+count> of <order> their numbers, in the reverse order of <order>.
+ */
+VOID_TASK_4(ser_index_number, ser_index_t*, idx, uint64_t*, order, size_t, from, size_t, count)
+{
+    if (count > SER_GRAIN) {
+        SPAWN(ser_index_number, idx, order, from, count/2);
+        CALL(ser_index_number, idx, order, from+count/2, count-count/2);
+        SYNC(ser_index_number);
+        return;
+    }
+    for (size_t i=from; i<from+count; i++) {
+        const size_t pos = idx->count + idx->added - 1 - i;
+        uint64_t *bucket = ser_table_find(idx, order[i], NULL);
+        assert(bucket != NULL);
+        bucket[1] = idx->first + pos;
+        idx->nodes[pos] = order[i];
+    }
+}
+
+TASK_IMPL_2(size_t, ser_index_add, ser_index_t*, idx, uint64_t, node)
+{
+    /* Claim all new nodes; if the table is full, grow it and start over */
+    for (;;) {
+        idx->added = 0;
+        idx->full = 0;
+        CALL(ser_index_visit, idx, node, 0);
+        if (!idx->full) break;
+        ser_table_rebuild(idx, 2*idx->table_size);
+    }
+
+    const size_t added = idx->added;
+    if (added != 0) {
+        ser_nodes_reserve(idx, added);
+
+        /* Order the new nodes from the root, every node after all its new parents, one round at a time */
+        uint64_t *order = (uint64_t*)malloc(sizeof(uint64_t[added]));
+        uint64_t *tmp = (uint64_t*)malloc(sizeof(uint64_t[added]));
+        if (order == NULL || tmp == NULL) {
+            fprintf(stderr, "ser_index_add: Unable to allocate memory!\n");
+            exit(1);
+        }
+        order[0] = node;
+        idx->ordered = 1;
+        size_t from = 0, to = 1;
+        while (from < to) {
+            CALL(ser_index_round, idx, order, from, to-from);
+            const size_t next = idx->ordered;
+            CALL(ser_index_link, idx, order, from, to-from);
+            CALL(ser_index_key, idx, order, to, next-to, 0);
+            CALL(ser_sort, order+to, tmp, next-to);
+            CALL(ser_index_key, idx, order, to, next-to, 1);
+            from = to;
+            to = next;
+        }
+        assert(to == added);
+
+        /* Children get lower numbers than their parents */
+        CALL(ser_index_number, idx, order, 0, added);
+        idx->count += added;
+        free(tmp);
+        free(order);
+
+        if (4*idx->count > 3*idx->table_size) ser_table_rebuild(idx, 2*idx->table_size);
+    }
+
+    return ser_index_get(idx, node);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016-2017 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Do not include this file directly. Instead, include sylvan_int.h */
+
+#ifndef SYLVAN_SER_H
+#define SYLVAN_SER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Index of serialized nodes, used by sylvan_serialize_* and lddmc_serialize_*.
+ * Nodes are (40-bit) indices in the nodes table. They are numbered consecutively, starting at <first>.
+ * A hash table (linear probing, lock-free insertion) maps nodes to their numbers,
+ * and an array maps numbers to nodes.
+ *
+ * ser_index_add assigns numbers to all new nodes of a DD in parallel, in topological order:
+ * every node gets a higher number than its children. The nodes are ordered by their distance
+ * from the root (longest path) and within one distance by their first edge from the previous distance,
+ * so the numbers only depend on the structure of the DD and not on the number of workers.
+ */
+
+/* Write the (at most 2) children of <node> to <children>; write 0 for children that are not internal nodes */
+typedef void (*ser_children_cb)(uint64_t node, uint64_t *children);
+
+typedef struct ser_index
+{
+    uint64_t *table;            // buckets of (node, value)
+    size_t table_size;          // number of buckets (a power of 2)
+    uint64_t *nodes;            // nodes[i] has number first+i
+    size_t count;               // number of nodes in the index
+    size_t nodes_size;          // allocated size of nodes
+    size_t first;               // number of the first node
+    ser_children_cb children;
+
+    /* during ser_index_add */
+    volatile size_t added;      // number of new nodes
+    volatile size_t ordered;    // number of new nodes that are ordered
+    volatile int full;          // set when the hash table is full
+} ser_index_t;
+
+void ser_index_create(ser_index_t *idx, size_t first, ser_children_cb children);
+void ser_index_free(ser_index_t *idx);
+
+/* Add all nodes of the DD with internal node <node> and return the number of <node> */
+TASK_DECL_2(size_t, ser_index_add, ser_index_t*, uint64_t);
+
+/* Append a single node (whose children are already in the index) and return its number */
+size_t ser_index_put(ser_index_t *idx, uint64_t node);
+
+/* Return the number of internal node <node>, or 0 if <node> is not in the index */
+size_t ser_index_get(ser_index_t *idx, uint64_t node);
+
+/* Return the node with number <value> */
+static inline uint64_t
+ser_index_get_reversed(ser_index_t *idx, size_t value)
+{
+    assert(value >= idx->first && value < idx->first + idx->count);
+    return idx->nodes[value - idx->first];
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
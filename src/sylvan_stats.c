@@ -46,6 +46,8 @@ struct
     {1, BDD_NODES_REUSED, "MTBDD nodes reused"},
     {1, LDD_NODES_CREATED, "LDD nodes created"},
     {1, LDD_NODES_REUSED, "LDD nodes reused"},
+    {1, ZDD_NODES_CREATED, "ZDD nodes created"},
+    {1, ZDD_NODES_REUSED, "ZDD nodes reused"},
     {1, LLMSSET_LOOKUP, "Lookup iterations"},
     {4, 0, NULL}, /* trigger to report unique nodes and operation cache */
 
@@ -58,6 +60,8 @@ struct
     {2, BDD_AND_EXISTS, "BDD andexists"},
     {2, BDD_AND_PROJECT, "BDD andproject"},
     {2, BDD_RELNEXT, "BDD relnext"},
+    {2, BDD_RELNEXT_MULTI, "BDD relnext multi"},
+    {2, BDD_RELNEXT_RW, "BDD relnext rw"},
     {2, BDD_RELPREV, "BDD relprev"},
     {2, BDD_CLOSURE, "BDD closure"},
     {2, BDD_COMPOSE, "BDD compose"},
@@ -65,7 +69,11 @@ struct
     {2, BDD_CONSTRAIN, "BDD constrain"},
     {2, BDD_SUPPORT, "BDD support"},
     {2, BDD_SATCOUNT, "BDD satcount"},
+    {2, BDD_SATCOUNT_LOG2, "BDD satcount log2"},
+    {2, BDD_SUBSET_HEAVY, "BDD subset heavy"},
+    {2, BDD_SUBSET_SHORT, "BDD subset short"},
     {2, BDD_PATHCOUNT, "BDD pathcount"},
+    {2, BDD_SATURATE, "BDD saturate"},
     {2, BDD_ISBDD, "BDD isbdd"},
 
     {2, MTBDD_APPLY, "MTBDD binary apply"},
@@ -95,9 +103,21 @@ struct
     {2, LDD_MATCH, "LDD match"},
     {2, LDD_SATCOUNT, "LDD satcount"},
     {2, LDD_SATCOUNTL, "LDD satcountl"},
+    {2, LDD_SATCOUNT_LOG2, "LDD satcount log2"},
     {2, LDD_ZIP, "LDD zip"},
     {2, LDD_RELPROD_UNION, "LDD relprod_union"},
     {2, LDD_PROJECT_MINUS, "LDD project_minus"},
+    {2, LDD_SATURATE, "LDD saturate"},
+    {2, LDD_TO_BDD, "LDD to_bdd"},
+    {2, LDD_FROM_BDD, "LDD from_bdd"},
+    {2, LDD_SWAP_LEVELS, "LDD swap_levels"},
+
+    {2, ZDD_UNION, "ZDD union"},
+    {2, ZDD_INTERSECT, "ZDD intersect"},
+    {2, ZDD_DIFF, "ZDD diff"},
+    {2, ZDD_JOIN, "ZDD join"},
+    {2, ZDD_MEET, "ZDD meet"},
+    {2, ZDD_COUNT, "ZDD count"},
 
     {0, 0, "Garbage collection"},
     {1, SYLVAN_GC_COUNT, "GC executions"},
@@ -258,6 +278,12 @@ sylvan_stats_report(FILE *target)
             to_h(36ULL * cache_getsize(), buf);
             to_h(36ULL * cache_getmaxsize(), buf2);
             fprintf(target, "%-20s %s (max real) of %s (allocated virtual memory).\n", "Memory (cache)", buf, buf2);
+            size_t hwm = 0;
+            for (unsigned int w=0; w<lace_workers(); w++) {
+                size_t h = lace_deque_hwm(w);
+                if (h > hwm) hwm = h;
+            }
+            fprintf(target, "%-20s %'zu tasks (high water mark of all workers).\n", "Task deque", hwm);
         }
         i++;
     }
@@ -32,6 +32,8 @@ typedef enum {
     BDD_NODES_REUSED,
     LDD_NODES_CREATED,
     LDD_NODES_REUSED,
+    ZDD_NODES_CREATED,
+    ZDD_NODES_REUSED,
 
     /* BDD operations */
     OPCOUNTER(BDD_ITE),
@@ -51,6 +53,12 @@ typedef enum {
     OPCOUNTER(BDD_ISBDD),
     OPCOUNTER(BDD_SUPPORT),
     OPCOUNTER(BDD_PATHCOUNT),
+    OPCOUNTER(BDD_SATURATE),
+    OPCOUNTER(BDD_RELNEXT_MULTI),
+    OPCOUNTER(BDD_RELNEXT_RW),
+    OPCOUNTER(BDD_SATCOUNT_LOG2),
+    OPCOUNTER(BDD_SUBSET_HEAVY),
+    OPCOUNTER(BDD_SUBSET_SHORT),
 
     /* MTBDD operations */
     OPCOUNTER(MTBDD_APPLY),
@@ -81,9 +89,22 @@ typedef enum {
     OPCOUNTER(LDD_MATCH),
     OPCOUNTER(LDD_SATCOUNT),
     OPCOUNTER(LDD_SATCOUNTL),
+    OPCOUNTER(LDD_SATCOUNT_LOG2),
     OPCOUNTER(LDD_ZIP),
     OPCOUNTER(LDD_RELPROD_UNION),
     OPCOUNTER(LDD_PROJECT_MINUS),
+    OPCOUNTER(LDD_SATURATE),
+    OPCOUNTER(LDD_TO_BDD),
+    OPCOUNTER(LDD_FROM_BDD),
+    OPCOUNTER(LDD_SWAP_LEVELS),
+
+    /* ZDD operations */
+    OPCOUNTER(ZDD_UNION),
+    OPCOUNTER(ZDD_INTERSECT),
+    OPCOUNTER(ZDD_DIFF),
+    OPCOUNTER(ZDD_JOIN),
+    OPCOUNTER(ZDD_MEET),
+    OPCOUNTER(ZDD_COUNT),
 
     /* Other counters */
     SYLVAN_GC_COUNT,
@@ -0,0 +1,468 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016-2017 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sylvan_int.h>
+
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * Initialization. ZDD nodes are marked by the MTBDD garbage collection code,
+ * which does not recurse into the terminals 0 and 1, since they are always marked.
+ */
+
+void
+sylvan_init_zdd()
+{
+    sylvan_init_mtbdd();
+}
+
+/**
+ * Primitives
+ */
+
+ZDD
+zdd_makenode(uint32_t var, ZDD low, ZDD high)
+{
+    /* Zero-suppression */
+    if (high == zdd_false) return low;
+
+    struct mtbddnode n;
+    int created;
+
+    mtbddnode_makenode(&n, var, low, high);
+
+    uint64_t index = llmsset_lookup(nodes, n.a, n.b, &created);
+    if (index == 0) {
+        LACE_ME;
+
+        zdd_refs_push(low);
+        zdd_refs_push(high);
+        sylvan_gc();
+        zdd_refs_pop(2);
+
+        index = llmsset_lookup(nodes, n.a, n.b, &created);
+        if (index == 0) {
+            fprintf(stderr, "ZDD Unique table full, %zu of %zu buckets filled!\n", llmsset_count_marked(nodes), llmsset_get_size(nodes));
+            exit(1);
+        }
+    }
+
+    if (created) sylvan_stats_count(ZDD_NODES_CREATED);
+    else sylvan_stats_count(ZDD_NODES_REUSED);
+
+    return index;
+}
+
+uint32_t
+zdd_getvar(ZDD zdd)
+{
+    return mtbddnode_getvariable(MTBDD_GETNODE(zdd));
+}
+
+ZDD
+zdd_getlow(ZDD zdd)
+{
+    return mtbddnode_getlow(MTBDD_GETNODE(zdd));
+}
+
+ZDD
+zdd_gethigh(ZDD zdd)
+{
+    return mtbddnode_gethigh(MTBDD_GETNODE(zdd));
+}
+
+/**
+ * Constructors
+ */
+
+ZDD
+zdd_from_array(uint32_t *vars, size_t count)
+{
+    ZDD result = zdd_true;
+    for (size_t i=count; i>0; i--) result = zdd_makenode(vars[i-1], zdd_false, result);
+    return result;
+}
+
+ZDD
+zdd_powerset(uint32_t *vars, size_t count)
+{
+    ZDD result = zdd_true;
+    for (size_t i=count; i>0; i--) result = zdd_makenode(vars[i-1], result, result);
+    return result;
+}
+
+/**
+ * The variable of the top node, or 0xffffffff for the terminals (which are below all variables)
+ */
+static inline uint32_t
+zdd_topvar(ZDD zdd)
+{
+    return zdd_isconst(zdd) ? 0xffffffff : zdd_getvar(zdd);
+}
+
+/**
+ * Implementation of the binary operations
+ */
+
+TASK_IMPL_2(ZDD, zdd_union, ZDD, a, ZDD, b)
+{
+    /* Terminal cases */
+    if (a == b) return a;
+    if (a == zdd_false) return b;
+    if (b == zdd_false) return a;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_UNION);
+
+    /* Improve cache behavior */
+    if (a < b) { ZDD tmp=b; b=a; a=tmp; }
+
+    const uint32_t va = zdd_topvar(a);
+    const uint32_t vb = zdd_topvar(b);
+    const uint32_t level = va < vb ? va : vb;
+
+    /* Access cache */
+    ZDD result;
+    const int cachenow = cache_granularity_now(CACHE_ZDD_UNION, level, a, b);
+    if (cachenow && cache_get3_level(CACHE_ZDD_UNION, level, a, b, 0, &result)) {
+        sylvan_stats_count(ZDD_UNION_CACHED);
+        return result;
+    }
+
+    /* Perform recursive calculation */
+    if (va < vb) {
+        ZDD low = CALL(zdd_union, zdd_getlow(a), b);
+        result = zdd_makenode(va, low, zdd_gethigh(a));
+    } else if (vb < va) {
+        ZDD low = CALL(zdd_union, a, zdd_getlow(b));
+        result = zdd_makenode(vb, low, zdd_gethigh(b));
+    } else {
+        /* same top variable */
+        zdd_refs_spawn(SPAWN(zdd_union, zdd_getlow(a), zdd_getlow(b)));
+        ZDD high = CALL(zdd_union, zdd_gethigh(a), zdd_gethigh(b));
+        zdd_refs_push(high);
+        ZDD low = zdd_refs_sync(SYNC(zdd_union));
+        zdd_refs_pop(1);
+        result = zdd_makenode(level, low, high);
+    }
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_UNION, a, b, 0, result)) sylvan_stats_count(ZDD_UNION_CACHEDPUT);
+
+    return result;
+}
+
+TASK_IMPL_2(ZDD, zdd_intersect, ZDD, a, ZDD, b)
+{
+    /* Terminal cases */
+    if (a == b) return a;
+    if (a == zdd_false || b == zdd_false) return zdd_false;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_INTERSECT);
+
+    /* Improve cache behavior */
+    if (a < b) { ZDD tmp=b; b=a; a=tmp; }
+
+    const uint32_t va = zdd_topvar(a);
+    const uint32_t vb = zdd_topvar(b);
+    const uint32_t level = va < vb ? va : vb;
+
+    /* Access cache */
+    ZDD result;
+    const int cachenow = cache_granularity_now(CACHE_ZDD_INTERSECT, level, a, b);
+    if (cachenow && cache_get3_level(CACHE_ZDD_INTERSECT, level, a, b, 0, &result)) {
+        sylvan_stats_count(ZDD_INTERSECT_CACHED);
+        return result;
+    }
+
+    /* Perform recursive calculation (the sets with the top variable of only one side are dropped) */
+    if (va < vb) {
+        result = CALL(zdd_intersect, zdd_getlow(a), b);
+    } else if (vb < va) {
+        result = CALL(zdd_intersect, a, zdd_getlow(b));
+    } else {
+        zdd_refs_spawn(SPAWN(zdd_intersect, zdd_getlow(a), zdd_getlow(b)));
+        ZDD high = CALL(zdd_intersect, zdd_gethigh(a), zdd_gethigh(b));
+        zdd_refs_push(high);
+        ZDD low = zdd_refs_sync(SYNC(zdd_intersect));
+        zdd_refs_pop(1);
+        result = zdd_makenode(level, low, high);
+    }
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_INTERSECT, a, b, 0, result)) sylvan_stats_count(ZDD_INTERSECT_CACHEDPUT);
+
+    return result;
+}
+
+TASK_IMPL_2(ZDD, zdd_diff, ZDD, a, ZDD, b)
+{
+    /* Terminal cases */
+    if (a == b || a == zdd_false) return zdd_false;
+    if (b == zdd_false) return a;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_DIFF);
+
+    const uint32_t va = zdd_topvar(a);
+    const uint32_t vb = zdd_topvar(b);
+    const uint32_t level = va < vb ? va : vb;
+
+    /* Access cache */
+    ZDD result;
+    const int cachenow = cache_granularity_now(CACHE_ZDD_DIFF, level, a, b);
+    if (cachenow && cache_get3_level(CACHE_ZDD_DIFF, level, a, b, 0, &result)) {
+        sylvan_stats_count(ZDD_DIFF_CACHED);
+        return result;
+    }
+
+    /* Perform recursive calculation */
+    if (va < vb) {
+        ZDD low = CALL(zdd_diff, zdd_getlow(a), b);
+        result = zdd_makenode(va, low, zdd_gethigh(a));
+    } else if (vb < va) {
+        result = CALL(zdd_diff, a, zdd_getlow(b));
+    } else {
+        zdd_refs_spawn(SPAWN(zdd_diff, zdd_getlow(a), zdd_getlow(b)));
+        ZDD high = CALL(zdd_diff, zdd_gethigh(a), zdd_gethigh(b));
+        zdd_refs_push(high);
+        ZDD low = zdd_refs_sync(SYNC(zdd_diff));
+        zdd_refs_pop(1);
+        result = zdd_makenode(level, low, high);
+    }
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_DIFF, a, b, 0, result)) sylvan_stats_count(ZDD_DIFF_CACHEDPUT);
+
+    return result;
+}
+
+TASK_IMPL_2(ZDD, zdd_join, ZDD, a, ZDD, b)
+{
+    /* Terminal cases */
+    if (a == zdd_false || b == zdd_false) return zdd_false;
+    if (a == zdd_true) return b;
+    if (b == zdd_true) return a;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_JOIN);
+
+    /* Improve cache behavior */
+    if (a < b) { ZDD tmp=b; b=a; a=tmp; }
+
+    const uint32_t va = zdd_getvar(a);
+    const uint32_t vb = zdd_getvar(b);
+    const uint32_t level = va < vb ? va : vb;
+
+    /* Access cache */
+    ZDD result;
+    const int cachenow = cache_granularity_now(CACHE_ZDD_JOIN, level, a, b);
+    if (cachenow && cache_get3_level(CACHE_ZDD_JOIN, level, a, b, 0, &result)) {
+        sylvan_stats_count(ZDD_JOIN_CACHED);
+        return result;
+    }
+
+    /* Get cofactors (the cofactors of a ZDD without the top variable are the ZDD and false) */
+    const ZDD a0 = va == level ? zdd_getlow(a) : a;
+    const ZDD a1 = va == level ? zdd_gethigh(a) : zdd_false;
+    const ZDD b0 = vb == level ? zdd_getlow(b) : b;
+    const ZDD b1 = vb == level ? zdd_gethigh(b) : zdd_false;
+
+    /* low: a0 x b0, high: a1 x b1 + a1 x b0 + a0 x b1 */
+    zdd_refs_spawn(SPAWN(zdd_join, a0, b0));
+    zdd_refs_spawn(SPAWN(zdd_join, a1, b1));
+    zdd_refs_spawn(SPAWN(zdd_join, a1, b0));
+    ZDD h3 = CALL(zdd_join, a0, b1);
+    zdd_refs_push(h3);
+    ZDD h2 = zdd_refs_sync(SYNC(zdd_join));
+    zdd_refs_push(h2);
+    ZDD h1 = zdd_refs_sync(SYNC(zdd_join));
+    zdd_refs_push(h1);
+    ZDD low = zdd_refs_sync(SYNC(zdd_join));
+    zdd_refs_push(low);
+    ZDD high = CALL(zdd_union, h1, h2);
+    zdd_refs_push(high);
+    high = CALL(zdd_union, high, h3);
+    zdd_refs_pop(5);
+    result = zdd_makenode(level, low, high);
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_JOIN, a, b, 0, result)) sylvan_stats_count(ZDD_JOIN_CACHEDPUT);
+
+    return result;
+}
+
+TASK_IMPL_2(ZDD, zdd_meet, ZDD, a, ZDD, b)
+{
+    /* Terminal cases */
+    if (a == zdd_false || b == zdd_false) return zdd_false;
+    if (a == zdd_true || b == zdd_true) return zdd_true;
+
+    /* Test gc */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_MEET);
+
+    /* Improve cache behavior */
+    if (a < b) { ZDD tmp=b; b=a; a=tmp; }
+
+    const uint32_t va = zdd_getvar(a);
+    const uint32_t vb = zdd_getvar(b);
+    const uint32_t level = va < vb ? va : vb;
+
+    /* Access cache */
+    ZDD result;
+    const int cachenow = cache_granularity_now(CACHE_ZDD_MEET, level, a, b);
+    if (cachenow && cache_get3_level(CACHE_ZDD_MEET, level, a, b, 0, &result)) {
+        sylvan_stats_count(ZDD_MEET_CACHED);
+        return result;
+    }
+
+    if (va != vb) {
+        /* the top variable is in only one of the operands, so it is removed from every set */
+        const ZDD c = va < vb ? a : b;
+        const ZDD d = va < vb ? b : a;
+        zdd_refs_spawn(SPAWN(zdd_meet, zdd_getlow(c), d));
+        ZDD high = CALL(zdd_meet, zdd_gethigh(c), d);
+        zdd_refs_push(high);
+        ZDD low = zdd_refs_sync(SYNC(zdd_meet));
+        zdd_refs_push(low);
+        result = CALL(zdd_union, low, high);
+        zdd_refs_pop(2);
+    } else {
+        /* high: a1 x b1, low: a0 x b0 + a0 x b1 + a1 x b0 */
+        const ZDD a0 = zdd_getlow(a), a1 = zdd_gethigh(a);
+        const ZDD b0 = zdd_getlow(b), b1 = zdd_gethigh(b);
+        zdd_refs_spawn(SPAWN(zdd_meet, a1, b1));
+        zdd_refs_spawn(SPAWN(zdd_meet, a0, b0));
+        zdd_refs_spawn(SPAWN(zdd_meet, a0, b1));
+        ZDD l3 = CALL(zdd_meet, a1, b0);
+        zdd_refs_push(l3);
+        ZDD l2 = zdd_refs_sync(SYNC(zdd_meet));
+        zdd_refs_push(l2);
+        ZDD l1 = zdd_refs_sync(SYNC(zdd_meet));
+        zdd_refs_push(l1);
+        ZDD high = zdd_refs_sync(SYNC(zdd_meet));
+        zdd_refs_push(high);
+        ZDD low = CALL(zdd_union, l1, l2);
+        zdd_refs_push(low);
+        low = CALL(zdd_union, low, l3);
+        zdd_refs_pop(5);
+        result = zdd_makenode(level, low, high);
+    }
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_MEET, a, b, 0, result)) sylvan_stats_count(ZDD_MEET_CACHEDPUT);
+
+    return result;
+}
+
+/**
+ * Counting
+ */
+
+TASK_IMPL_1(double, zdd_count, ZDD, zdd)
+{
+    /* Terminal cases */
+    if (zdd == zdd_false) return 0.0;
+    if (zdd == zdd_true) return 1.0;
+
+    /* Perhaps execute garbage collection */
+    sylvan_gc_test();
+
+    sylvan_stats_count(ZDD_COUNT);
+
+    const uint32_t level = zdd_getvar(zdd);
+
+    union {
+        double d;
+        uint64_t s;
+    } hack;
+
+    /* Access cache */
+    const int cachenow = cache_granularity_now(CACHE_ZDD_COUNT, level, zdd, 0);
+    if (cachenow && cache_get3_level(CACHE_ZDD_COUNT, level, zdd, 0, 0, &hack.s)) {
+        sylvan_stats_count(ZDD_COUNT_CACHED);
+        return hack.d;
+    }
+
+    SPAWN(zdd_count, zdd_gethigh(zdd));
+    double low = CALL(zdd_count, zdd_getlow(zdd));
+    hack.d = low + SYNC(zdd_count);
+
+    /* Write to cache */
+    if (cachenow && cache_put3(CACHE_ZDD_COUNT, zdd, 0, 0, hack.s)) sylvan_stats_count(ZDD_COUNT_CACHEDPUT);
+
+    return hack.d;
+}
+
+int
+zdd_contains(ZDD zdd, uint32_t *vars, size_t count)
+{
+    size_t i = 0;
+    while (!zdd_isconst(zdd)) {
+        const uint32_t var = zdd_getvar(zdd);
+        /* variables of the set that are above the top variable cannot be in any set */
+        if (i < count && vars[i] < var) return 0;
+        if (i < count && vars[i] == var) {
+            zdd = zdd_gethigh(zdd);
+            i++;
+        } else {
+            zdd = zdd_getlow(zdd);
+        }
+    }
+    return zdd == zdd_true && i == count ? 1 : 0;
+}
+
+static size_t
+zdd_nodecount_mark(ZDD zdd)
+{
+    if (zdd_isconst(zdd)) return 0;
+    mtbddnode_t n = MTBDD_GETNODE(zdd);
+    if (mtbddnode_getmark(n)) return 0;
+    mtbddnode_setmark(n, 1);
+    return 1 + zdd_nodecount_mark(mtbddnode_getlow(n)) + zdd_nodecount_mark(mtbddnode_gethigh(n));
+}
+
+static void
+zdd_unmark_rec(ZDD zdd)
+{
+    if (zdd_isconst(zdd)) return;
+    mtbddnode_t n = MTBDD_GETNODE(zdd);
+    if (!mtbddnode_getmark(n)) return;
+    mtbddnode_setmark(n, 0);
+    zdd_unmark_rec(mtbddnode_getlow(n));
+    zdd_unmark_rec(mtbddnode_gethigh(n));
+}
+
+size_t
+zdd_nodecount(ZDD zdd)
+{
+    size_t result = zdd_nodecount_mark(zdd);
+    zdd_unmark_rec(zdd);
+    return result;
+}
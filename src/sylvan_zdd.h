@@ -0,0 +1,129 @@
+/*
+ * Copyright 2011-2016 Formal Methods and Tools, University of Twente
+ * Copyright 2016-2017 Tom van Dijk, Johannes Kepler University Linz
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Do not include this file directly. Instead, include sylvan.h */
+
+/**
+ * Zero-suppressed decision diagrams (ZDDs).
+ *
+ * A ZDD represents a family of sets of variables. A node (var, low, high) represents the sets
+ * of low (without var) and the sets of high with var added. Nodes with high == zdd_false
+ * are removed (zero-suppression), so variables that are absent from a set cost no nodes.
+ *
+ * ZDD nodes are stored in the nodes table with the same layout as MTBDD nodes, without
+ * complement edges, and with terminals 0 (the empty family) and 1 (the family {{}}).
+ * Therefore garbage collection, the internal reference stacks (mtbdd_refs_push etc)
+ * and external references (mtbdd_protect etc) are shared with the MTBDD implementation.
+ */
+
+#ifndef SYLVAN_ZDD_H
+#define SYLVAN_ZDD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef uint64_t ZDD;
+
+static const ZDD zdd_false = 0; // the empty family
+static const ZDD zdd_true = 1;  // the family containing only the empty set
+
+/* Initialize ZDD functionality (also initializes MTBDD functionality) */
+void sylvan_init_zdd(void);
+
+/* Primitives */
+ZDD zdd_makenode(uint32_t var, ZDD low, ZDD high);
+uint32_t zdd_getvar(ZDD zdd);
+ZDD zdd_getlow(ZDD zdd);
+ZDD zdd_gethigh(ZDD zdd);
+
+static inline int
+zdd_isconst(ZDD zdd)
+{
+    return zdd == zdd_true || zdd == zdd_false ? 1 : 0;
+}
+
+/**
+ * References, shared with the MTBDD implementation.
+ */
+#define zdd_protect             mtbdd_protect
+#define zdd_unprotect           mtbdd_unprotect
+#define zdd_ref                 mtbdd_ref
+#define zdd_deref               mtbdd_deref
+#define zdd_refs_pushptr        mtbdd_refs_pushptr
+#define zdd_refs_popptr         mtbdd_refs_popptr
+#define zdd_refs_push           mtbdd_refs_push
+#define zdd_refs_pop            mtbdd_refs_pop
+#define zdd_refs_spawn          mtbdd_refs_spawn
+#define zdd_refs_sync           mtbdd_refs_sync
+
+/**
+ * Create the family containing the single set of the <count> variables in <vars>.
+ */
+ZDD zdd_from_array(uint32_t *vars, size_t count);
+
+/**
+ * Create the family of all subsets of the <count> variables in <vars>.
+ */
+ZDD zdd_powerset(uint32_t *vars, size_t count);
+
+/**
+ * Operations on families of sets.
+ * - union:     A \cup B
+ * - intersect: A \cap B
+ * - diff:      A \setminus B
+ * - join:      { a \cup b | a in A, b in B }, also called the (unate) product
+ * - meet:      { a \cap b | a in A, b in B }
+ */
+TASK_DECL_2(ZDD, zdd_union, ZDD, ZDD);
+#define zdd_union(a, b) CALL(zdd_union, a, b)
+
+TASK_DECL_2(ZDD, zdd_intersect, ZDD, ZDD);
+#define zdd_intersect(a, b) CALL(zdd_intersect, a, b)
+
+TASK_DECL_2(ZDD, zdd_diff, ZDD, ZDD);
+#define zdd_diff(a, b) CALL(zdd_diff, a, b)
+
+TASK_DECL_2(ZDD, zdd_join, ZDD, ZDD);
+#define zdd_join(a, b) CALL(zdd_join, a, b)
+#define zdd_product(a, b) zdd_join(a, b)
+
+TASK_DECL_2(ZDD, zdd_meet, ZDD, ZDD);
+#define zdd_meet(a, b) CALL(zdd_meet, a, b)
+
+/**
+ * Count the number of sets in the family <zdd>.
+ */
+TASK_DECL_1(double, zdd_count, ZDD);
+#define zdd_count(zdd) CALL(zdd_count, zdd)
+
+/**
+ * Return 1 if the set of the <count> variables in <vars> is in the family <zdd>, 0 otherwise.
+ */
+int zdd_contains(ZDD zdd, uint32_t *vars, size_t count);
+
+/**
+ * Count the number of nodes of <zdd>, not counting the terminals.
+ * Not thread-safe.
+ */
+size_t zdd_nodecount(ZDD zdd);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif
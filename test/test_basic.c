@@ -8,8 +8,10 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <inttypes.h>
+#include <math.h>
 
 #include "sylvan.h"
+#include "sylvan_gmp.h"
 #include "test_assert.h"
 #include "sylvan_int.h"
 
@@ -39,6 +41,136 @@ rng(int low, int high)
     return low + uniform_deviate(xorshift_rand()) * (high-low);
 }
 
+TASK_1(uint64_t, test_lace_leaf, uint64_t, i)
+{
+    return i;
+}
+
+static int
+test_lace()
+{
+    LACE_ME;
+
+    /**
+     * Spawn more tasks than fit in the initial deque (which must grow)
+     */
+
+    const uint64_t n = 200000;
+    for (uint64_t i=0; i<n; i++) SPAWN(test_lace_leaf, i);
+    uint64_t sum = 0;
+    for (uint64_t i=0; i<n; i++) sum += SYNC(test_lace_leaf);
+    test_assert(sum == n*(n-1)/2);
+    test_assert(lace_deque_hwm(0) >= n);
+
+    /**
+     * Lazy task creation: most of these tasks are executed directly by SPAWN
+     */
+
+    lace_set_inline_threshold(4);
+    sum = 0;
+    for (uint64_t i=0; i<n; i++) SPAWN(test_lace_leaf, i);
+    for (uint64_t i=0; i<n; i++) sum += SYNC(test_lace_leaf);
+    test_assert(sum == n*(n-1)/2);
+    lace_set_inline_threshold(0);
+
+    /**
+     * RUN from a Lace worker executes the task directly
+     */
+
+    test_assert(RUN(test_lace_leaf, 42) == 42);
+
+    /**
+     * Tracing: only the last 4 events of the ring buffer are written
+     */
+
+    lace_trace_enable(4);
+    for (int i=0; i<3; i++) {
+        LACE_TRACE_BEGIN("first");
+        LACE_TRACE_END("first");
+    }
+    LACE_TRACE_BEGIN("second");
+    LACE_TRACE_END("second");
+    lace_trace_disable();
+    LACE_TRACE_BEGIN("third");
+
+    FILE *f = tmpfile();
+    lace_trace_write(f);
+    long size = ftell(f);
+    char buf[1024];
+    test_assert(size > 0 && size < (long)sizeof(buf));
+    rewind(f);
+    buf[fread(buf, 1, sizeof(buf)-1, f)] = 0;
+    fclose(f);
+    test_assert(strncmp(buf, "{\"traceEvents\":[", 16) == 0);
+    test_assert(strstr(buf, "\"name\":\"second\",\"ph\":\"E\"") != NULL);
+    test_assert(strstr(buf, "\"name\":\"first\",\"ph\":\"B\"") != NULL);
+    test_assert(strstr(buf, "\"name\":\"third\"") == NULL);
+    int events = 0;
+    for (char *p = buf; (p = strstr(p, "\"ts\":")) != NULL; p++) events++;
+    test_assert(events == 4);
+
+    /**
+     * Tracing again clears the buffers; spans of which the begin event was overwritten are left out
+     */
+
+    lace_trace_enable(4);
+    LACE_TRACE_BEGIN("outer");
+    LACE_TRACE_BEGIN("inner");
+    LACE_TRACE_END("inner");
+    LACE_TRACE_BEGIN("last");
+    LACE_TRACE_END("last");
+    LACE_TRACE_END("outer");
+    lace_trace_disable();
+
+    f = tmpfile();
+    lace_trace_write(f);
+    rewind(f);
+    buf[fread(buf, 1, sizeof(buf)-1, f)] = 0;
+    fclose(f);
+    test_assert(strstr(buf, "\"name\":\"last\",\"ph\":\"B\"") != NULL);
+    test_assert(strstr(buf, "\"name\":\"last\",\"ph\":\"E\"") != NULL);
+    test_assert(strstr(buf, "\"name\":\"first\"") == NULL);
+    test_assert(strstr(buf, "\"name\":\"inner\"") == NULL);
+    test_assert(strstr(buf, "\"name\":\"outer\"") == NULL);
+    events = 0;
+    for (char *p = buf; (p = strstr(p, "\"ts\":")) != NULL; p++) events++;
+    test_assert(events == 2);
+
+    return 0;
+}
+
+static void*
+test_lace_run_thread(void *arg)
+{
+    uint64_t *res = (uint64_t*)arg;
+    *res = RUN(test_lace_leaf, *res);
+    return NULL;
+}
+
+/**
+ * RUN from threads that are not Lace workers queues the tasks for the (background) workers
+ */
+static int
+test_lace_background()
+{
+    lace_init(2, 0);
+    lace_startup_background(0);
+
+    pthread_t threads[4];
+    uint64_t res[4];
+    for (int i=0; i<4; i++) {
+        res[i] = 100+i;
+        pthread_create(&threads[i], NULL, test_lace_run_thread, &res[i]);
+    }
+    for (int i=0; i<4; i++) pthread_join(threads[i], NULL);
+    for (int i=0; i<4; i++) test_assert(res[i] == (uint64_t)(100+i));
+    test_assert(RUN(test_lace_leaf, 42) == 42);
+
+    // lace_exit from a thread that is not a Lace worker stops the background workers
+    lace_exit();
+    return 0;
+}
+
 static int
 test_cache()
 {
@@ -256,6 +388,246 @@ test_cube()
     return 0;
 }
 
+/**
+ * Callbacks for batched enumeration: collect the cubes in a buffer
+ */
+typedef struct enum_batch_result {
+    pthread_mutex_t lock;
+    size_t width, count, max_batch;
+    uint32_t values[10240];
+} enum_batch_result_t;
+
+VOID_TASK_3(test_enum_batch_cb, void*, context, uint8_t*, buffer, size_t, count)
+{
+    enum_batch_result_t *r = (enum_batch_result_t*)context;
+    pthread_mutex_lock(&r->lock);
+    if (count > r->max_batch) r->max_batch = count;
+    for (size_t i=0; i<count*r->width; i++) r->values[r->count*r->width+i] = buffer[i];
+    r->count += count;
+    pthread_mutex_unlock(&r->lock);
+}
+
+VOID_TASK_3(test_ldd_batch_cb, uint32_t*, buffer, size_t, count, void*, context)
+{
+    enum_batch_result_t *r = (enum_batch_result_t*)context;
+    pthread_mutex_lock(&r->lock);
+    if (count > r->max_batch) r->max_batch = count;
+    memcpy(r->values + r->count*r->width, buffer, sizeof(uint32_t[count*r->width]));
+    r->count += count;
+    pthread_mutex_unlock(&r->lock);
+}
+
+int
+test_enum_batch()
+{
+    LACE_ME;
+
+    static enum_batch_result_t r;
+    pthread_mutex_init(&r.lock, NULL);
+
+    // every satisfying assignment of a random BDD is enumerated exactly once
+    BDDSET vars = sylvan_set_fromarray(((BDDVAR[]){0,1,2,3,4,5,6,7,8,9}), 10);
+    BDD bdd = make_random(0, 10);
+    r.width = 10;
+    r.count = r.max_batch = 0;
+    sylvan_enum_batch(bdd, vars, 7, TASK(test_enum_batch_cb), &r);
+    test_assert(r.count == (size_t)sylvan_satcount(bdd, vars));
+    test_assert(r.max_batch <= 7);
+    BDD found = sylvan_false;
+    for (size_t i=0; i<r.count; i++) {
+        uint8_t cube[10];
+        for (int j=0; j<10; j++) cube[j] = (uint8_t)r.values[i*10+j];
+        BDD c = sylvan_cube(vars, cube);
+        test_assert(sylvan_and(c, found) == sylvan_false);
+        test_assert(sylvan_and(c, bdd) == c);
+        found = sylvan_or(found, c);
+    }
+    test_assert(found == bdd);
+
+    // same for a random LDD
+    MDD mdd = make_random_ldd_set(5, 10, 100);
+    r.width = 5;
+    r.count = r.max_batch = 0;
+    lddmc_sat_all_batch(mdd, 5, 16, TASK(test_ldd_batch_cb), &r);
+    test_assert(r.count == (size_t)lddmc_satcount(mdd));
+    test_assert(r.max_batch <= 16);
+    MDD ldd_found = lddmc_false;
+    for (size_t i=0; i<r.count; i++) {
+        test_assert(lddmc_member_cube(mdd, r.values+i*5, 5));
+        ldd_found = lddmc_union_cube(ldd_found, r.values+i*5, 5);
+    }
+    test_assert(ldd_found == mdd);
+
+    pthread_mutex_destroy(&r.lock);
+    return 0;
+}
+
+int
+test_approx()
+{
+    LACE_ME;
+
+    BDD f = sylvan_or(make_random(0, 16), make_random(0, 16));
+    const size_t size = sylvan_nodecount(f);
+
+    // large enough thresholds give f itself
+    test_assert(sylvan_subset_heavy(f, size) == f);
+    test_assert(sylvan_subset_short(f, size) == f);
+    test_assert(sylvan_underapprox(f, size) == f);
+    test_assert(sylvan_overapprox(f, size) == f);
+
+    for (size_t threshold = 1; threshold < size; threshold = threshold*2+1) {
+        BDD heavy = sylvan_subset_heavy(f, threshold);
+        BDD shortp = sylvan_subset_short(f, threshold);
+        BDD under = sylvan_underapprox(f, threshold);
+        BDD over = sylvan_overapprox(f, threshold);
+
+        // under-approximations imply f, over-approximations are implied by f
+        test_assert(sylvan_diff(heavy, f) == sylvan_false);
+        test_assert(sylvan_diff(shortp, f) == sylvan_false);
+        test_assert(sylvan_diff(under, f) == sylvan_false);
+        test_assert(sylvan_diff(f, over) == sylvan_false);
+
+        // heavy-branch subsetting always keeps at least one path
+        if (f != sylvan_false) test_assert(heavy != sylvan_false);
+        if (threshold >= 17) test_assert(sylvan_nodecount(heavy) <= threshold);
+        test_assert(sylvan_nodecount(shortp) <= threshold);
+        test_assert(sylvan_nodecount(under) <= threshold);
+        test_assert(sylvan_nodecount(over) <= threshold);
+    }
+
+    return 0;
+}
+
+int
+test_many()
+{
+    LACE_ME;
+
+    // compare with a linear chain of binary operations
+    BDD arr[17];
+    BDD conj = sylvan_true, disj = sylvan_false;
+    for (int i=0; i<17; i++) {
+        arr[i] = make_random(0, 12);
+        conj = sylvan_and(conj, arr[i]);
+        disj = sylvan_or(disj, arr[i]);
+    }
+    test_assert(sylvan_and_many(arr, 17) == conj);
+    test_assert(sylvan_or_many(arr, 17) == disj);
+    test_assert(sylvan_and_many(arr, 1) == arr[0]);
+    test_assert(sylvan_and_many(arr, 0) == sylvan_true);
+    test_assert(sylvan_or_many(arr, 0) == sylvan_false);
+
+    arr[5] = sylvan_false;
+    test_assert(sylvan_and_many(arr, 17) == sylvan_false);
+    arr[5] = sylvan_true;
+    test_assert(sylvan_or_many(arr, 17) == sylvan_true);
+
+    // clauses of a formula in CNF
+    BDD clauses[12];
+    BDD cnf = sylvan_true;
+    for (int i=0; i<12; i++) {
+        clauses[i] = sylvan_or(sylvan_ithvar(i), sylvan_nithvar((i+1)%12));
+        cnf = sylvan_and(cnf, clauses[i]);
+    }
+    test_assert(sylvan_and_many(clauses, 12) == cnf);
+
+    // early quantification, compare with quantifying the conjunction
+    BDD conjuncts[8];
+    for (int i=0; i<8; i++) {
+        int first = rng(0, 16);
+        conjuncts[i] = make_random(first, first+4);
+    }
+    uint32_t qvars[10];
+    for (int i=0; i<10; i++) qvars[i] = 2*i+1;
+    BDD qset = sylvan_set_fromarray(qvars, 10);
+    test_assert(sylvan_and_exists_many(conjuncts, 8, qset) == sylvan_exists(sylvan_and_many(conjuncts, 8), qset));
+    test_assert(sylvan_and_exists_many(conjuncts, 1, qset) == sylvan_exists(conjuncts[0], qset));
+    test_assert(sylvan_and_exists_many(conjuncts, 8, sylvan_set_empty()) == sylvan_and_many(conjuncts, 8));
+    test_assert(sylvan_and_exists_many(conjuncts, 0, qset) == sylvan_true);
+    test_assert(sylvan_and_exists_many(clauses, 12, qset) == sylvan_exists(cnf, qset));
+
+    return 0;
+}
+
+int
+test_sample()
+{
+    LACE_ME;
+
+    // every satisfying assignment of a random BDD is drawn about equally often
+    BDDSET vars = sylvan_set_fromarray(((BDDVAR[]){0,1,2,3}), 4);
+    BDD bdd = make_random(0, 4);
+    if (bdd == sylvan_false) return 0;
+    const size_t k = 16000;
+    uint8_t *samples = (uint8_t*)malloc(k*4);
+    uint8_t *again = (uint8_t*)malloc(k*4);
+    test_assert(sylvan_sample(bdd, vars, k, 1234, samples));
+    size_t hits[16] = {0};
+    for (size_t i=0; i<k; i++) {
+        test_assert(sylvan_and(bdd, sylvan_cube(vars, samples+i*4)) != sylvan_false);
+        hits[samples[i*4]*8 + samples[i*4+1]*4 + samples[i*4+2]*2 + samples[i*4+3]]++;
+    }
+    const double expected = (double)k / sylvan_satcount(bdd, vars);
+    int drawn = 0;
+    for (int i=0; i<16; i++) {
+        if (hits[i] == 0) continue;
+        test_assert(hits[i] > 0.7*expected && hits[i] < 1.3*expected);
+        drawn++;
+    }
+    test_assert(drawn == (int)sylvan_satcount(bdd, vars));
+
+    // the samples only depend on the seed
+    test_assert(sylvan_sample(bdd, vars, k, 1234, again));
+    test_assert(memcmp(samples, again, k*4) == 0);
+
+    free(samples);
+    free(again);
+    return 0;
+}
+
+int
+test_satcount()
+{
+    LACE_ME;
+
+    // compare with satcount and pathcount on a random BDD
+    BDDSET vars = sylvan_set_fromarray(((BDDVAR[]){0,1,2,3,4,5,6,7,8,9}), 10);
+    BDD bdd = make_random(0, 10);
+    mpz_t count;
+    mpz_init(count);
+    sylvan_satcount_mpz(count, bdd, vars);
+    test_assert(mpz_get_d(count) == sylvan_satcount(bdd, vars));
+    if (bdd == sylvan_false) {
+        test_assert(sylvan_satcount_log2(bdd, vars) == -INFINITY);
+    } else {
+        test_assert(fabs(exp2(sylvan_satcount_log2(bdd, vars)) - mpz_get_d(count)) < 1e-6 * mpz_get_d(count));
+    }
+    sylvan_pathcount_mpz(count, bdd);
+    test_assert(mpz_get_d(count) == sylvan_pathcount(bdd));
+
+    // with 2000 variables, sylvan_satcount overflows
+    BDDVAR big[2000];
+    for (int i=0; i<2000; i++) big[i] = i;
+    vars = sylvan_set_fromarray(big, 2000);
+    bdd = sylvan_ithvar(1000);
+    sylvan_satcount_mpz(count, bdd, vars);
+    test_assert(mpz_sizeinbase(count, 2) == 2000);
+    test_assert(mpz_scan1(count, 0) == 1999);
+    test_assert(sylvan_satcount_log2(bdd, vars) == 1999.0);
+    sylvan_satcount_mpz(count, sylvan_or(bdd, sylvan_ithvar(1999)), vars);
+    test_assert(mpz_scan1(count, 0) == 1998 && mpz_popcount(count) == 2); // 2^1999 + 2^1998
+    mpz_clear(count);
+
+    // samples of a BDD with 2000 variables
+    uint8_t sample[2*2000];
+    test_assert(sylvan_sample(bdd, vars, 2, 42, sample));
+    test_assert(sample[1000] == 1 && sample[2000+1000] == 1);
+    test_assert(sylvan_sample(sylvan_false, vars, 2, 42, sample) == 0);
+
+    return 0;
+}
+
 static int
 test_operators()
 {
@@ -369,6 +741,126 @@ test_relprod()
     test_assert(sylvan_relprev(t, zeroes, all_vars_set) == zeroes);
     test_assert(sylvan_relnext(sylvan_not(zeroes), t, all_vars_set) == sylvan_false);
 
+    // relnext_multi is the union of relnext with every relation
+    BDD set = sylvan_project(make_random(0, 8), sylvan_set_fromarray(((BDDVAR[]){0,2,4,6}), 4));
+    BDD rels[4];
+    BDDSET rel_vars[4];
+    BDD expected = sylvan_false;
+    for (int i=0; i<4; i++) {
+        int first = 2*rng(0, 3);
+        rels[i] = make_random(first, first+4);
+        rel_vars[i] = sylvan_set_fromarray(((BDDVAR[]){first, first+1, first+2, first+3}), 4);
+        if (i == 3) {
+            rels[i] = make_random(0, 8);
+            rel_vars[i] = sylvan_false;
+        }
+        expected = sylvan_or(expected, sylvan_relnext(set, rels[i], rel_vars[i]));
+    }
+    test_assert(sylvan_relnext_multi(set, rels, rel_vars, 4) == expected);
+    test_assert(sylvan_relnext_multi(set, rels, rel_vars, 4) == expected);
+    test_assert(sylvan_relnext_multi(set, rels, rel_vars, 0) == sylvan_false);
+
+    // clustered relations have the same successors
+    BDD clusters[4];
+    BDDSET cluster_vars[4];
+    test_assert(sylvan_cluster_relations(rels, rel_vars, 4, 0, clusters, cluster_vars) == 4);
+    int n_clusters = sylvan_cluster_relations(rels, rel_vars, 4, 100000, clusters, cluster_vars);
+    test_assert(n_clusters >= 2 && n_clusters <= 3);
+    next = sylvan_false;
+    for (int i=0; i<n_clusters; i++) next = sylvan_or(next, sylvan_relnext(set, clusters[i], cluster_vars[i]));
+    test_assert(next == expected);
+    test_assert(sylvan_relnext_multi(set, clusters, cluster_vars, n_clusters) == expected);
+
+    // relations with only the s or only the t variable of a pair: (0,0) -> (0,1) and (1,0)
+    BDDSET pair_vars[3];
+    pair_vars[0] = sylvan_set_fromarray(((BDDVAR[]){3}), 1);
+    rels[0] = sylvan_ithvar(3);
+    pair_vars[1] = sylvan_set_fromarray(((BDDVAR[]){0,1,3}), 3);
+    rels[1] = sylvan_cube(pair_vars[1], (uint8_t[]){1,0,1});
+    pair_vars[2] = sylvan_set_fromarray(((BDDVAR[]){0,1}), 2);
+    rels[2] = sylvan_cube(pair_vars[2], (uint8_t[]){0,1});
+    BDDSET s_vars = sylvan_set_fromarray(((BDDVAR[]){0,2}), 2);
+    set = sylvan_cube(s_vars, (uint8_t[]){0,0});
+    expected = sylvan_or(sylvan_cube(s_vars, (uint8_t[]){0,1}), sylvan_cube(s_vars, (uint8_t[]){1,0}));
+    test_assert(sylvan_cluster_relations(rels, pair_vars, 3, 100000, clusters, cluster_vars) == 1);
+    test_assert(sylvan_relnext(set, clusters[0], cluster_vars[0]) == expected);
+
+    // relnext_rw without copy constraints: if bit 0 is set, set bit 1 and flip bit 2
+    set = sylvan_project(make_random(0, 6), vars_set);
+    t = sylvan_false;
+    t = sylvan_union_cube(t, all_vars_set, ((uint8_t[]){1,1,2,1,0,1}));
+    t = sylvan_union_cube(t, all_vars_set, ((uint8_t[]){1,1,2,1,1,0}));
+    BDDSET rw_vars = sylvan_set_fromarray(((BDDVAR[]){0,3,4,5}), 4);
+    BDD rw = sylvan_false;
+    rw = sylvan_union_cube(rw, rw_vars, ((uint8_t[]){1,1,0,1}));
+    rw = sylvan_union_cube(rw, rw_vars, ((uint8_t[]){1,1,1,0}));
+    BDDSET read_set = sylvan_set_fromarray(((BDDVAR[]){0,4}), 2);
+    BDDSET write_set = sylvan_set_fromarray(((BDDVAR[]){2,4}), 2);
+    test_assert(sylvan_relnext_rw(set, rw, read_set, write_set) == sylvan_relnext(set, t, all_vars_set));
+    test_assert(sylvan_relnext_rw(zeroes, rw, read_set, write_set) == sylvan_false);
+    test_assert(sylvan_relnext_rw(ones, rw, read_set, write_set) == sylvan_cube(vars_set, (uint8_t[]){1,1,0}));
+
+    return 0;
+}
+
+int
+test_saturate()
+{
+    LACE_ME;
+
+    // three bits; bit 0 can be set, bit i can be set if bit i-1 is set
+    BDDSET vars_set = sylvan_set_fromarray(((BDDVAR[]){0,2,4}), 3);
+    BDDSET rel_vars[3];
+    BDD rels[3];
+    rel_vars[0] = sylvan_set_fromarray(((BDDVAR[]){4,5,2,3}), 4);
+    rels[0] = sylvan_cube(rel_vars[0], (uint8_t[]){1,1,0,1});
+    rel_vars[1] = sylvan_set_fromarray(((BDDVAR[]){0,1}), 2);
+    rels[1] = sylvan_cube(rel_vars[1], (uint8_t[]){0,1});
+    rel_vars[2] = sylvan_set_fromarray(((BDDVAR[]){0,1,2,3}), 4);
+    rels[2] = sylvan_cube(rel_vars[2], (uint8_t[]){1,1,0,1});
+
+    BDD expected = sylvan_false;
+    expected = sylvan_union_cube(expected, vars_set, ((uint8_t[]){0,0,0}));
+    expected = sylvan_union_cube(expected, vars_set, ((uint8_t[]){1,0,0}));
+    expected = sylvan_union_cube(expected, vars_set, ((uint8_t[]){1,1,0}));
+    expected = sylvan_union_cube(expected, vars_set, ((uint8_t[]){1,1,1}));
+
+    BDD initial = sylvan_cube(vars_set, (uint8_t[]){0,0,0});
+    test_assert(sylvan_saturate(initial, rels, rel_vars, 3) == expected);
+    test_assert(sylvan_saturate(initial, rels, rel_vars, 3) == expected);
+    test_assert(sylvan_saturate(initial, rels, rel_vars, 1) == initial);
+    test_assert(sylvan_saturate(initial, rels, rel_vars, 0) == initial);
+
+    // a relation on all variables (variables is sylvan_false, as for sylvan_relnext)
+    BDDSET all_vars = sylvan_set_fromarray(((BDDVAR[]){0,1,2,3,4,5}), 6);
+    BDD all_rel = sylvan_cube(all_vars, (uint8_t[]){0,1,0,0,0,0});
+    all_rel = sylvan_union_cube(all_rel, all_vars, ((uint8_t[]){1,1,0,1,0,0}));
+    all_rel = sylvan_union_cube(all_rel, all_vars, ((uint8_t[]){1,1,1,1,0,1}));
+    BDDSET no_vars = sylvan_false;
+    test_assert(sylvan_saturate(initial, &all_rel, &no_vars, 1) == expected);
+    rels[1] = all_rel;
+    rel_vars[1] = sylvan_false;
+    test_assert(sylvan_saturate(initial, rels, rel_vars, 3) == expected);
+
+    // three integers 0..3; every relation increments one integer
+    MDD ldd_rels[3], ldd_metas[3];
+    for (int i=0; i<3; i++) {
+        ldd_rels[i] = lddmc_false;
+        for (uint32_t v=0; v<3; v++) ldd_rels[i] = lddmc_union_cube(ldd_rels[i], (uint32_t[]){v, v+1}, 2);
+        uint32_t meta[6] = {0, 0, 0, 0, 0, 0};
+        meta[i] = 1;
+        meta[i+1] = 2;
+        meta[i+2] = (uint32_t)-1;
+        ldd_metas[i] = lddmc_cube(meta, i+3);
+    }
+
+    MDD ldd_initial = lddmc_cube((uint32_t[]){0, 0, 0}, 3);
+    MDD reachable = lddmc_saturate(ldd_initial, ldd_rels, ldd_metas, 3);
+    test_assert(lddmc_satcount(reachable) == 64);
+    test_assert(lddmc_saturate(ldd_initial, ldd_rels, ldd_metas, 3) == reachable);
+    test_assert(lddmc_member_cube(reachable, (uint32_t[]){3, 0, 2}, 3));
+    test_assert(lddmc_satcount(lddmc_saturate(ldd_initial, ldd_rels+1, ldd_metas+1, 1)) == 4);
+
     return 0;
 }
 
@@ -419,6 +911,121 @@ test_compose()
     return 0;
 }
 
+/**
+ * Next-state function of a small model with 3 counters in 0..5, for learning reachability:
+ * group 0 increments x0, group 1 increments x1 below x0, group 2 increments x2 below x1,
+ * group 3 resets x1 (it reads no variables).
+ */
+static int
+test_learn_next_explicit(int group, const uint32_t *s, uint32_t *t)
+{
+    memcpy(t, s, sizeof(uint32_t[3]));
+    if (group == 0 && s[0] < 5) t[0] = s[0]+1;
+    else if (group == 1 && s[1] < s[0]) t[1] = s[1]+1;
+    else if (group == 2 && s[2] < s[1]) t[2] = s[2]+1;
+    else if (group == 3) t[1] = 0;
+    else return 0;
+    return 1;
+}
+
+VOID_TASK_4(test_learn_next_cb, int, group, uint32_t*, vector, lddmc_learn_buffer_t, buffer, void*, context)
+{
+    uint32_t s[3] = {0, 0, 0}, t[3];
+    if (group == 0) s[0] = vector[0];
+    if (group == 1) { s[0] = vector[0]; s[1] = vector[1]; }
+    if (group == 2) { s[1] = vector[0]; s[2] = vector[1]; }
+    if (!test_learn_next_explicit(group, s, t)) return;
+    if (group == 0) lddmc_learn_add(buffer, (uint32_t[]){s[0], t[0]});
+    if (group == 1) lddmc_learn_add(buffer, (uint32_t[]){s[0], s[1], t[1]});
+    if (group == 2) lddmc_learn_add(buffer, (uint32_t[]){s[1], s[2], t[2]});
+    if (group == 3) lddmc_learn_add(buffer, (uint32_t[]){0});
+    (void)context;
+}
+
+int
+test_ldd_reorder()
+{
+    LACE_ME;
+
+    // swapping blocks of levels back gives the original LDD
+    test_assert(lddmc_swap_levels(lddmc_cube((uint32_t[]){1,2,3}, 3), 0, 1, 1) == lddmc_cube((uint32_t[]){2,1,3}, 3));
+    for (int i=0; i<10; i++) {
+        MDD m = make_random_ldd_set(5, 4, 20);
+        test_assert(lddmc_swap_levels(lddmc_swap_levels(m, 1, 1, 1), 1, 1, 1) == m);
+        test_assert(lddmc_swap_levels(lddmc_swap_levels(m, 0, 2, 3), 0, 3, 2) == m);
+        test_assert(lddmc_satcount(lddmc_swap_levels(m, 2, 1, 2)) == lddmc_satcount(m));
+    }
+
+    // states with x0 == x4 and x1 == x3; the order 0,4,1,3,2 is better than 0,1,2,3,4
+    MDD sets[2] = {lddmc_false, lddmc_false};
+    lddmc_refs_pushptr(&sets[0]);
+    lddmc_refs_pushptr(&sets[1]);
+    uint32_t vecs[125][5];
+    for (int i=0; i<125; i++) {
+        uint32_t *vec = vecs[i];
+        vec[0] = vec[4] = i%5;
+        vec[1] = vec[3] = (i/5)%5;
+        vec[2] = i/25;
+        sets[0] = lddmc_union_cube(sets[0], vec, 5);
+    }
+
+    // relation 0: x1' = x3, x3' = x1 if x2 == 0; relation 1: x0' = x0 (copy node) and x4' = x4+1 if x0 == 0
+    MDD rels[2], metas[2], expected[2];
+    rels[0] = rels[1] = metas[0] = metas[1] = lddmc_false;
+    for (int i=0; i<2; i++) {
+        lddmc_refs_pushptr(&rels[i]);
+        lddmc_refs_pushptr(&metas[i]);
+    }
+    for (uint32_t a=0; a<5; a++) {
+        for (uint32_t b=0; b<5; b++) {
+            rels[0] = lddmc_union_cube(rels[0], (uint32_t[]){a,b,0,b,a}, 5);
+        }
+        rels[1] = lddmc_union_cube_copy(rels[1], (uint32_t[]){0,0,a,(a+1)%5}, (int[]){0,1,0,0}, 4);
+    }
+    metas[0] = lddmc_cube((uint32_t[]){0,1,2,3,1,2,(uint32_t)-1}, 7);
+    metas[1] = lddmc_cube((uint32_t[]){1,2,0,0,0,1,2,(uint32_t)-1}, 8);
+    for (int i=0; i<2; i++) expected[i] = lddmc_relprod(sets[0], rels[i], metas[i]);
+    sets[1] = lddmc_union(expected[0], expected[1]);
+
+    size_t before = lddmc_nodecount(sets[0]) + lddmc_nodecount(sets[1]) + lddmc_nodecount(rels[0]) + lddmc_nodecount(rels[1]);
+    uint32_t order[5] = {0,1,2,3,4};
+    size_t after = lddmc_sift(5, order, sets, 2, rels, metas, 2, 1.2);
+    test_assert(after < before);
+
+    // the sets are the permuted vectors
+    MDD permuted = lddmc_false;
+    lddmc_refs_pushptr(&permuted);
+    for (int i=0; i<125; i++) {
+        uint32_t vec[5];
+        for (int j=0; j<5; j++) vec[j] = vecs[i][order[j]];
+        permuted = lddmc_union_cube(permuted, vec, 5);
+    }
+    test_assert(permuted == sets[0]);
+
+    // the relations and metas are permuted as well
+    test_assert(lddmc_union(lddmc_relprod(sets[0], rels[0], metas[0]), lddmc_relprod(sets[0], rels[1], metas[1])) == sets[1]);
+
+    lddmc_refs_popptr(7);
+    return 0;
+}
+
+/**
+ * Count the cache puts of lddmc_union(a, b) on an empty cache.
+ * Uses the stats counters; without SYLVAN_STATS they stay 0, then the used cache entries are counted.
+ */
+static size_t
+count_union_puts(MDD a, MDD b)
+{
+    LACE_ME;
+    sylvan_stats_t before, after;
+    sylvan_clear_cache();
+    sylvan_stats_snapshot(&before);
+    lddmc_union(a, b);
+    sylvan_stats_snapshot(&after);
+    size_t puts = after.counters[LDD_UNION_CACHEDPUT] - before.counters[LDD_UNION_CACHEDPUT];
+    return puts != 0 ? puts : cache_getused();
+}
+
 int
 test_ldd()
 {
@@ -465,6 +1072,30 @@ test_ldd()
         assert(lddmc_satcount(m) >= 1);
     }
 
+    // test satcount_mpz and satcount_log2
+    {
+        mpz_t count, expected;
+        mpz_init(count);
+        mpz_init(expected);
+        m = make_random_ldd_set(rng(1, 6), 10, rng(1, 30));
+        lddmc_satcount_mpz(count, m);
+        test_assert(mpz_get_d(count) == lddmc_satcount_cached(m));
+        test_assert(fabs(exp2(lddmc_satcount_log2(m)) - mpz_get_d(count)) < 1e-6 * mpz_get_d(count));
+        test_assert(lddmc_satcount_log2(lddmc_false) == -INFINITY);
+
+        // {0,1,2}^1000 has 3^1000 vectors, which does not fit in a double
+        m = lddmc_true;
+        for (int i=0; i<1000; i++) {
+            m = lddmc_makenode(0, m, lddmc_makenode(1, m, lddmc_makenode(2, m, lddmc_false)));
+        }
+        lddmc_satcount_mpz(count, m);
+        mpz_ui_pow_ui(expected, 3, 1000);
+        test_assert(mpz_cmp(count, expected) == 0);
+        test_assert(fabs(lddmc_satcount_log2(m) - 1000*log2(3.0)) < 1e-6);
+        mpz_clear(count);
+        mpz_clear(expected);
+    }
+
     // test simply transition relation
     {
         MDD states, rel, meta, expected;
@@ -513,6 +1144,281 @@ test_ldd()
         test_assert(lddmc_union(states, states2) == lddmc_relprod_union(states, rel, meta, states2));
     }
 
+    // test bulk construction, compared with union_cube
+    for (int i=0; i<10; i++) {
+        const size_t len = rng(1, 6), n = rng(0, 500);
+        uint32_t *states = (uint32_t*)malloc(sizeof(uint32_t)*(n*len+1));
+        MDD expected = lddmc_false;
+        for (size_t j=0; j<n; j++) {
+            for (size_t k=0; k<len; k++) states[j*len+k] = rng(0, 6);
+            expected = lddmc_union_cube(expected, states+j*len, len);
+        }
+        test_assert(lddmc_from_unsorted(states, n, len) == expected);
+        test_assert(lddmc_from_sorted(states, n, len) == expected);
+        free(states);
+    }
+
+    // test conversion to BDD and back, with 3 levels of 2, 1 and 3 bits on the even variables
+    {
+        uint32_t bits[] = {2, 1, 3};
+        BDDVAR vars[] = {0, 2, 4, 6, 8, 10};
+        BDDSET varset = sylvan_set_fromarray(vars, 6);
+        MDD states = lddmc_false;
+        BDD expected = sylvan_false;
+        for (int i=0; i<20; i++) {
+            uint32_t values[] = {rng(0, 4), rng(0, 2), rng(0, 8)};
+            states = lddmc_union_cube(states, values, 3);
+            uint32_t code = (values[0] << 4) | (values[1] << 3) | values[2];
+            uint8_t cube[6];
+            for (int k=0; k<6; k++) cube[k] = (code >> (5-k)) & 1;
+            expected = sylvan_or(expected, sylvan_cube(varset, cube));
+        }
+        BDD bdd = lddmc_to_bdd(states, bits, 3, varset);
+        test_assert(bdd == expected);
+        test_assert(bdd_to_lddmc(bdd, bits, 3, varset) == states);
+        test_assert(lddmc_to_bdd(lddmc_false, bits, 3, varset) == sylvan_false);
+        test_assert(bdd_to_lddmc(sylvan_false, bits, 3, varset) == lddmc_false);
+        test_assert(lddmc_satcount(bdd_to_lddmc(sylvan_true, bits, 3, varset)) == 64);
+    }
+
+    // test learning reachability, compared with explicit search
+    {
+        MDD metas[4];
+        metas[0] = lddmc_cube((uint32_t[]){1,2,(uint32_t)-1}, 3);
+        metas[1] = lddmc_cube((uint32_t[]){3,1,2,(uint32_t)-1}, 4);
+        metas[2] = lddmc_cube((uint32_t[]){0,3,1,2,(uint32_t)-1}, 5);
+        metas[3] = lddmc_cube((uint32_t[]){0,4,(uint32_t)-1}, 3);
+        MDD relations[4];
+        MDD reachable = lddmc_learn_reachability(lddmc_cube((uint32_t[]){0,0,0}, 3), relations, metas, 4, TASK(test_learn_next_cb), NULL);
+
+        int seen[216] = {0}, queue[216], head = 0, tail = 0;
+        MDD expected = lddmc_false;
+        seen[0] = 1;
+        queue[tail++] = 0;
+        while (head < tail) {
+            int c = queue[head++];
+            uint32_t s[3] = {c/36, (c/6)%6, c%6}, t[3];
+            expected = lddmc_union_cube(expected, s, 3);
+            for (int g=0; g<4; g++) {
+                if (!test_learn_next_explicit(g, s, t)) continue;
+                int d = t[0]*36+t[1]*6+t[2];
+                if (!seen[d]) { seen[d] = 1; queue[tail++] = d; }
+            }
+        }
+        test_assert(reachable == expected);
+        test_assert(lddmc_satcount(relations[3]) == 1);
+    }
+
+    // test caching policies: results must not depend on the policy
+    {
+        MDD states = make_random_ldd_set(4, 10, 100);
+        MDD other = make_random_ldd_set(4, 10, 100);
+        MDD rel = make_random_ldd_set(4, 10, 100);
+        MDD meta = lddmc_cube((uint32_t[]){1,2,1,2}, 4);
+        MDD proj = lddmc_cube((uint32_t[]){1,0,1,(uint32_t)-2}, 4);
+        MDD image = lddmc_relprod(states, rel, meta);
+        MDD image_union = lddmc_relprod_union(states, rel, meta, other);
+        MDD un = lddmc_union(states, other), mi = lddmc_minus(states, other), pr = lddmc_project(states, proj);
+        for (int policy=LDDMC_CACHE_ALL; policy<=LDDMC_CACHE_TOP; policy++) {
+            for (int op=0; op<LDDMC_CACHE_OPS; op++) lddmc_set_cache_policy((lddmc_cache_op_t)op, (lddmc_cache_policy_t)policy, 2);
+            sylvan_clear_cache();
+            test_assert(lddmc_relprod(states, rel, meta) == image);
+            test_assert(lddmc_relprod_union(states, rel, meta, other) == image_union);
+            test_assert(lddmc_union(states, other) == un);
+            test_assert(lddmc_minus(states, other) == mi);
+            test_assert(lddmc_project(states, proj) == pr);
+        }
+
+        // caching only some levels must make fewer cache puts than caching all levels
+        lddmc_set_cache_policy(LDDMC_UNION, LDDMC_CACHE_ALL, 1);
+        const size_t puts_all = count_union_puts(states, other);
+        test_assert(puts_all > 0);
+        lddmc_set_cache_policy(LDDMC_UNION, LDDMC_CACHE_DOWN, 1);
+        test_assert(count_union_puts(states, other) < puts_all);
+        lddmc_set_cache_policy(LDDMC_UNION, LDDMC_CACHE_TOP, 1);
+        test_assert(count_union_puts(states, other) < puts_all);
+        for (int op=0; op<LDDMC_CACHE_OPS; op++) lddmc_set_cache_policy((lddmc_cache_op_t)op, LDDMC_CACHE_ALL, 1);
+    }
+
+    // test wide levels: results must not depend on the index
+    {
+        MDD states = lddmc_false, rel = lddmc_false;
+        for (int i=0; i<200; i++) {
+            states = lddmc_union_cube(states, (uint32_t[]){rng(0, 1000), rng(0, 1000)}, 2);
+            rel = lddmc_union_cube(rel, (uint32_t[]){rng(0, 1000), rng(0, 1000)}, 2);
+        }
+        MDD meta = lddmc_cube((uint32_t[]){1,2}, 2);
+        MDD expected = lddmc_relprod(states, rel, meta);
+        MDD matched = lddmc_match(states, rel, lddmc_cube((uint32_t[]){1}, 1));
+        uint32_t values[1000];
+        for (int i=0; i<1000; i++) values[i] = lddmc_follow(states, i) != lddmc_false;
+
+        lddmc_set_wide_levels(16);
+        sylvan_clear_cache();
+        for (int k=0; k<2; k++) {
+            test_assert(lddmc_relprod(states, rel, meta) == expected);
+            test_assert(lddmc_match(states, rel, lddmc_cube((uint32_t[]){1}, 1)) == matched);
+            for (int i=0; i<1000; i++) test_assert(values[i] == (lddmc_follow(states, i) != lddmc_false));
+            sylvan_gc();
+        }
+        lddmc_set_wide_levels(0);
+    }
+
+    return 0;
+}
+
+/**
+ * Random family of sets over variables 0..9, also stored as an array of 1024 flags
+ */
+static ZDD
+make_random_zdd(uint8_t *flags)
+{
+    LACE_ME;
+
+    ZDD result = zdd_false;
+    memset(flags, 0, 1024);
+    for (int i=rng(0, 20); i>0; i--) {
+        uint32_t vars[10];
+        size_t count = 0;
+        int set = 0;
+        for (int v=0; v<10; v++) {
+            if (rng(0, 3) == 0) {
+                vars[count++] = v;
+                set |= 1<<v;
+            }
+        }
+        flags[set] = 1;
+        result = zdd_union(result, zdd_from_array(vars, count));
+    }
+    return result;
+}
+
+static int
+zdd_has_flags(ZDD zdd, uint8_t *flags)
+{
+    LACE_ME;
+
+    int count = 0;
+    for (int set=0; set<1024; set++) {
+        uint32_t vars[10];
+        size_t n = 0;
+        for (int v=0; v<10; v++) if (set & (1<<v)) vars[n++] = v;
+        if (zdd_contains(zdd, vars, n) != flags[set]) return 0;
+        count += flags[set];
+    }
+    return zdd_count(zdd) == count;
+}
+
+int
+test_zdd()
+{
+    LACE_ME;
+
+    uint8_t a[1024], b[1024], expected[1024];
+
+    test_assert(zdd_count(zdd_false) == 0);
+    test_assert(zdd_count(zdd_true) == 1);
+    uint32_t all[10] = {0,1,2,3,4,5,6,7,8,9};
+    test_assert(zdd_count(zdd_powerset(all, 10)) == 1024);
+    test_assert(zdd_nodecount(zdd_powerset(all, 10)) == 10);
+    test_assert(zdd_nodecount(zdd_from_array(all, 10)) == 10);
+
+    for (int k=0; k<10; k++) {
+        ZDD za = make_random_zdd(a);
+        ZDD zb = make_random_zdd(b);
+        test_assert(zdd_has_flags(za, a));
+        test_assert(zdd_has_flags(zb, b));
+
+        for (int s=0; s<1024; s++) expected[s] = a[s] | b[s];
+        test_assert(zdd_has_flags(zdd_union(za, zb), expected));
+        for (int s=0; s<1024; s++) expected[s] = a[s] & b[s];
+        test_assert(zdd_has_flags(zdd_intersect(za, zb), expected));
+        for (int s=0; s<1024; s++) expected[s] = a[s] & !b[s];
+        test_assert(zdd_has_flags(zdd_diff(za, zb), expected));
+
+        memset(expected, 0, 1024);
+        for (int s=0; s<1024; s++) if (a[s]) for (int t=0; t<1024; t++) if (b[t]) expected[s|t] = 1;
+        test_assert(zdd_has_flags(zdd_join(za, zb), expected));
+        memset(expected, 0, 1024);
+        for (int s=0; s<1024; s++) if (a[s]) for (int t=0; t<1024; t++) if (b[t]) expected[s&t] = 1;
+        test_assert(zdd_has_flags(zdd_meet(za, zb), expected));
+    }
+
+    return 0;
+}
+
+int
+test_serialize()
+{
+    LACE_ME;
+
+    FILE *f = tmpfile();
+    test_assert(f != NULL);
+
+    // write BDDs and LDDs in two rounds; the second round shares nodes with the first
+    BDD bdds[20];
+    MDD mdds[20];
+    size_t bdd_keys[20], mdd_keys[20];
+    sylvan_serialize_reset();
+    lddmc_serialize_reset();
+    for (int round=0; round<2; round++) {
+        for (int i=10*round; i<10*round+10; i++) {
+            bdds[i] = make_random(0, 16);
+            if (i & 1) bdds[i] = sylvan_not(bdds[i]);
+            if (round == 1) bdds[i] = sylvan_or(bdds[i], bdds[i-10]);
+            mdds[i] = make_random_ldd_set(5, 10, 50);
+            if (round == 1) mdds[i] = lddmc_union(mdds[i], mdds[i-10]);
+            bdd_keys[i] = sylvan_serialize_add(bdds[i]);
+            mdd_keys[i] = lddmc_serialize_add(mdds[i]);
+            test_assert(sylvan_serialize_add(bdds[i]) == bdd_keys[i]);
+            test_assert(sylvan_serialize_get(bdds[i]) == bdd_keys[i]);
+            test_assert(lddmc_serialize_get(mdds[i]) == mdd_keys[i]);
+            test_assert(sylvan_serialize_get_reversed(bdd_keys[i]) == bdds[i]);
+            test_assert(lddmc_serialize_get_reversed(mdd_keys[i]) == mdds[i]);
+        }
+        sylvan_serialize_tofile(f);
+        lddmc_serialize_tofile(f);
+    }
+
+    // read them back
+    sylvan_serialize_reset();
+    lddmc_serialize_reset();
+    rewind(f);
+    for (int round=0; round<2; round++) {
+        sylvan_serialize_fromfile(f);
+        lddmc_serialize_fromfile(f);
+    }
+    fclose(f);
+    for (int i=0; i<20; i++) {
+        test_assert(sylvan_serialize_get_reversed(bdd_keys[i]) == bdds[i]);
+        test_assert(lddmc_serialize_get_reversed(mdd_keys[i]) == mdds[i]);
+    }
+
+    sylvan_serialize_reset();
+    lddmc_serialize_reset();
+    return 0;
+}
+
+/**
+ * Adaptive granularity: a window of cache misses increases the granularity, a window of hits decreases it
+ */
+int
+test_adaptive_granularity()
+{
+    sylvan_set_adaptive_granularity(1);
+    test_assert(cache_granularity(CACHE_BDD_AND, 0) == 1);
+
+    uint64_t res;
+    for (uint64_t i=0; i<4096; i++) cache_get3_level(CACHE_BDD_AND, 0, 0x100000+i, 0x200000+i, 0x300000+i, &res);
+    test_assert(cache_granularity(CACHE_BDD_AND, 0) == 5);
+    test_assert(cache_granularity(CACHE_BDD_AND, CACHE_GRANULARITY_BAND) == 1);
+    test_assert(cache_granularity(CACHE_BDD_XOR, 0) == 1);
+
+    test_assert(cache_put3(CACHE_BDD_AND, 0x100000, 0x200000, 0x300000, 42));
+    for (uint64_t i=0; i<4096; i++) test_assert(cache_get3_level(CACHE_BDD_AND, 0, 0x100000, 0x200000, 0x300000, &res));
+    test_assert(cache_granularity(CACHE_BDD_AND, 0) == 1);
+
+    sylvan_set_adaptive_granularity(0);
     return 0;
 }
 
@@ -521,30 +1427,61 @@ int runtests()
     // we are not testing garbage collection
     sylvan_gc_disable();
 
+    if (test_lace()) return 1;
     if (test_cache()) return 1;
     if (test_bdd()) return 1;
     for (int j=0;j<10;j++) if (test_cube()) return 1;
     for (int j=0;j<10;j++) if (test_relprod()) return 1;
     for (int j=0;j<10;j++) if (test_compose()) return 1;
+    for (int j=0;j<10;j++) if (test_satcount()) return 1;
+    for (int j=0;j<10;j++) if (test_enum_batch()) return 1;
+    for (int j=0;j<10;j++) if (test_sample()) return 1;
+    for (int j=0;j<10;j++) if (test_many()) return 1;
+    for (int j=0;j<10;j++) if (test_approx()) return 1;
+    if (test_saturate()) return 1;
+    for (int j=0;j<10;j++) if (test_operators()) return 1;
+
+    if (test_ldd()) return 1;
+    if (test_ldd_reorder()) return 1;
+    if (test_zdd()) return 1;
+    if (test_serialize()) return 1;
+
+    // again, now with lazy task creation
+    lace_set_inline_threshold(2);
+    for (int j=0;j<10;j++) if (test_relprod()) return 1;
     for (int j=0;j<10;j++) if (test_operators()) return 1;
+    if (test_ldd()) return 1;
+    if (test_zdd()) return 1;
+    lace_set_inline_threshold(0);
 
+    // again, now with adaptive granularity
+    if (test_adaptive_granularity()) return 1;
+    sylvan_set_adaptive_granularity(1);
+    for (int j=0;j<10;j++) if (test_relprod()) return 1;
+    for (int j=0;j<10;j++) if (test_operators()) return 1;
     if (test_ldd()) return 1;
+    if (test_zdd()) return 1;
+    sylvan_set_adaptive_granularity(0);
 
     return 0;
 }
 
 int main()
 {
+    // Lace with background workers, then exit
+    if (test_lace_background()) return 1;
+
     // Standard Lace initialization with 1 worker
     lace_init(1, 0);
     lace_startup(0, NULL, NULL);
 
-    // Simple Sylvan initialization, also initialize BDD, MTBDD and LDD support
+    // Simple Sylvan initialization, also initialize BDD, MTBDD, LDD and ZDD support
     sylvan_set_sizes(1LL<<20, 1LL<<20, 1LL<<16, 1LL<<16);
     sylvan_init_package();
     sylvan_init_bdd();
     sylvan_init_mtbdd();
     sylvan_init_ldd();
+    sylvan_init_zdd();
 
     int res = runtests();
 